@@ -96,6 +96,11 @@ bool sample_p2p(std::shared_ptr<Stormancer::IClient> client, std::string userId,
 	//that it's ready to accept connection from other game clients.
 	gameSession->setPlayerReady().get();
 
+	//Subscribe to the chat channel: other peers only send chat messages to the peers who subscribed to it.
+	gameSession->setInterestChannels({ "chat" });
+	//Chat messages must all arrive, in order, but must not delay the other P2P messages: give them their own ordering channel.
+	gameSession->declareRoute("hello", Stormancer::GameSessions::DeliveryMode::ReliableOrdered, Stormancer::PacketPriority::MEDIUM_PRIORITY, "chat");
+
 	Stormancer::Serializer serializer;
 
 	//Wait for user input and broadcast it to all the other peers in P2P.
@@ -108,8 +113,8 @@ bool sample_p2p(std::shared_ptr<Stormancer::IClient> client, std::string userId,
 		std::string input;
 		std::getline(std::cin, input);
 		input = userId + ": " + input;
-		//Broadcast a message to all other P2P peers
-		gameSession->scene()->send(Stormancer::PeerFilter::matchAllP2P(), "hello", [serializer, input](Stormancer::obytestream& stream) {
+		//Send the message to the P2P peers subscribed to the chat channel
+		gameSession->sendToChannel("chat", "hello", [serializer, input](Stormancer::obytestream& stream) {
 			serializer.serialize(stream, input);
 		});
 
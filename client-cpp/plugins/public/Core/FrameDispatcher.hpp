@@ -0,0 +1,197 @@
+#pragma once
+#include "stormancer/IActionDispatcher.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace Stormancer
+{
+	/// <summary>
+	/// Statistics of a <c>FrameDispatcher</c>.
+	/// </summary>
+	struct FrameDispatcherStats
+	{
+		/// <summary>
+		/// Number of actions waiting to be run.
+		/// </summary>
+		std::size_t queueDepth = 0;
+		/// <summary>
+		/// Number of actions run by the last call to <c>pump()</c>.
+		/// </summary>
+		std::size_t lastDrainCount = 0;
+		/// <summary>
+		/// Duration of the last call to <c>pump()</c>.
+		/// </summary>
+		std::chrono::microseconds lastDrainTime{ 0 };
+		/// <summary>
+		/// Longest call to <c>pump()</c> so far.
+		/// </summary>
+		std::chrono::microseconds maxDrainTime{ 0 };
+		/// <summary>
+		/// Number of actions run since the dispatcher was created.
+		/// </summary>
+		uint64_t executed = 0;
+	};
+
+	namespace details
+	{
+		/// <summary>
+		/// Unbounded lock-free queue with any number of producers and a single consumer (D. Vyukov's MPSC node-based queue).
+		/// </summary>
+		/// <remarks>
+		/// <c>push()</c> is lock-free (allocating): it never waits for another thread, but allocates a node, so it can block in the allocator.
+		/// <c>pop()</c> must only be called from one thread at a time,
+		/// and may miss an item whose <c>push()</c> has not returned yet: it is returned by the next call.
+		/// </remarks>
+		template<typename T>
+		class MpscQueue
+		{
+		public:
+			MpscQueue()
+				: _head(new Node())
+			{
+				_tail = _head.load(std::memory_order_relaxed);
+			}
+
+			MpscQueue(const MpscQueue&) = delete;
+			MpscQueue& operator=(const MpscQueue&) = delete;
+
+			~MpscQueue()
+			{
+				T item;
+				while (pop(item))
+				{
+				}
+				delete _tail;
+			}
+
+			void push(T item)
+			{
+				auto node = new Node();
+				node->value = std::move(item);
+				auto previous = _head.exchange(node, std::memory_order_acq_rel);
+				previous->next.store(node, std::memory_order_release);
+			}
+
+			bool pop(T& item)
+			{
+				auto tail = _tail;
+				auto next = tail->next.load(std::memory_order_acquire);
+				if (next == nullptr)
+				{
+					return false;
+				}
+				item = std::move(next->value);
+				_tail = next;
+				delete tail;
+				return true;
+			}
+
+		private:
+			struct Node
+			{
+				std::atomic<Node*> next{ nullptr };
+				T value;
+			};
+
+			std::atomic<Node*> _head;
+			Node* _tail;
+		};
+	}
+
+	/// <summary>
+	/// Action dispatcher running the queued actions on the thread of the game loop, within a time budget per frame.
+	/// </summary>
+	/// <remarks>
+	/// Set it as <c>Configuration::actionDispatcher</c> and call <c>pump()</c> once per frame:
+	/// the events of the Users, GameFinder, GameSession and Party plugins, as well as the continuations scheduled on the dispatcher, then run in <c>pump()</c>.
+	/// Posting takes no lock, whichever thread it is called from: it never waits for <c>pump()</c> or for other posting threads.
+	/// </remarks>
+	class FrameDispatcher : public IActionDispatcher
+	{
+	public:
+		void post(const std::function<void(void)>& action) override
+		{
+			_depth.fetch_add(1, std::memory_order_relaxed);
+			_queue.push(action);
+		}
+
+		void schedule(pplx::TaskProc_t proc, void* param) override
+		{
+			post([proc, param] { proc(param); });
+		}
+
+		/// <summary>
+		/// Run the queued actions on the calling thread, until the queue is empty or <c>budget</c> is spent.
+		/// </summary>
+		/// <remarks>
+		/// At least one action is run if the queue is not empty, so that a budget too small for any action does not stall the queue.
+		/// The actions left over are run by the next call. An exception thrown by an action is propagated to the caller.
+		/// Must not be called concurrently.
+		/// </remarks>
+		/// <returns>The number of actions run.</returns>
+		std::size_t pump(std::chrono::microseconds budget)
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::size_t count = 0;
+			std::function<void(void)> action;
+			try
+			{
+				while (_queue.pop(action))
+				{
+					_depth.fetch_sub(1, std::memory_order_relaxed);
+					count++;
+					action();
+					if (std::chrono::steady_clock::now() - start >= budget)
+					{
+						break;
+					}
+				}
+			}
+			catch (...)
+			{
+				recordDrain(start, count);
+				throw;
+			}
+			recordDrain(start, count);
+			return count;
+		}
+
+		FrameDispatcherStats stats() const
+		{
+			FrameDispatcherStats stats;
+			stats.queueDepth = static_cast<std::size_t>(std::max<int64_t>(0, _depth.load(std::memory_order_relaxed)));
+			stats.lastDrainCount = _lastDrainCount.load(std::memory_order_relaxed);
+			stats.lastDrainTime = std::chrono::microseconds(_lastDrainTime.load(std::memory_order_relaxed));
+			stats.maxDrainTime = std::chrono::microseconds(_maxDrainTime.load(std::memory_order_relaxed));
+			stats.executed = _executed.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+	private:
+
+		void recordDrain(std::chrono::steady_clock::time_point start, std::size_t count)
+		{
+			auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			_lastDrainCount.store(count, std::memory_order_relaxed);
+			_lastDrainTime.store(duration, std::memory_order_relaxed);
+			if (duration > _maxDrainTime.load(std::memory_order_relaxed))
+			{
+				_maxDrainTime.store(duration, std::memory_order_relaxed);
+			}
+			_executed.fetch_add(count, std::memory_order_relaxed);
+		}
+
+		details::MpscQueue<std::function<void(void)>> _queue;
+		// Incremented before the push, so it may briefly count an action pop() cannot see yet, never the opposite.
+		std::atomic<int64_t> _depth{ 0 };
+		std::atomic<std::size_t> _lastDrainCount{ 0 };
+		std::atomic<int64_t> _lastDrainTime{ 0 };
+		std::atomic<int64_t> _maxDrainTime{ 0 };
+		std::atomic<uint64_t> _executed{ 0 };
+	};
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "stormancer/Tasks.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Stormancer
+{
+	/// <summary>
+	/// Round-trip times from the local player to the probed endpoints, in milliseconds, by endpoint id.
+	/// </summary>
+	/// <remarks>
+	/// The GameFinder appends it to its <c>gamefinder.find</c> requests, so that the server can match players with good links to each other,
+	/// and the GameSession to its connectivity report, so that the server can elect the host with the best links.
+	/// 65535 means 65535 ms or more. Unreachable endpoints are absent.
+	/// </remarks>
+	using LatencyVector = std::map<std::string, uint16_t>;
+
+	/// <summary>
+	/// Endpoint whose round-trip time is measured by the GameFinder and the GameSession, for instance a relay or a region endpoint.
+	/// </summary>
+	/// <remarks>
+	/// Register implementations of this interface in the client's dependency scope, for instance in the <c>registerClientDependencies()</c> of a custom plugin.
+	/// The server is always probed as well, with the id <c>"server"</c>, through the GameFinder or GameSession scene.
+	/// Players are compared on the endpoint ids they share: the same endpoint must have the same id on every client.
+	/// </remarks>
+	class ILatencyProbeTarget
+	{
+	public:
+		virtual ~ILatencyProbeTarget() = default;
+
+		virtual std::string id() const = 0;
+
+		/// <summary>
+		/// Measure a single round trip to the endpoint.
+		/// </summary>
+		/// <remarks>
+		/// The token is canceled when the probe times out: the task should then complete quickly, as canceled or failed.
+		/// </remarks>
+		virtual pplx::task<std::chrono::microseconds> probe(pplx::cancellation_token ct) = 0;
+	};
+
+	namespace details
+	{
+		/// <summary>
+		/// Recent round-trip samples of the probed endpoints, summarized as a <c>LatencyVector</c>.
+		/// </summary>
+		/// <remarks>
+		/// The round-trip time of an endpoint is the median of its last samples, to ignore isolated queuing delays.
+		/// An endpoint without a sample for <c>STALE_AFTER</c> is considered unreachable.
+		/// Thread-safe: samples are added by the probe continuations, and the vector read by <c>findGame()</c>.
+		/// </remarks>
+		class LatencyEstimator
+		{
+		public:
+			static constexpr std::size_t WINDOW = 5;
+			static constexpr std::chrono::seconds STALE_AFTER{ 90 };
+
+			void addSample(const std::string& target, std::chrono::microseconds roundTripTime)
+			{
+				std::lock_guard<std::mutex> lg(_mutex);
+				auto& samples = _samples[target];
+				samples.values.push_back(roundTripTime);
+				if (samples.values.size() > WINDOW)
+				{
+					samples.values.pop_front();
+				}
+				samples.lastSampleAt = std::chrono::steady_clock::now();
+			}
+
+			LatencyVector vector() const
+			{
+				LatencyVector result;
+				auto now = std::chrono::steady_clock::now();
+				std::lock_guard<std::mutex> lg(_mutex);
+				for (const auto& entry : _samples)
+				{
+					const auto& samples = entry.second;
+					if (samples.values.empty() || now - samples.lastSampleAt > STALE_AFTER)
+					{
+						continue;
+					}
+					std::vector<std::chrono::microseconds> sorted(samples.values.begin(), samples.values.end());
+					auto median = sorted.begin() + sorted.size() / 2;
+					std::nth_element(sorted.begin(), median, sorted.end());
+					result[entry.first] = toMilliseconds(*median);
+				}
+				return result;
+			}
+
+			// Rounded up, so that a measured link is never reported as 0 ms.
+			static uint16_t toMilliseconds(std::chrono::microseconds roundTripTime)
+			{
+				auto ms = (std::max<int64_t>(roundTripTime.count(), 1) + 999) / 1000;
+				return static_cast<uint16_t>(std::min<int64_t>(ms, UINT16_MAX));
+			}
+
+		private:
+			struct Samples
+			{
+				std::deque<std::chrono::microseconds> values;
+				std::chrono::steady_clock::time_point lastSampleAt;
+			};
+
+			mutable std::mutex _mutex;
+			std::unordered_map<std::string, Samples> _samples;
+		};
+	}
+}
@@ -0,0 +1,146 @@
+// Multi-producer test of FrameDispatcher: actions posted concurrently from several threads while the game loop pumps them within a budget.
+//
+// Requires the Stormancer client library headers (for IActionDispatcher):
+//   g++ -std=c++17 -O2 -pthread -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/Core/Tests/FrameDispatcherTest.cpp -L <StormancerSDK>/lib -lstormancer -o frame-dispatcher-test
+//   ./frame-dispatcher-test [producers] [actionsPerProducer]
+//
+// Every action must run exactly once, on the pumping thread, and the actions of each producer in the order it posted them.
+// A budget must stop pump() once spent, after running at least one action, and an exception thrown by an action must leave the other actions queued.
+// Returns 1 if a check fails.
+
+#include "Core/FrameDispatcher.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Stormancer;
+
+namespace
+{
+	bool check(bool condition, const char* message)
+	{
+		std::printf("%s %s\n", condition ? "PASS" : "FAIL", message);
+		return condition;
+	}
+
+	bool multipleProducers(int producers, uint64_t actionsPerProducer)
+	{
+		FrameDispatcher dispatcher;
+		// Only read and written by the actions, on the pumping thread.
+		std::vector<uint64_t> next(producers, 0);
+		uint64_t outOfOrder = 0;
+		auto pumpingThread = std::this_thread::get_id();
+		uint64_t wrongThread = 0;
+
+		std::atomic<bool> start{ false };
+		std::vector<std::thread> threads;
+		for (int producer = 0; producer < producers; producer++)
+		{
+			threads.emplace_back([&, producer]()
+			{
+				while (!start)
+				{
+					std::this_thread::yield();
+				}
+				for (uint64_t i = 0; i < actionsPerProducer; i++)
+				{
+					dispatcher.post([&, producer, i]()
+					{
+						outOfOrder += next[producer] != i ? 1 : 0;
+						next[producer] = i + 1;
+						wrongThread += std::this_thread::get_id() != pumpingThread ? 1 : 0;
+					});
+				}
+			});
+		}
+
+		auto total = producers * actionsPerProducer;
+		uint64_t executed = 0;
+		uint64_t frames = 0;
+		std::size_t maxFrame = 0;
+		start = true;
+		auto begin = std::chrono::steady_clock::now();
+		while (executed < total && std::chrono::steady_clock::now() - begin < std::chrono::seconds(60))
+		{
+			auto count = dispatcher.pump(std::chrono::microseconds(1000));
+			executed += count;
+			frames++;
+			maxFrame = std::max(maxFrame, count);
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		bool ok = true;
+		uint64_t complete = 0;
+		for (auto n : next)
+		{
+			complete += n == actionsPerProducer ? 1 : 0;
+		}
+		std::printf("%d producers, %llu actions: %.1f M actions/s, %llu frames, at most %zu actions per frame\n", producers, static_cast<unsigned long long>(total),
+			total / seconds / 1e6, static_cast<unsigned long long>(frames), maxFrame);
+		ok = check(executed == total && complete == static_cast<uint64_t>(producers), "every action ran once") && ok;
+		ok = check(outOfOrder == 0, "the actions of each producer ran in order") && ok;
+		ok = check(wrongThread == 0, "the actions ran on the pumping thread") && ok;
+		auto stats = dispatcher.stats();
+		ok = check(stats.executed == total && stats.queueDepth == 0 && dispatcher.pump(std::chrono::microseconds(1000)) == 0, "the queue is empty, and the statistics count every action") && ok;
+		return ok;
+	}
+
+	bool budget()
+	{
+		FrameDispatcher dispatcher;
+		for (int i = 0; i < 100; i++)
+		{
+			dispatcher.post([]()
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(500));
+			});
+		}
+		bool ok = true;
+		auto count = dispatcher.pump(std::chrono::microseconds(2000));
+		ok = check(count >= 1 && count <= 5, "pump() stops once its budget is spent") && ok;
+		ok = check(dispatcher.pump(std::chrono::microseconds(0)) == 1, "pump() runs one action when the budget is too small for any") && ok;
+		ok = check(dispatcher.stats().queueDepth == 100 - count - 1, "the actions left over stay queued") && ok;
+		return ok;
+	}
+
+	bool exceptions()
+	{
+		FrameDispatcher dispatcher;
+		int ran = 0;
+		dispatcher.post([&ran]() { ran++; });
+		dispatcher.post([]() { throw std::runtime_error("action failed"); });
+		dispatcher.post([&ran]() { ran++; });
+		bool thrown = false;
+		try
+		{
+			dispatcher.pump(std::chrono::seconds(1));
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		bool ok = check(thrown && ran == 1, "an exception thrown by an action is propagated by pump()");
+		ok = check(dispatcher.pump(std::chrono::seconds(1)) == 1 && ran == 2, "the actions after it run with the next pump()") && ok;
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int producers = argc > 1 ? std::atoi(argv[1]) : 8;
+	uint64_t actionsPerProducer = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200000;
+
+	bool ok = multipleProducers(producers, actionsPerProducer);
+	ok = budget() && ok;
+	ok = exceptions() && ok;
+	return ok ? 0 : 1;
+}
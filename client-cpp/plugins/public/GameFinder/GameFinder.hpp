@@ -7,7 +7,12 @@
 #include "stormancer/msgpack_define.h"
 #include "stormancer/Scene.h"
 #include "Users/Users.hpp"
+#include "Core/LatencyProbes.hpp"
 #include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
 
 namespace Stormancer
 {
@@ -71,6 +76,8 @@ namespace Stormancer
 		{
 			GameFinderStatus status;
 			std::string gameFinder;
+			// Status the GameFinder was in before this update was applied.
+			GameFinderStatus previousStatus = GameFinderStatus::Idle;
 		};
 
 		struct GameFoundEvent
@@ -163,6 +170,11 @@ namespace Stormancer
 			/// <summary>
 			/// Subscribe to <c>findGame</c> status notifications.
 			/// </summary>
+			/// <remarks>
+			/// The callback is invoked at most once per status update received from the server, and only when the status actually changes.
+			/// <c>Success</c>, <c>Failed</c> and <c>Canceled</c> are terminal: when they are notified, the request is already over,
+			/// and <c>getPendingFindGameStatus()</c> reports the GameFinder as <c>Idle</c>. No separate <c>Idle</c> notification follows them.
+			/// </remarks>
 			/// <param name="callback">Callable object to be called when a <c>findGame</c> request status update occurs.</param>
 			/// <returns>A reference-counted <c>Subscription</c> object that tracks the lifetime of the subscription.
 			/// When the reference count of this object drops to zero, the subscription will be canceled.</returns>
@@ -209,15 +221,69 @@ namespace Stormancer
 			}
 		};
 
+		/// <summary>
+		/// Ready check a <c>IReadyCheckPolicy</c> is asked to answer.
+		/// </summary>
+		struct ReadyCheckContext
+		{
+			/// <summary>
+			/// Id of the scene of the GameFinder that found the game.
+			/// </summary>
+			std::string gameFinderSceneId;
+		};
+
+		enum class ReadyCheckDecision
+		{
+			/// <summary>
+			/// Let the next policy, or the application, answer the ready check.
+			/// </summary>
+			Defer,
+			Accept,
+			Decline
+		};
+
+		/// <summary>
+		/// Answers the ready checks of the GameFinders (see the <c>readyCheck</c> GameFinder setting on the server) without involving the application.
+		/// </summary>
+		/// <remarks>
+		/// Register implementations of this interface in the client's dependency scope, for instance in the <c>registerClientDependencies()</c> of a custom plugin.
+		/// When a ready check starts, the policies are called in registration order, until one of them does not return <c>Defer</c>.
+		/// Its decision is sent right away, before <c>GameFinderStatus::WaitingPlayersReady</c> is notified, and the application's answer to this ready check is then ignored.
+		/// If every policy defers, the application answers the ready check as before.
+		/// <c>onReadyCheck()</c> is called on the network thread: it must return quickly, and must not block.
+		/// </remarks>
+		class IReadyCheckPolicy
+		{
+		public:
+			virtual ~IReadyCheckPolicy() = default;
+
+			virtual ReadyCheckDecision onReadyCheck(const ReadyCheckContext& context) = 0;
+		};
+
+		/// <summary>
+		/// Accept every ready check: a player who is still searching for a game accepts the game that was found.
+		/// </summary>
+		class AlwaysAcceptReadyCheckPolicy : public IReadyCheckPolicy
+		{
+		public:
+			ReadyCheckDecision onReadyCheck(const ReadyCheckContext&) override
+			{
+				return ReadyCheckDecision::Accept;
+			}
+		};
+
 		namespace details
 		{
 			class GameFinderService : public std::enable_shared_from_this<GameFinderService>
 			{
 			public:
 
-				GameFinderService(std::shared_ptr<Scene> scene)
+				GameFinderService(std::shared_ptr<Scene> scene, std::vector<std::shared_ptr<IReadyCheckPolicy>> readyCheckPolicies, std::vector<std::shared_ptr<ILatencyProbeTarget>> probeTargets)
 					: _scene(scene)
 					, _rpcService(scene->dependencyResolver().resolve<RpcService>())
+					, _readyCheckPolicies(readyCheckPolicies)
+					, _probeTargets(probeTargets)
+					, _logger(scene->dependencyResolver().resolve<ILogger>())
 				{
 				}
 
@@ -236,19 +302,14 @@ namespace Stormancer
 					std::weak_ptr<GameFinderService> wThat = this->shared_from_this();
 					_scene.lock()->addRoute("gamefinder.update", [wThat](Packetisp_ptr packet)
 					{
+						auto receivedAt = std::chrono::steady_clock::now();
 						byte gameStateByte;
 						packet->stream.read(&gameStateByte, 1);
-						int32 gameState = gameStateByte;
+						auto status = (GameFinderStatus)(int32)gameStateByte;
 
 						if (auto that = wThat.lock())
 						{
-							that->_currentState = (GameFinderStatus)gameState;
-
-							auto ms = std::to_string(gameState);
-
-							that->GameFinderStatusUpdated(that->_currentState);
-
-							switch (that->_currentState)
+							switch (status)
 							{
 							case GameFinderStatus::Success:
 							{
@@ -258,15 +319,16 @@ namespace Stormancer
 								response.connectionToken = connectionToken;
 								response.packet = packet;
 
+								// Terminal statuses settle back to Idle in the same transition, so that subscribers get a single notification.
+								auto previous = that->_currentState.exchange(GameFinderStatus::Idle);
+								that->GameFinderStatusUpdated(status, previous);
 								that->GameFound(response);
-								that->_currentState = GameFinderStatus::Idle;
-								that->GameFinderStatusUpdated(that->_currentState);
 								break;
 							}
 							case GameFinderStatus::Canceled:
 							{
-								that->_currentState = GameFinderStatus::Idle;
-								that->GameFinderStatusUpdated(that->_currentState);
+								auto previous = that->_currentState.exchange(GameFinderStatus::Idle);
+								that->GameFinderStatusUpdated(status, previous);
 								break;
 							}
 							case GameFinderStatus::Failed:
@@ -277,22 +339,35 @@ namespace Stormancer
 								{
 									reason = that->_serializer.deserializeOne<std::string>(packet->stream);
 								}
+								auto previous = that->_currentState.exchange(GameFinderStatus::Idle);
+								that->GameFinderStatusUpdated(status, previous);
 								that->FindGameRequestFailed(reason);
-								that->_currentState = GameFinderStatus::Idle;
-								that->GameFinderStatusUpdated(that->_currentState);
 								break;
 							}
 							default:
-								// ignore
+							{
+								// The server repeats the current status at every matchmaking pass ; only notify actual changes.
+								auto previous = that->_currentState.exchange(status);
+								if (previous != status)
+								{
+									if (status == GameFinderStatus::WaitingPlayersReady)
+									{
+										that->onReadyCheck(receivedAt);
+									}
+									that->GameFinderStatusUpdated(status, previous);
+								}
 								break;
 							}
+							}
 						}
 					});
+
+					runLatencyProbes();
 				}
 
 				GameFinderStatus currentState() const
 				{
-					return _currentState;
+					return _currentState.load();
 				}
 
 				pplx::task<void> findGame(const std::string &provider, const StreamWriter& streamWriter)
@@ -300,13 +375,10 @@ namespace Stormancer
 					return findGameInternal(provider, streamWriter);
 				}
 
+				// Answers the pending ready check. Ignored if it was already answered, for instance by an IReadyCheckPolicy.
 				void resolve(bool acceptGame)
 				{
-					auto scene = _scene.lock();
-					scene->send("gamefinder.ready.resolve", [=](obytestream& stream)
-					{
-						stream << acceptGame;
-					}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED);
+					resolveImpl(acceptGame, false);
 				}
 
 				// If cancel() is called very shortly after findGame(), there might be a race condition.
@@ -324,13 +396,15 @@ namespace Stormancer
 				// This should only be called by GameFinderPlugin.
 				void onSceneDisconnecting()
 				{
-					if (_currentState != GameFinderStatus::Idle &&
-						_currentState != GameFinderStatus::Canceled &&
-						_currentState != GameFinderStatus::Failed &&
-						_currentState != GameFinderStatus::Success)
+					_probesCts.cancel();
+					auto previous = _currentState.load();
+					while (isSearchInProgress(previous))
 					{
-						_currentState = GameFinderStatus::Failed;
-						GameFinderStatusUpdated(_currentState);
+						if (_currentState.compare_exchange_weak(previous, GameFinderStatus::Idle))
+						{
+							GameFinderStatusUpdated(GameFinderStatus::Failed, previous);
+							return;
+						}
 					}
 				}
 
@@ -340,27 +414,224 @@ namespace Stormancer
 					return findGameInternal(provider, tData...);
 				}
 
-				Event<GameFinderStatus> GameFinderStatusUpdated;
+				// Arguments are the new status, and the status it replaced.
+				Event<GameFinderStatus, GameFinderStatus> GameFinderStatusUpdated;
 				Event<GameFinderResponse> GameFound;
 				Event<std::string> FindGameRequestFailed;
 
 			private:
 
+				static constexpr const char* PROBE_ROUTE = "gamefinder.probe";
+				static constexpr const char* LATENCY_UPDATE_ROUTE = "gamefinder.latency.update";
+				static constexpr const char* SERVER_PROBE_TARGET = "server";
+				static constexpr std::chrono::seconds PROBE_INTERVAL_SEARCHING{ 5 };
+				static constexpr std::chrono::seconds PROBE_INTERVAL_IDLE{ 30 };
+				static constexpr std::chrono::seconds PROBE_TIMEOUT{ 2 };
+				// Ends the latency vector appended to findGame requests, after its size.
+				static constexpr byte LATENCY_TRAILER_MARKER[] = { 'L', 'T', 'V', '1' };
+
+				// Probe every endpoint at a fast pace while searching, so that the server matches on fresh values, and slowly otherwise.
+				void runLatencyProbes()
+				{
+					std::weak_ptr<GameFinderService> wThat = this->shared_from_this();
+					auto ct = _probesCts.get_token();
+					probeLatencies(ct).then([wThat, ct](pplx::task<void>)
+					{
+						auto that = wThat.lock();
+						if (!that || ct.is_canceled())
+						{
+							return pplx::task_from_exception<void>(pplx::task_canceled());
+						}
+						auto searching = isSearchInProgress(that->currentState());
+						if (searching)
+						{
+							that->sendLatencyUpdate();
+						}
+						return taskDelay(searching ? PROBE_INTERVAL_SEARCHING : PROBE_INTERVAL_IDLE, ct);
+					}).then([wThat](pplx::task<void> task)
+					{
+						try
+						{
+							task.get();
+						}
+						catch (...)
+						{
+							// The scene is disconnecting.
+							return;
+						}
+						if (auto that = wThat.lock())
+						{
+							that->runLatencyProbes();
+						}
+					});
+				}
+
+				// Never fails: the endpoints that could not be probed just get no new sample.
+				pplx::task<void> probeLatencies(pplx::cancellation_token ct)
+				{
+					auto timeoutCts = pplx::cancellation_token_source::create_linked_source(ct);
+					std::vector<pplx::task<void>> probes;
+
+					auto sentAt = std::chrono::steady_clock::now();
+					probes.push_back(recordProbe(SERVER_PROBE_TARGET, _rpcService->rpc<void>(PROBE_ROUTE, timeoutCts.get_token()).then([sentAt]()
+					{
+						return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt);
+					})));
+					for (const auto& target : _probeTargets)
+					{
+						pplx::task<std::chrono::microseconds> probe;
+						try
+						{
+							probe = target->probe(timeoutCts.get_token());
+						}
+						catch (...)
+						{
+							probe = pplx::task_from_exception<std::chrono::microseconds>(std::current_exception());
+						}
+						probes.push_back(recordProbe(target->id(), probe));
+					}
+
+					taskDelay(PROBE_TIMEOUT, ct).then([timeoutCts](pplx::task<void> task)
+					{
+						try
+						{
+							task.get();
+						}
+						catch (...)
+						{
+						}
+						timeoutCts.cancel();
+					});
+					return pplx::when_all(probes.begin(), probes.end());
+				}
+
+				pplx::task<void> recordProbe(std::string target, pplx::task<std::chrono::microseconds> probe)
+				{
+					std::weak_ptr<GameFinderService> wThat = this->shared_from_this();
+					return probe.then([wThat, target](pplx::task<std::chrono::microseconds> task)
+					{
+						try
+						{
+							auto roundTripTime = task.get();
+							if (auto that = wThat.lock())
+							{
+								that->_latencies.addSample(target, roundTripTime);
+							}
+						}
+						catch (...)
+						{
+							// Unreachable, or timed out: the endpoint leaves the latency vector once its samples are stale.
+						}
+					});
+				}
+
+				// The latency vector of a search is updated on the server, in case the network conditions change while it runs.
+				void sendLatencyUpdate()
+				{
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						return;
+					}
+					auto latencies = _latencies.vector();
+					scene->send(LATENCY_UPDATE_ROUTE, [latencies](obytestream& stream)
+					{
+						Serializer serializer;
+						serializer.serialize(stream, latencies);
+					}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_SEQUENCED);
+				}
+
+				// Called on the network thread, when the ready check notification is received.
+				void onReadyCheck(std::chrono::steady_clock::time_point receivedAt)
+				{
+					_readyCheckReceivedAt = receivedAt.time_since_epoch().count();
+					_readyCheckAnswered = false;
+
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						return;
+					}
+					ReadyCheckContext context;
+					context.gameFinderSceneId = scene->id();
+					for (const auto& policy : _readyCheckPolicies)
+					{
+						ReadyCheckDecision decision;
+						try
+						{
+							decision = policy->onReadyCheck(context);
+						}
+						catch (const std::exception& ex)
+						{
+							_logger->log(LogLevel::Error, _logCategory, "An exception was thrown by an IReadyCheckPolicy", ex);
+							continue;
+						}
+						if (decision != ReadyCheckDecision::Defer)
+						{
+							resolveImpl(decision == ReadyCheckDecision::Accept, true);
+							return;
+						}
+					}
+				}
+
+				void resolveImpl(bool acceptGame, bool automatic)
+				{
+					if (_readyCheckAnswered.exchange(true))
+					{
+						_logger->log(LogLevel::Debug, _logCategory, "Ready check already answered, ignoring the answer", "accept=" + std::to_string(acceptGame));
+						return;
+					}
+					auto scene = _scene.lock();
+					scene->send("gamefinder.ready.resolve", [=](obytestream& stream)
+					{
+						stream << acceptGame;
+					}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED);
+
+					// Time from the reception of the ready check to its answer, for the first answer only.
+					auto receivedAt = _readyCheckReceivedAt.exchange(0);
+					if (receivedAt != 0)
+					{
+						auto latency = std::chrono::steady_clock::now() - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(receivedAt));
+						_logger->log(LogLevel::Info, _logCategory, "Ready check answered",
+							"accept=" + std::to_string(acceptGame) + " auto=" + std::to_string(automatic)
+							+ " latency=" + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(latency).count()) + "us");
+					}
+				}
+
+				static bool isSearchInProgress(GameFinderStatus status)
+				{
+					return status != GameFinderStatus::Idle &&
+						status != GameFinderStatus::Canceled &&
+						status != GameFinderStatus::Failed &&
+						status != GameFinderStatus::Success;
+				}
+
 				pplx::task<void> findGameInternal(const std::string& provider, const StreamWriter& streamWriter)
 				{
-					if (currentState() != GameFinderStatus::Idle)
+					auto expected = GameFinderStatus::Idle;
+					if (!_currentState.compare_exchange_strong(expected, GameFinderStatus::Searching))
 					{
 						return pplx::task_from_exception<void>(std::runtime_error("Already finding a game !"));
 					}
 
-					_currentState = GameFinderStatus::Searching;
 					_gameFinderCTS = pplx::cancellation_token_source();
 
-					StreamWriter streamWriter2 = [provider, streamWriter](obytestream& stream)
+					// The latency vector follows the data of the caller, with its size and a marker:
+					// the server reads it from the end of the request, whatever the data extractors read.
+					auto latencies = _latencies.vector();
+					StreamWriter streamWriter2 = [provider, streamWriter, latencies](obytestream& stream)
 					{
 						Serializer serializer;
 						serializer.serialize(stream, provider);
 						streamWriter(stream);
+						obytestream latenciesStream;
+						serializer.serialize(latenciesStream, latencies);
+						auto bytes = latenciesStream.bytes();
+						auto size = static_cast<uint32_t>(bytes.size());
+						byte trailer[] = { static_cast<byte>(size >> 24), static_cast<byte>(size >> 16), static_cast<byte>(size >> 8), static_cast<byte>(size),
+							LATENCY_TRAILER_MARKER[0], LATENCY_TRAILER_MARKER[1], LATENCY_TRAILER_MARKER[2], LATENCY_TRAILER_MARKER[3] };
+						stream.write(bytes.data(), bytes.size());
+						stream.write(trailer, sizeof(trailer));
 					};
 
 					std::weak_ptr<GameFinderService> wThat = this->shared_from_this();
@@ -377,10 +648,10 @@ namespace Stormancer
 						{
 							if (auto that = wThat.lock())
 							{
-								if (that->_currentState != GameFinderStatus::Idle)
+								auto previous = that->_currentState.exchange(GameFinderStatus::Idle);
+								if (previous != GameFinderStatus::Idle)
 								{
-									that->_currentState = GameFinderStatus::Idle;
-									that->GameFinderStatusUpdated(that->_currentState);
+									that->GameFinderStatusUpdated(GameFinderStatus::Idle, previous);
 								}
 							}
 							throw;
@@ -404,12 +675,21 @@ namespace Stormancer
 				std::shared_ptr<RpcService> _rpcService;
 
 				pplx::cancellation_token_source _gameFinderCTS;
-
-				GameFinderStatus _currentState = GameFinderStatus::Idle;
+				std::vector<std::shared_ptr<IReadyCheckPolicy>> _readyCheckPolicies;
+				// Reception time of the pending ready check (steady_clock ticks), 0 once it is answered.
+				std::atomic<int64_t> _readyCheckReceivedAt{ 0 };
+				// Each ready check is answered once: by the first IReadyCheckPolicy that does not defer, or by the application.
+				std::atomic<bool> _readyCheckAnswered{ false };
+				std::vector<std::shared_ptr<ILatencyProbeTarget>> _probeTargets;
+				::Stormancer::details::LatencyEstimator _latencies;
+				pplx::cancellation_token_source _probesCts;
+
+				// Written from the network thread, read from any thread: every transition is a single atomic exchange.
+				std::atomic<GameFinderStatus> _currentState{ GameFinderStatus::Idle };
 				Serializer _serializer;
 
 				std::shared_ptr<ILogger> _logger;
-				std::string _logCategory = "GameFinder";
+				const std::string _logCategory = "GameFinder";
 			};
 
 			struct GameFinderContainer
@@ -439,9 +719,10 @@ namespace Stormancer
 			{
 			public:
 
-				GameFinder_Impl(std::weak_ptr<Users::UsersApi> users)
+				GameFinder_Impl(std::weak_ptr<Users::UsersApi> users, std::shared_ptr<IActionDispatcher> dispatcher)
+					: _users(users)
+					, _dispatcher(dispatcher)
 				{
-					_users = users;
 				}
 
 
@@ -603,17 +884,18 @@ namespace Stormancer
 									GameFoundEvent ev;
 									ev.gameFinder = gameFinderName;
 									ev.data = r;
-									that->gameFound(ev);
+									that->raise(&GameFinder_Impl::gameFound, ev);
 								}
 							});
-							container->gameFinderStateUpdatedSubscription = service->GameFinderStatusUpdated.subscribe([wThat, gameFinderName](GameFinderStatus s)
+							container->gameFinderStateUpdatedSubscription = service->GameFinderStatusUpdated.subscribe([wThat, gameFinderName](GameFinderStatus s, GameFinderStatus previous)
 							{
 								if (auto that = wThat.lock())
 								{
 									GameFinderStatusChangedEvent ev;
 									ev.gameFinder = gameFinderName;
 									ev.status = s;
-									that->gameFinderStateChanged(ev);
+									ev.previousStatus = previous;
+									that->raise(&GameFinder_Impl::gameFinderStateChanged, ev);
 								}
 							});
 							container->findGamefailedSubscription = service->FindGameRequestFailed.subscribe([wThat, gameFinderName](std::string reason)
@@ -623,7 +905,7 @@ namespace Stormancer
 									FindGameFailedEvent ev;
 									ev.gameFinder = gameFinderName;
 									ev.reason = reason;
-									that->findGameFailed(ev);
+									that->raise(&GameFinder_Impl::findGameFailed, ev);
 								}
 							});
 							return container;
@@ -677,11 +959,26 @@ namespace Stormancer
 					}
 				}
 
+				// Events are raised on the action dispatcher, so that handlers run on the thread the application dispatches its actions to.
+				template<typename TEvent>
+				void raise(Event<TEvent> GameFinder_Impl::* event, TEvent ev)
+				{
+					std::weak_ptr<GameFinder_Impl> wThat = this->shared_from_this();
+					_dispatcher->post([wThat, event, ev]
+						{
+							if (auto that = wThat.lock())
+							{
+								((*that).*event)(ev);
+							}
+						});
+				}
+
 				// recursive_mutex needed because of some corner error cases where continuations are run synchronously
 				std::recursive_mutex _lock;
 				std::unordered_map<std::string, pplx::task<std::shared_ptr<GameFinderContainer>>> _gameFinders;
 				std::unordered_map<std::string, pplx::cancellation_token_source> _pendingFindGameRequests;
 				std::weak_ptr<Users::UsersApi> _users;
+				std::shared_ptr<IActionDispatcher> _dispatcher;
 			};
 
 		}
@@ -695,7 +992,7 @@ namespace Stormancer
 				auto name = scene->getHostMetadata("stormancer.plugins.gamefinder");
 				if (!name.empty())
 				{
-					builder.registerDependency<details::GameFinderService, Scene>().singleInstance();
+					builder.registerDependency<details::GameFinderService, Scene, ContainerBuilder::All<IReadyCheckPolicy>, ContainerBuilder::All<ILatencyProbeTarget>>().singleInstance();
 				}
 			}
 
@@ -710,7 +1007,7 @@ namespace Stormancer
 
 			void registerClientDependencies(ContainerBuilder& builder) override
 			{
-				builder.registerDependency<details::GameFinder_Impl, Users::UsersApi>().as<GameFinderApi>().singleInstance();
+				builder.registerDependency<details::GameFinder_Impl, Users::UsersApi, IActionDispatcher>().as<GameFinderApi>().singleInstance();
 			}
 
 			void sceneDisconnecting(std::shared_ptr<Scene> scene) override
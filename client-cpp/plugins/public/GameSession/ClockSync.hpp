@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		/// <summary>
+		/// State of the synchronization of the local clock with the clock of the game session host.
+		/// </summary>
+		struct ClockSyncState
+		{
+			/// <summary>
+			/// True when <c>sessionTime()</c> is based on enough samples to be trusted. Always true on the host.
+			/// </summary>
+			bool synchronized = false;
+			/// <summary>
+			/// Estimated offset between the host clock and the local clock.
+			/// </summary>
+			std::chrono::microseconds offset{ 0 };
+			/// <summary>
+			/// Estimated drift of the host clock relative to the local clock, in microseconds per second.
+			/// </summary>
+			double drift = 0;
+			/// <summary>
+			/// Smallest round-trip time to the host among the samples in use.
+			/// </summary>
+			std::chrono::microseconds roundTripTime{ 0 };
+			/// <summary>
+			/// Number of samples the estimation is based on.
+			/// </summary>
+			std::size_t samples = 0;
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// NTP-style estimation of the offset and drift between the local clock and the clock of the host.
+			/// </summary>
+			/// <remarks>
+			/// Each sample is a request/response exchange with the host: t0 (client send), t1 (host receive), t2 (host send), t3 (client receive).
+			/// Only the quarter of the samples with the smallest round-trip times is kept, as queuing delays make the others asymmetric (see Tests/ClockSyncAccuracyTest.cpp).
+			/// The drift is the slope of a least-squares fit of these offsets over local time.
+			/// </remarks>
+			class ClockSynchronizer
+			{
+			public:
+				/// <summary>
+				/// Local monotonic time, in microseconds.
+				/// </summary>
+				static int64_t localTime()
+				{
+					return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+				}
+
+				/// <summary>
+				/// Forget every sample. On the host, the session time is the local time.
+				/// </summary>
+				void reset(bool isHost)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_isHost = isHost;
+					_samples.clear();
+					_state = ClockSyncState();
+					_state.synchronized = isHost;
+					_reference = 0;
+				}
+
+				void addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3)
+				{
+					Sample sample;
+					sample.roundTripTime = (t3 - t0) - (t2 - t1);
+					sample.offset = ((t1 - t0) + (t2 - t3)) / 2;
+					sample.localTime = t0 + (t3 - t0) / 2;
+					if (sample.roundTripTime < 0)
+					{
+						return;
+					}
+
+					std::lock_guard<std::mutex> lg(_mutex);
+					if (_isHost)
+					{
+						return;
+					}
+					_samples.push_back(sample);
+					if (_samples.size() > MAX_SAMPLES)
+					{
+						_samples.pop_front();
+					}
+					estimate();
+				}
+
+				/// <summary>
+				/// Convert a local time to the time of the host clock.
+				/// </summary>
+				int64_t toSessionTime(int64_t local) const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					if (_isHost)
+					{
+						return local;
+					}
+					return local + _state.offset.count() + static_cast<int64_t>(_state.drift * (local - _reference) / 1e6);
+				}
+
+				ClockSyncState state() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _state;
+				}
+
+				bool isHost() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _isHost;
+				}
+
+				std::size_t sampleCount() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _samples.size();
+				}
+
+			private:
+				struct Sample
+				{
+					int64_t roundTripTime = 0;
+					int64_t offset = 0;
+					int64_t localTime = 0;
+				};
+
+				void estimate()
+				{
+					std::vector<Sample> filtered(_samples.begin(), _samples.end());
+					std::sort(filtered.begin(), filtered.end(), [](const Sample& a, const Sample& b) { return a.roundTripTime < b.roundTripTime; });
+					filtered.resize(std::max<std::size_t>(1, filtered.size() / 4));
+
+					// Fit offset = a + drift * (localTime - reference), with the reference at the mean local time to keep the numbers small.
+					double meanTime = 0;
+					double meanOffset = 0;
+					for (auto& sample : filtered)
+					{
+						meanTime += static_cast<double>(sample.localTime);
+						meanOffset += static_cast<double>(sample.offset);
+					}
+					meanTime /= filtered.size();
+					meanOffset /= filtered.size();
+
+					double covariance = 0;
+					double variance = 0;
+					for (auto& sample : filtered)
+					{
+						auto dt = sample.localTime - meanTime;
+						covariance += dt * (sample.offset - meanOffset);
+						variance += dt * dt;
+					}
+
+					// A drift estimated over a short period is mostly noise.
+					auto span = _samples.back().localTime - _samples.front().localTime;
+					auto drift = (filtered.size() >= MIN_DRIFT_SAMPLES && span >= MIN_DRIFT_SPAN && variance > 0) ? covariance / variance : 0.0;
+
+					_reference = static_cast<int64_t>(meanTime);
+					_state.offset = std::chrono::microseconds(static_cast<int64_t>(meanOffset));
+					_state.drift = drift * 1e6;
+					_state.roundTripTime = std::chrono::microseconds(filtered.front().roundTripTime);
+					_state.samples = filtered.size();
+					_state.synchronized = _samples.size() >= MIN_SAMPLES;
+				}
+
+				static constexpr std::size_t MAX_SAMPLES = 64;
+				static constexpr std::size_t MIN_SAMPLES = 8;
+				static constexpr std::size_t MIN_DRIFT_SAMPLES = 8;
+				static constexpr int64_t MIN_DRIFT_SPAN = 10000000;
+
+				mutable std::mutex _mutex;
+				bool _isHost = false;
+				std::deque<Sample> _samples;
+				ClockSyncState _state;
+				int64_t _reference = 0;
+			};
+		}
+	}
+}
@@ -1,8 +1,22 @@
 #pragma once
 #include "Users/Users.hpp"
+#include "GameSession/InterestManagement.hpp"
+#include "GameSession/RouteChannels.hpp"
+#include "GameSession/PayloadCompression.hpp"
+#include "GameSession/Replication.hpp"
+#include "GameSession/ClockSync.hpp"
+#include "GameSession/ResultUpload.hpp"
+#include "GameSession/P2PUserRequests.hpp"
+#include "GameSession/HostElection.hpp"
+#include "GameSession/SessionRoster.hpp"
 #include "stormancer/IPlugin.h"
 #include "stormancer/msgpack_define.h"
 #include "stormancer/ITokenHandler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
 
 namespace Stormancer
 {
@@ -14,28 +28,20 @@ namespace Stormancer
 			Client
 		};
 
-		enum class PlayerStatus
-		{
-			NotConnected = 0,
-			Connected = 1,
-			Ready = 2,
-			Faulted = 3,
-			Disconnected = 4
-		};
-
-		struct SessionPlayer
+		/// <summary>
+		/// Shape of the P2P network formed by the players of a game session.
+		/// </summary>
+		enum class P2PTopology
 		{
-		public:
-			SessionPlayer(std::string playerId, PlayerStatus status, bool isHost = false)
-				: playerId(playerId)
-				, status(status)
-				, isHost(isHost)
-			{
-			}
-
-			std::string playerId;
-			PlayerStatus status;
-			bool isHost;
+			/// <summary>
+			/// Every client is connected to the host only. Client-to-client messages go through the host.
+			/// </summary>
+			Star,
+			/// <summary>
+			/// Every player opens a direct P2P connection to every other player.
+			/// Messages to players that could not be reached directly (NAT traversal failure) are relayed by the host.
+			/// </summary>
+			Mesh
 		};
 
 		struct ServerStartedMessage
@@ -45,15 +51,14 @@ namespace Stormancer
 			MSGPACK_DEFINE(p2pToken);
 		};
 
-		struct PlayerUpdate
+		struct MeshPeerToken
 		{
 		public:
 			std::string userId;
-			int status;
-			std::string data;
-			bool isHost;
+			std::string sessionId;
+			std::string p2pToken;
 
-			MSGPACK_DEFINE(userId, status, data, isHost);
+			MSGPACK_DEFINE(userId, sessionId, p2pToken);
 		};
 
 
@@ -65,6 +70,25 @@ namespace Stormancer
 			std::string endpoint;
 		};
 
+		/// <summary>
+		/// Outcome of a host migration, as seen by the local player.
+		/// </summary>
+		struct HostMigrationInfo
+		{
+			/// <summary>
+			/// User Id of the player elected as the new host.
+			/// </summary>
+			std::string newHostUserId;
+			/// <summary>
+			/// <c>true</c> if the local player is the new host.
+			/// </summary>
+			bool isHost = false;
+			/// <summary>
+			/// Time elapsed between the loss of the previous host and the restoration of P2P connectivity (and tunnel, if any) with the new host.
+			/// </summary>
+			std::chrono::milliseconds recoveryTime{ 0 };
+		};
+
 		class GameSessionsPlugin;
 
 		/// <summary>
@@ -100,15 +124,60 @@ namespace Stormancer
 
 			virtual pplx::task<Packetisp_ptr> postResult(const StreamWriter& streamWriter, pplx::cancellation_token ct = pplx::cancellation_token::none()) = 0;
 
+			/// <summary>
+			/// Post a large game result (e.g. a replay, or per tick statistics) to the server, without holding it in memory.
+			/// </summary>
+			/// <remarks>
+			/// The result is read from <c>producer</c> as it is uploaded, compressed when zlib support is enabled, and sent in chunks.
+			/// Memory use and the share of the connection taken by the upload are bounded by <c>options</c>, whatever the size of the result.
+			/// The server receives the same stream as with <c>postResult()</c>, so the producer must write what the server expects (e.g. a msgpack object).
+			/// </remarks>
+			/// <param name="producer">Writes the next bytes of the result. Returns 0 at the end of the result.</param>
+			/// <param name="options">Chunk size, flow control and retries of the upload.</param>
+			/// <param name="ct">Cancellation token.</param>
+			/// <returns>The result of the game session, as returned by the server.</returns>
+			template<typename TServerResult>
+			pplx::task<TServerResult> postResultStream(ResultProducer producer, ResultUploadOptions options = ResultUploadOptions(), pplx::cancellation_token ct = pplx::cancellation_token::none())
+			{
+				return postResultStreamImpl(producer, options, ct)
+					.then([](Packetisp_ptr packet)
+						{
+							Serializer serializer;
+							TServerResult serverResult = serializer.deserializeOne<TServerResult>(packet->stream);
+							return serverResult;
+						});
+			}
+
+			/// <summary>
+			/// Post a large game result to the server, and get the raw response of the server.
+			/// </summary>
+			/// <seealso cref="postResultStream()"/>
+			virtual pplx::task<Packetisp_ptr> postResultStreamImpl(ResultProducer producer, ResultUploadOptions options, pplx::cancellation_token ct) = 0;
+
 			virtual pplx::task<std::string> getUserFromBearerToken(const std::string& token) = 0;
 			virtual pplx::task<void> disconnectFromGameSession() = 0;
 
 			Event<void> onAllPlayersReady;
 
 			Event<GameSessionConnectionParameters> onRoleReceived;
+			/// <summary>
+			/// Event fired when the P2P tunnel to the host is open, with the local endpoint the game engine should send its UDP traffic to.
+			/// </summary>
+			/// <remarks>
+			/// On Linux, <c>UdpTunnelBridge</c> (GameSession/UdpTunnelBridge.hpp, not included by this header) can sit between the engine and this endpoint to move datagrams in batches.
+			/// </remarks>
 			Event<GameSessionConnectionParameters> onTunnelOpened;
 
-			Event<SessionPlayer, std::string> onPlayerStateChanged;
+			Event<const SessionPlayer&, const std::string&> onPlayerStateChanged;
+
+			/// <summary>
+			/// Raised once for each change of the roster, with every player it updated.
+			/// </summary>
+			/// <remarks>
+			/// The server sends the changes made to the roster within a short delay together: they are applied as a whole, then this event is raised.
+			/// <c>onPlayerStateChanged</c> is raised afterwards for each of these players.
+			/// </remarks>
+			Event<const std::vector<SessionPlayerUpdate>&> onPlayersStateChanged;
 
 			/// <summary>
 			/// Gets the underlying scene of the current gamesession, an empty shared ptr otherwise
@@ -128,8 +197,10 @@ namespace Stormancer
 			/// Get the P2P Host peer for this Game Session.
 			/// </summary>
 			/// <remarks>
-			/// Players in a game session are connected together through a star topology centered on a single player, the Host.
-			/// The players who are not the Host are called Clients.
+			/// Every game session has a single Host, elected among its players. The players who are not the Host are called Clients.
+			/// In <c>P2PTopology::Star</c>, Clients are only connected to the Host, which relays their messages to each other.
+			/// In <c>P2PTopology::Mesh</c>, Clients are also connected to each other when possible, and the Host relays only between the players that could not connect directly.
+			/// The topology is selected with <c>setP2PTopology()</c>.
 			/// </remarks>
 			/// <returns>
 			/// The <c>IP2PScenePeer</c> for the host of the session.
@@ -150,9 +221,271 @@ namespace Stormancer
 			/// Event that is triggered when a host migration happens.
 			/// </summary>
 			/// <remarks>
-			/// Host migration is not currently supported.
+			/// When the host leaves a P2P game session, the server elects a successor among the remaining players.
+			/// Every client then re-establishes its P2P connection (and tunnel, if <c>openTunnel</c> was set in <c>connectToGameSession()</c>) with the new host,
+			/// without going through the GameFinder again. This event is triggered once this is done.
+			/// If a tunnel is used, <c>onTunnelOpened</c> is triggered beforehand with the endpoint of the new host.
 			/// </remarks>
+			/// <param>The <c>IP2PScenePeer</c> of the new host, or nullptr if the local player is the new host.</param>
 			Event<std::shared_ptr<IP2PScenePeer>> onSessionHostChanged;
+
+			/// <summary>
+			/// Event that is triggered after <c>onSessionHostChanged</c>, with details and timings about the host migration.
+			/// </summary>
+			Event<HostMigrationInfo> onHostMigrationCompleted;
+
+			/// <summary>
+			/// Select the P2P topology used by the game sessions joined with subsequent calls to <c>connectToGameSession()</c>.
+			/// </summary>
+			/// <remarks>
+			/// The default topology is <c>P2PTopology::Star</c>.
+			/// In <c>P2PTopology::Mesh</c>, the connection to the host is established first, as in a star topology: <c>connectToGameSession()</c> does not wait for the other links.
+			/// All players of a session should use the same topology.
+			/// </remarks>
+			/// <param name="topology">The topology to use.</param>
+			virtual void setP2PTopology(P2PTopology topology) = 0;
+
+			/// <summary>
+			/// Send a message to every other player of the current game session.
+			/// </summary>
+			/// <remarks>
+			/// Players connected directly to the local player receive the message on <c>route</c>, like any other P2P message.
+			/// The message is relayed by the host to the remaining players (the other clients in a star topology, the players that could not be reached directly in a mesh topology),
+			/// who receive it through <c>onRelayedMessage</c>.
+			/// </remarks>
+			/// <param name="route">Route of the message. It must be declared with <c>MessageOriginFilter::Peer</c> on every player.</param>
+			/// <param name="streamWriter">Writes the content of the message.</param>
+			virtual void sendToSessionPeers(const std::string& route, const StreamWriter& streamWriter) = 0;
+
+			/// <summary>
+			/// Event that is triggered when a message sent with <c>sendToSessionPeers()</c> is received through the host.
+			/// </summary>
+			/// <param>Session Id of the player who sent the message.</param>
+			/// <param>Route the message was sent on.</param>
+			/// <param>Packet whose stream is positioned on the content of the message.</param>
+			Event<std::string, std::string, Packetisp_ptr> onRelayedMessage;
+
+			/// <summary>
+			/// Set the channels the local player is interested in, and publish them to the other players.
+			/// </summary>
+			/// <remarks>
+			/// Other players use this information to send channel messages only to the players who subscribed to them, with <c>sendToChannel()</c>.
+			/// Interests are only exchanged with directly connected peers: the host in a star topology, every player in a mesh topology.
+			/// </remarks>
+			/// <param name="channels">The complete list of channels the player is interested in. It replaces the previous one.</param>
+			virtual void setInterestChannels(const std::vector<std::string>& channels) = 0;
+
+			/// <summary>
+			/// Set the area of the game world the local player is interested in, and publish it to the other players.
+			/// </summary>
+			/// <remarks>
+			/// This can be called every time the player moves. Only the latest area is delivered.
+			/// </remarks>
+			/// <param name="x">X coordinate of the center of the area.</param>
+			/// <param name="y">Y coordinate of the center of the area.</param>
+			/// <param name="radius">Radius of the area.</param>
+			virtual void setInterestArea(float x, float y, float radius) = 0;
+
+			/// <summary>
+			/// Stop receiving messages sent to positions with <c>sendToArea()</c>.
+			/// </summary>
+			virtual void clearInterestArea() = 0;
+
+			/// <summary>
+			/// Get the session Ids of the peers who subscribed to a channel.
+			/// </summary>
+			virtual std::vector<std::string> getPeersInChannel(const std::string& channel) = 0;
+
+			/// <summary>
+			/// Get the session Ids of the peers whose interest area contains a position.
+			/// </summary>
+			virtual std::vector<std::string> getPeersInterestedIn(float x, float y) = 0;
+
+			/// <summary>
+			/// Send a P2P message to the peers who subscribed to a channel. Nothing is sent if there is none.
+			/// </summary>
+			virtual void sendToChannel(const std::string& channel, const std::string& route, const StreamWriter& streamWriter) = 0;
+
+			/// <summary>
+			/// Send a P2P message about a position of the game world to the peers whose interest area contains it. Nothing is sent if there is none.
+			/// </summary>
+			virtual void sendToArea(float x, float y, const std::string& route, const StreamWriter& streamWriter) = 0;
+
+			/// <summary>
+			/// Declare how the P2P messages of a route are delivered.
+			/// </summary>
+			/// <remarks>
+			/// The declaration applies to the messages sent with the <c>send*()</c> methods of <c>GameSession</c>, in this session and the following ones.
+			/// By default, every route is reliable and ordered, on an ordering channel of its own: a lost message on a route never delays the messages of other routes.
+			/// Routes that need to stay ordered with each other can share an ordering channel.
+			/// </remarks>
+			/// <param name="route">The route.</param>
+			/// <param name="mode">Delivery guarantees of the messages of the route.</param>
+			/// <param name="priority">Priority of the messages of the route.</param>
+			/// <param name="orderingChannel">Name of the ordering channel of the route. If empty, the route gets its own channel.</param>
+			virtual void declareRoute(const std::string& route, DeliveryMode mode, PacketPriority priority = PacketPriority::MEDIUM_PRIORITY, const std::string& orderingChannel = "") = 0;
+
+			/// <summary>
+			/// Send a P2P message with the delivery mode declared for its route.
+			/// </summary>
+			/// <param name="filter">Peers to send the message to.</param>
+			/// <param name="route">Route of the message.</param>
+			/// <param name="streamWriter">Writes the content of the message.</param>
+			virtual void send(const PeerFilter& filter, const std::string& route, const StreamWriter& streamWriter) = 0;
+
+			/// <summary>
+			/// Set the dictionary used to compress the payloads of compressed routes.
+			/// </summary>
+			/// <remarks>
+			/// The dictionary is negotiated when connecting to a game session: the host sends its dictionary to every player, who use it from then on.
+			/// Only the host's dictionary is adopted by the other players: a client's dictionary is only used with the players who loaded the same one,
+			/// until the host sends its own.
+			/// A payload is only compressed for the players who confirmed they use the same dictionary as the sender; the others receive it uncompressed.
+			/// Dictionaries larger than 128 KB are rejected.
+			/// Compression requires building with <c>STORMANCER_GAMESESSION_ZSTD</c> defined and linking against zstd.
+			/// </remarks>
+			/// <param name="dictionary">A zstd dictionary, for instance trained offline with <c>zstd --train</c> and loaded from a file.</param>
+			/// <returns><c>true</c> if the dictionary is valid and compression is supported.</returns>
+			virtual bool setCompressionDictionary(const std::string& dictionary) = 0;
+
+			/// <summary>
+			/// Start keeping the payloads sent and received on compressed routes of the current session, to train a dictionary with <c>trainCompressionDictionary()</c>.
+			/// </summary>
+			/// <remarks>
+			/// Payloads are only kept during a training: at most 2000 payloads of at most 4 KB, and 1 MB in total, the oldest being dropped first.
+			/// </remarks>
+			virtual void startCompressionDictionaryTraining() = 0;
+
+			/// <summary>
+			/// Train a compression dictionary on the payloads kept since <c>startCompressionDictionaryTraining()</c>, and make it the dictionary of the current session.
+			/// </summary>
+			/// <remarks>
+			/// Ends the training. Should be called by the host: other players only adopt the host's dictionary.
+			/// </remarks>
+			/// <param name="dictionaryCapacity">Maximum size of the dictionary, in bytes.</param>
+			/// <returns><c>true</c> if a dictionary could be trained.</returns>
+			virtual bool trainCompressionDictionary(std::size_t dictionaryCapacity = 16 * 1024) = 0;
+
+			/// <summary>
+			/// Declare a P2P route whose payloads are compressed with the session dictionary.
+			/// </summary>
+			/// <remarks>
+			/// Compressed routes must be declared before calling <c>connectToGameSession()</c>.
+			/// </remarks>
+			/// <param name="route">The route.</param>
+			/// <param name="handler">Called with the session Id of the sender and the decompressed payload.</param>
+			virtual void addCompressedRoute(const std::string& route, std::function<void(std::string, std::string)> handler) = 0;
+
+			/// <summary>
+			/// Send a payload on a compressed route, with the delivery mode declared for this route.
+			/// </summary>
+			/// <param name="route">The route. It must have been declared with <c>addCompressedRoute()</c> on the receivers.</param>
+			/// <param name="payload">The payload.</param>
+			/// <param name="sessionIds">Session Ids of the recipients. If empty, the payload is sent to every directly connected peer.</param>
+			virtual void sendCompressed(const std::string& route, const std::string& payload, const std::vector<std::string>& sessionIds = {}) = 0;
+
+			/// <summary>
+			/// Get the compression counters of the current game session.
+			/// </summary>
+			virtual CompressionStats getCompressionStats() = 0;
+
+			/// <summary>
+			/// Create or update an object replicated by the host to the other players.
+			/// </summary>
+			/// <remarks>
+			/// Only the host replicates objects. Changes are sent by <c>tickReplication()</c>:
+			/// each player only receives the objects that changed since the last snapshot it acknowledged.
+			/// </remarks>
+			/// <param name="id">Id of the object.</param>
+			/// <param name="type">Type of the object. Players receive it through the handler they registered for this type with <c>onReplicated()</c>.</param>
+			/// <param name="value">State of the object. It must be serializable with msgpack.</param>
+			template<typename T>
+			void replicate(uint64_t id, const std::string& type, const T& value)
+			{
+				StreamWriter streamWriter = [value](obytestream& stream)
+				{
+					Serializer serializer;
+					serializer.serialize(stream, value);
+				};
+				setReplicatedObject(id, type, streamWriter);
+			}
+
+			/// <summary>
+			/// Create or update a replicated object, whose state is written by <c>streamWriter</c>.
+			/// </summary>
+			/// <seealso cref="replicate()"/>
+			virtual void setReplicatedObject(uint64_t id, const std::string& type, const StreamWriter& streamWriter) = 0;
+
+			/// <summary>
+			/// Stop replicating an object. The other players are notified of its removal.
+			/// </summary>
+			virtual void removeReplicatedObject(uint64_t id) = 0;
+
+			/// <summary>
+			/// Send the changes of the replicated objects to the other players.
+			/// </summary>
+			/// <remarks>
+			/// Call this on the host at the snapshot rate of the game. Snapshots are split into fragments that fit in a datagram, sent unreliable.
+			/// Players acknowledge every fragment they receive, and a lost fragment is covered by the next snapshot, which contains all the changes the player did not acknowledge.
+			/// Does nothing if the local player is not the host.
+			/// </remarks>
+			virtual void tickReplication() = 0;
+
+			/// <summary>
+			/// Register the handlers of a type of replicated objects.
+			/// </summary>
+			/// <remarks>
+			/// Handlers must be registered for every replicated type, before calling <c>connectToGameSession()</c>.
+			/// </remarks>
+			/// <param name="type">Type of the objects.</param>
+			/// <param name="onUpdated">Called when an object is created or updated, with its id and its state.</param>
+			/// <param name="onRemoved">Called when an object is removed, with its id.</param>
+			template<typename T>
+			void onReplicated(const std::string& type, std::function<void(uint64_t, const T&)> onUpdated, std::function<void(uint64_t)> onRemoved = nullptr)
+			{
+				subscribeReplicatedType(type, [onUpdated](uint64_t id, ibytestream& stream)
+					{
+						Serializer serializer;
+						onUpdated(id, serializer.deserializeOne<T>(stream));
+					}, onRemoved);
+			}
+
+			/// <summary>
+			/// Register the handlers of a type of replicated objects. <c>onUpdated</c> reads the state of the object from the stream.
+			/// </summary>
+			/// <seealso cref="onReplicated()"/>
+			virtual void subscribeReplicatedType(const std::string& type, std::function<void(uint64_t, ibytestream&)> onUpdated, std::function<void(uint64_t)> onRemoved) = 0;
+
+			/// <summary>
+			/// Get the replication counters of the current game session.
+			/// </summary>
+			virtual ReplicationStats getReplicationStats() = 0;
+
+			/// <summary>
+			/// Get the current time on the clock of the game session host.
+			/// </summary>
+			/// <remarks>
+			/// Clients continuously synchronize their clock with the host, so every player of the session shares the same timeline
+			/// (e.g. for lag compensation, or to measure one-way latencies by timestamping messages).
+			/// The origin of this clock is arbitrary: only compare session times with each other.
+			/// When the host changes, the timeline is the clock of the new host.
+			/// Before the first exchange with the host, the local clock is returned. The estimate is then refined with every sample:
+			/// until the clock is synchronized (see <c>getClockSyncState()</c>), it can be off by up to half the round-trip time to the host.
+			/// </remarks>
+			virtual std::chrono::microseconds sessionTime() = 0;
+
+			/// <summary>
+			/// Get the state of the synchronization of the local clock with the clock of the host.
+			/// </summary>
+			virtual ClockSyncState getClockSyncState() = 0;
+
+			/// <summary>
+			/// Get whether every player of the session is ready, according to the player updates received so far.
+			/// </summary>
+			/// <remarks>
+			/// This is known as soon as the last player update arrives. <c>onAllPlayersReady</c> is raised when the server confirms it.
+			/// </remarks>
+			virtual bool areAllPlayersReady() = 0;
 		};
 
 
@@ -166,7 +499,8 @@ namespace Stormancer
 			public:
 				GameSessionService(std::weak_ptr<Scene> scene) :
 					_scene(scene),
-					_logger(scene.lock()->dependencyResolver().resolve<ILogger>())
+					_logger(scene.lock()->dependencyResolver().resolve<ILogger>()),
+					_dispatcher(scene.lock()->dependencyResolver().resolve<IActionDispatcher>())
 				{
 				}
 
@@ -188,11 +522,13 @@ namespace Stormancer
 					}
 
 					_receivedP2PToken = true;
+					_openTunnel = openTunnel;
 					_waitServerTce.set();
 					if (p2pToken.empty()) // Host
 					{
 						_logger->log(LogLevel::Trace, "gamession.p2ptoken", "received empty p2p token: I'm the host.");
 						_myP2PRole = P2PRole::Host;
+						_clock.reset(true);
 						onRoleReceived(P2PRole::Host);
 						_waitServerTce.set();
 						if (openTunnel)
@@ -212,7 +548,14 @@ namespace Stormancer
 									auto that = wThat.lock();
 									if (that)
 									{
+										{
+											std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+											that->_hostPeer = p2pPeer;
+											that->_directPeers[p2pPeer->sessionId()] = p2pPeer;
+										}
 										that->_myP2PRole = P2PRole::Client;
+										that->_clock.reset(false);
+										that->startClockSync();
 										that->onRoleReceived(P2PRole::Client);
 										if (that->_onConnectionOpened)
 										{
@@ -249,6 +592,10 @@ namespace Stormancer
 									try
 									{
 										auto p = t.get();
+										if (that && that->_topology == P2PTopology::Mesh)
+										{
+											that->connectMesh();
+										}
 										return p;
 									}
 									catch (const std::exception& ex)
@@ -272,7 +619,12 @@ namespace Stormancer
 
 				std::vector<SessionPlayer> getConnectedPlayers()
 				{
-					return this->_users;
+					return _roster.players();
+				}
+
+				bool areAllPlayersReady()
+				{
+					return _roster.allReady();
 				}
 
 				std::weak_ptr<Scene> getScene()
@@ -307,6 +659,60 @@ namespace Stormancer
 					}
 				}
 
+				// Until this is received, the server sends roster changes as individual "player.update" messages, as it does to older clients.
+				void advertisePlayerUpdateBatches()
+				{
+					if (auto scene = _scene.lock())
+					{
+						scene->send(PLAYER_UPDATE_BATCHES_ROUTE, [](obytestream&) {}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE);
+					}
+				}
+
+				// The server elects the host once the players have reported their connectivity: send it while the P2P token is requested.
+				void reportConnectivity(pplx::cancellation_token ct)
+				{
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						return;
+					}
+					ct = linkTokenToDisconnection(ct);
+					auto& resolver = scene->dependencyResolver();
+					auto natTypeProviders = resolver.resolveAll<INatTypeProvider>();
+					auto probe = std::make_shared<details::ConnectivityProbe>(resolver.resolve<RpcService>(),
+						resolver.resolveAll<ILatencyProbeTarget>(),
+						natTypeProviders.empty() ? nullptr : natTypeProviders.front());
+
+					std::weak_ptr<GameSessionService> wThat = this->shared_from_this();
+					probe->measure(ct).then([wThat](pplx::task<ConnectivityReport> task)
+					{
+						auto that = wThat.lock();
+						if (!that)
+						{
+							return;
+						}
+						try
+						{
+							auto report = task.get();
+							that->_logger->log(LogLevel::Info, "gamesession.hostElection", "Connectivity measured",
+								"upload=" + std::to_string(report.uploadKbps) + "kbps natType=" + std::to_string(static_cast<int>(report.natType)) + " latencies=" + std::to_string(report.latencies.size()));
+							if (auto scene = that->_scene.lock())
+							{
+								scene->send(CONNECTIVITY_ROUTE, [report](obytestream& stream)
+								{
+									Serializer serializer;
+									serializer.serialize(stream, report);
+								}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE);
+							}
+						}
+						catch (const std::exception& ex)
+						{
+							// The server elects the host without this player's connectivity.
+							that->_logger->log(LogLevel::Warn, "gamesession.hostElection", "Failed to measure the connectivity", ex.what());
+						}
+					});
+				}
+
 				pplx::task<void> reset(pplx::cancellation_token ct)
 				{
 					ct = linkTokenToDisconnection(ct);
@@ -333,8 +739,32 @@ namespace Stormancer
 
 				void onDisconnecting()
 				{
+					if (_peerDisconnectedSubscription.is_subscribed())
+					{
+						_peerDisconnectedSubscription.unsubscribe();
+					}
+					if (_peerConnectedSubscription.is_subscribed())
+					{
+						_peerConnectedSubscription.unsubscribe();
+					}
 					_tunnel = nullptr;
-					_users.clear();
+					{
+						std::lock_guard<std::mutex> lg(_hostMigrationMutex);
+						_hostPeer = nullptr;
+						_directPeers.clear();
+						_peerDictionaries.clear();
+					}
+					_interests.clear();
+					_replicationClient.reset();
+					if (_userRequests)
+					{
+						if (auto scene = _scene.lock())
+						{
+							scene->dependencyResolver().resolve<Users::UsersApi>()->removeRequestTransport(_userRequests);
+						}
+						_userRequests->clear();
+					}
+					_roster.clear();
 					_disconnectionCts.cancel();
 				}
 
@@ -353,63 +783,822 @@ namespace Stormancer
 						});
 				}
 
-				pplx::task<Packetisp_ptr> sendGameResults(const StreamWriter& streamWriter, pplx::cancellation_token ct)
+				pplx::task<Packetisp_ptr> sendGameResults(const StreamWriter& streamWriter, pplx::cancellation_token ct)
+				{
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						return pplx::task_from_exception<Packetisp_ptr>(std::runtime_error("Scene deleted"));
+					}
+
+					auto rpc = scene->dependencyResolver().resolve<RpcService>();
+					return rpc->rpc<Packetisp_ptr>("gamesession.postresults", ct, streamWriter);
+				}
+
+				pplx::task<Packetisp_ptr> streamGameResults(ResultProducer producer, ResultUploadOptions options, pplx::cancellation_token ct)
+				{
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						return pplx::task_from_exception<Packetisp_ptr>(std::runtime_error("Scene deleted"));
+					}
+
+					auto rpc = scene->dependencyResolver().resolve<RpcService>();
+					auto uploader = std::make_shared<details::ResultUploader>(rpc, producer, options, ct);
+					return uploader->run()
+						.then([uploader](Packetisp_ptr packet)
+							{
+								return packet;
+							});
+				}
+
+				P2PRole getMyP2PRole() const { return _myP2PRole; }
+
+				void setTopology(P2PTopology topology)
+				{
+					_topology = topology;
+				}
+
+				void setInterestChannels(const std::vector<std::string>& channels)
+				{
+					std::lock_guard<std::mutex> lg(_interestMutex);
+					_localInterest.channels = channels;
+					publishInterest(PeerFilter::matchAllP2P(), _localInterest);
+				}
+
+				void setInterestArea(bool hasArea, InterestArea area)
+				{
+					std::lock_guard<std::mutex> lg(_interestMutex);
+					_localInterest.hasArea = hasArea;
+					_localInterest.area = area;
+					publishInterest(PeerFilter::matchAllP2P(), _localInterest);
+				}
+
+				const details::InterestIndex& interests() const
+				{
+					return _interests;
+				}
+
+				bool useDictionary(const std::string& dictionary)
+				{
+					auto id = _compressor.setDictionary(dictionary);
+					if (id == 0)
+					{
+						return false;
+					}
+					_logger->log(LogLevel::Info, "gamesession.compression", "Using compression dictionary", std::to_string(id));
+					if (auto scene = _scene.lock())
+					{
+						// Clients only announce the dictionary they use: players who loaded the same one compress the payloads they exchange with them.
+						if (_myP2PRole == P2PRole::Host)
+						{
+							scene->send(PeerFilter::matchAllP2P(), DICTIONARY_ROUTE, [dictionary](obytestream& stream)
+								{
+									Serializer serializer;
+									serializer.serialize(stream, dictionary);
+								}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE, DICTIONARY_ROUTE);
+						}
+						sendDictionaryAck(PeerFilter::matchAllP2P(), id);
+					}
+					return true;
+				}
+
+				std::chrono::microseconds sessionTime() const
+				{
+					return std::chrono::microseconds(_clock.toSessionTime(details::ClockSynchronizer::localTime()));
+				}
+
+				ClockSyncState clockSyncState() const
+				{
+					return _clock.state();
+				}
+
+				details::ReplicationServer& replicationServer()
+				{
+					return _replicationServer;
+				}
+
+				details::ReplicationClient& replicationClient()
+				{
+					return _replicationClient;
+				}
+
+				void tickReplication()
+				{
+					auto scene = _scene.lock();
+					if (!scene || _myP2PRole != P2PRole::Host)
+					{
+						return;
+					}
+					// Not sequenced: the transport would drop a fragment overtaken by a later one of the same snapshot.
+					// ReplicationClient::apply() orders the states of each object by itself.
+					_replicationServer.tick([scene](const std::string& sessionId, const StreamWriter& streamWriter)
+						{
+							scene->send(PeerFilter::matchPeers(sessionId), REPLICATION_SNAPSHOT_ROUTE, streamWriter, PacketPriority::HIGH_PRIORITY, PacketReliability::UNRELIABLE, REPLICATION_SNAPSHOT_ROUTE);
+						});
+				}
+
+				void startDictionaryTraining()
+				{
+					_compressor.startTraining();
+				}
+
+				bool trainDictionary(std::size_t dictionaryCapacity)
+				{
+					if (_compressor.train(dictionaryCapacity) == 0)
+					{
+						return false;
+					}
+					return useDictionary(_compressor.dictionary());
+				}
+
+				CompressionStats compressionStats() const
+				{
+					return _compressor.stats();
+				}
+
+				std::string decompress(const details::CompressedPayload& payload)
+				{
+					return _compressor.decompress(payload);
+				}
+
+				void sendCompressed(std::vector<std::string> sessionIds, const std::string& route, const std::string& payload, const RouteChannel& channel)
+				{
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						throw std::runtime_error("Scene destroyed");
+					}
+
+					std::vector<std::string> compressedTargets;
+					std::vector<std::string> plainTargets;
+					auto dictionaryId = _compressor.dictionaryId();
+					{
+						std::lock_guard<std::mutex> lg(_hostMigrationMutex);
+						if (sessionIds.empty())
+						{
+							for (auto& peer : _directPeers)
+							{
+								sessionIds.push_back(peer.first);
+							}
+						}
+						for (auto& sessionId : sessionIds)
+						{
+							auto it = _peerDictionaries.find(sessionId);
+							if (dictionaryId != 0 && it != _peerDictionaries.end() && it->second == dictionaryId)
+							{
+								compressedTargets.push_back(sessionId);
+							}
+							else
+							{
+								plainTargets.push_back(sessionId);
+							}
+						}
+					}
+
+					if (!compressedTargets.empty())
+					{
+						auto compressed = _compressor.compress(payload);
+						scene->send(PeerFilter::matchPeers(compressedTargets), route, [compressed](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, compressed);
+							}, channel.priority, channel.reliability(), channel.orderingChannel);
+					}
+					if (!plainTargets.empty())
+					{
+						details::CompressedPayload plain;
+						plain.originalSize = static_cast<uint32_t>(payload.size());
+						plain.data = payload;
+						scene->send(PeerFilter::matchPeers(plainTargets), route, [plain](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, plain);
+							}, channel.priority, channel.reliability(), channel.orderingChannel);
+					}
+				}
+
+				void sendToPeers(const std::vector<std::string>& sessionIds, const std::string& route, const StreamWriter& streamWriter, const RouteChannel& channel)
+				{
+					if (sessionIds.empty())
+					{
+						return;
+					}
+					if (auto scene = _scene.lock())
+					{
+						scene->send(PeerFilter::matchPeers(sessionIds), route, streamWriter, channel.priority, channel.reliability(), channel.orderingChannel);
+					}
+				}
+
+				void sendToSessionPeers(const std::string& route, const StreamWriter& streamWriter, const RouteChannel& channel)
+				{
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						throw std::runtime_error("Scene destroyed");
+					}
+
+					std::vector<std::string> directPeers;
+					std::shared_ptr<IP2PScenePeer> host;
+					{
+						std::lock_guard<std::mutex> lg(_hostMigrationMutex);
+						host = _hostPeer;
+						directPeers.reserve(_directPeers.size());
+						for (auto& peer : _directPeers)
+						{
+							directPeers.push_back(peer.first);
+						}
+					}
+
+					if (!directPeers.empty())
+					{
+						scene->send(PeerFilter::matchPeers(directPeers), route, streamWriter, channel.priority, channel.reliability(), channel.orderingChannel);
+					}
+
+					// The host forwards the message to every player except the sender and the players it was already sent to.
+					if (host)
+					{
+						host->send(RELAY_ROUTE, [route, directPeers, channel, streamWriter](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, route, directPeers, static_cast<int>(channel.mode), static_cast<int>(channel.priority), channel.orderingChannel);
+								streamWriter(stream);
+							}, channel.priority, channel.reliability(), channel.orderingChannel);
+					}
+				}
+
+				Event<void> onAllPlayersReady;
+				Event<P2PRole> onRoleReceived;
+				Event<std::shared_ptr<Stormancer::P2PTunnel>> onTunnelOpened;
+				Event<void> onShutdownReceived;
+				Event<const SessionPlayer&, const std::string&> onPlayerStateChanged;
+				// Shared with the game sessions it is raised on, instead of copied for each of them.
+				Event<std::shared_ptr<const std::vector<SessionPlayerUpdate>>> onPlayersStateChanged;
+				Event<std::shared_ptr<IP2PScenePeer>, HostMigrationInfo> onHostMigrated;
+				Event<std::string, std::string, Packetisp_ptr> onRelayedMessage;
+			private:
+
+				// The roster is the only trusted source of the user id of a P2P peer.
+				void setPlayerSession(const PlayerUpdate& update)
+				{
+					if (!update.sessionId.empty() && !_userRequests->setPlayerSession(update.userId, update.sessionId))
+					{
+						_logger->log(LogLevel::Warn, "gamesession.users", "A peer announced a user id that does not match the roster of the server", update.sessionId);
+					}
+				}
+
+				void initialize()
+				{
+					_disconnectionCts = pplx::cancellation_token_source();
+					std::weak_ptr<GameSessionService> wThat = this->shared_from_this();
+
+					// Requests between players of the session go through their P2P connection rather than through the server.
+					auto users = _scene.lock()->dependencyResolver().resolve<Users::UsersApi>();
+					_userRequests = std::make_shared<details::P2PUserRequests>(_scene, users);
+					users->addRequestTransport(_userRequests);
+					std::weak_ptr<details::P2PUserRequests> wUserRequests = _userRequests;
+					_scene.lock()->addRoute(details::P2PUserRequests::IDENTITY_ROUTE, [wUserRequests, wThat](Packetisp_ptr packet) {
+						if (auto userRequests = wUserRequests.lock())
+						{
+							if (!userRequests->onIdentity(packet))
+							{
+								if (auto that = wThat.lock())
+								{
+									that->_logger->log(LogLevel::Warn, "gamesession.users", "A peer announced a user id that does not match the roster of the server", packet->connection->sessionId());
+								}
+							}
+						}
+						}, MessageOriginFilter::Peer);
+					_scene.lock()->addRoute(details::P2PUserRequests::REQUEST_ROUTE, [wUserRequests](Packetisp_ptr packet) {
+						if (auto userRequests = wUserRequests.lock())
+						{
+							userRequests->onRequest(packet);
+						}
+						}, MessageOriginFilter::Peer);
+					_scene.lock()->addRoute(details::P2PUserRequests::RESPONSE_ROUTE, [wUserRequests](Packetisp_ptr packet) {
+						if (auto userRequests = wUserRequests.lock())
+						{
+							userRequests->onResponse(packet);
+						}
+						}, MessageOriginFilter::Peer);
+					_scene.lock()->addRoute(details::P2PUserRequests::CANCEL_ROUTE, [wUserRequests](Packetisp_ptr packet) {
+						if (auto userRequests = wUserRequests.lock())
+						{
+							userRequests->onCancel(packet);
+						}
+						}, MessageOriginFilter::Peer);
+
+
+
+					_scene.lock()->addRoute("player.update", [wThat](Packetisp_ptr packet)
+						{
+							auto that = wThat.lock();
+							if (that)
+							{
+								auto update = packet->readObject<Stormancer::GameSessions::PlayerUpdate>();
+								that->setPlayerSession(update);
+								auto player = that->_roster.update(update);
+								that->onPlayerStateChanged(player, update.data);
+							}
+						});
+
+					_scene.lock()->addRoute("players.update", [wThat](Packetisp_ptr packet)
+						{
+							auto that = wThat.lock();
+							if (that)
+							{
+								auto batch = packet->readObject<Stormancer::GameSessions::PlayerUpdateBatch>();
+								for (auto& update : batch.updates)
+								{
+									that->setPlayerSession(update);
+								}
+								auto updated = std::make_shared<std::vector<SessionPlayerUpdate>>();
+								if (that->_roster.update(batch, *updated))
+								{
+									that->onPlayersStateChanged(std::move(updated));
+								}
+							}
+						});
+
+					_scene.lock()->addRoute("players.allReady", [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							that->onAllPlayersReady();
+						}
+						});
+
+					_scene.lock()->addRoute("gamesession.hostChanged", [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							that->migrateHost(packet->readObject<std::string>());
+						}
+						});
+
+					_scene.lock()->addRoute(RELAY_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							that->relay(packet);
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(RELAYED_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							std::string origin;
+							std::string route;
+							Serializer serializer;
+							serializer.deserialize(packet->stream, origin, route);
+							that->onRelayedMessage(origin, route, packet);
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(CLOCK_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto receivedAt = details::ClockSynchronizer::localTime();
+						auto that = wThat.lock();
+						if (that && that->_myP2PRole == P2PRole::Host)
+						{
+							auto sentAt = packet->readObject<int64_t>();
+							if (auto scene = that->_scene.lock())
+							{
+								scene->send(PeerFilter::matchPeers(packet->connection->sessionId()), CLOCK_REPLY_ROUTE, [sentAt, receivedAt](obytestream& stream)
+									{
+										Serializer serializer;
+										serializer.serialize(stream, sentAt, receivedAt, details::ClockSynchronizer::localTime());
+									}, PacketPriority::IMMEDIATE_PRIORITY, PacketReliability::UNRELIABLE, CLOCK_ROUTE);
+							}
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(CLOCK_REPLY_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto receivedAt = details::ClockSynchronizer::localTime();
+						auto that = wThat.lock();
+						if (that)
+						{
+							{
+								// Replies of a previous host would not measure the current clock.
+								std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+								if (!that->_hostPeer || that->_hostPeer->sessionId() != packet->connection->sessionId())
+								{
+									return;
+								}
+							}
+							int64_t t0, t1, t2;
+							Serializer serializer;
+							serializer.deserialize(packet->stream, t0, t1, t2);
+							that->_clock.addSample(t0, t1, t2, receivedAt);
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(REPLICATION_SNAPSHOT_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							details::SnapshotFragment fragment;
+							auto changes = std::make_shared<std::vector<details::ReplicationClient::Change>>();
+							try
+							{
+								fragment = that->_replicationClient.apply(packet->stream, *changes);
+							}
+							catch (const std::exception& ex)
+							{
+								that->_logger->log(LogLevel::Warn, "gamesession.replication", "Could not apply a snapshot", ex.what());
+							}
+							if (fragment.sequence != 0)
+							{
+								auto scene = that->_scene.lock();
+								if (scene)
+								{
+									// Every fragment is acknowledged: acks must not be sequenced either.
+									scene->send(PeerFilter::matchPeers(packet->connection->sessionId()), REPLICATION_ACK_ROUTE, [fragment](obytestream& stream)
+										{
+											Serializer serializer;
+											serializer.serialize(stream, fragment.sequence, fragment.fragment);
+										}, PacketPriority::HIGH_PRIORITY, PacketReliability::UNRELIABLE, REPLICATION_ACK_ROUTE);
+								}
+							}
+							// The fragment is acknowledged from the network thread, the application's handlers run on the action dispatcher.
+							if (!changes->empty())
+							{
+								that->_dispatcher->post([changes]()
+									{
+										details::ReplicationClient::notify(*changes);
+									});
+							}
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(REPLICATION_ACK_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							details::SnapshotFragment fragment;
+							Serializer serializer;
+							serializer.deserialize(packet->stream, fragment.sequence, fragment.fragment);
+							that->_replicationServer.ack(packet->connection->sessionId(), fragment);
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(DICTIONARY_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							auto sessionId = packet->connection->sessionId();
+							bool fromHost;
+							{
+								std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+								fromHost = that->_hostPeer && that->_hostPeer->sessionId() == sessionId;
+							}
+							// Only the host's dictionary is adopted: other players cannot replace the dictionary of the session.
+							auto dictionary = fromHost ? packet->readObject<std::string>() : std::string();
+							if (!fromHost || dictionary.size() > details::PayloadCompressor::MAX_DICTIONARY_SIZE)
+							{
+								that->_logger->log(LogLevel::Warn, "gamesession.compression", fromHost ? "Ignored a dictionary too large" : "Ignored a dictionary sent by another player than the host", sessionId);
+								that->sendDictionaryAck(PeerFilter::matchPeers(sessionId), that->_compressor.dictionaryId());
+								return;
+							}
+							// Adopted on the action dispatcher, as the payloads of compressed routes are decompressed, so that they use the dictionary in the order they were received.
+							that->_dispatcher->post([wThat, dictionary]()
+								{
+									if (auto that = wThat.lock())
+									{
+										that->useDictionary(dictionary);
+									}
+								});
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(DICTIONARY_ACK_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							auto dictionaryId = packet->readObject<uint32_t>();
+							std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+							that->_peerDictionaries[packet->connection->sessionId()] = dictionaryId;
+						}
+						}, MessageOriginFilter::Peer);
+
+					_scene.lock()->addRoute(INTEREST_ROUTE, [wThat](Packetisp_ptr packet) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							auto sessionId = packet->connection->sessionId();
+							if (!that->_interests.update(sessionId, packet->readObject<InterestUpdate>()))
+							{
+								that->_logger->log(LogLevel::Warn, "gamesession.interests", "Ignored an invalid interest area", sessionId);
+							}
+						}
+						}, MessageOriginFilter::Peer);
+
+					_peerConnectedSubscription = _scene.lock()->onPeerConnected().subscribe([wThat](std::shared_ptr<IP2PScenePeer> peer) {
+						auto that = wThat.lock();
+						if (that && peer)
+						{
+							{
+								std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+								that->_directPeers[peer->sessionId()] = peer;
+							}
+							that->_replicationServer.addPeer(peer->sessionId());
+							that->_userRequests->sendIdentity(peer->sessionId());
+							// Late joiners need the host's dictionary, and our interests to route their messages.
+							auto dictionary = that->_myP2PRole == P2PRole::Host ? that->_compressor.dictionary() : std::string();
+							if (!dictionary.empty())
+							{
+								that->_scene.lock()->send(PeerFilter::matchPeers(peer->sessionId()), DICTIONARY_ROUTE, [dictionary](obytestream& stream)
+									{
+										Serializer serializer;
+										serializer.serialize(stream, dictionary);
+									}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE, DICTIONARY_ROUTE);
+							}
+							std::lock_guard<std::mutex> lg(that->_interestMutex);
+							that->publishInterest(PeerFilter::matchPeers(peer->sessionId()), that->_localInterest);
+						}
+						});
+
+					_peerDisconnectedSubscription = _scene.lock()->onPeerDisconnected().subscribe([wThat](std::shared_ptr<IP2PScenePeer> peer) {
+						auto that = wThat.lock();
+						if (that)
+						{
+							std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+							if (peer)
+							{
+								that->_directPeers.erase(peer->sessionId());
+								that->_peerDictionaries.erase(peer->sessionId());
+								that->_replicationServer.removePeer(peer->sessionId());
+								that->_interests.remove(peer->sessionId());
+								that->_userRequests->removePeer(peer->sessionId());
+							}
+							if (that->_hostPeer && peer && that->_hostPeer->sessionId() == peer->sessionId())
+							{
+								// The P2P link usually drops before the server notices that the host is gone: start the recovery clock here.
+								that->_logger->log(LogLevel::Warn, "gamesession.hostMigration", "Lost P2P connection with the session host", peer->sessionId());
+								that->_hostLostAt = std::chrono::steady_clock::now();
+								that->_hostPeer = nullptr;
+							}
+						}
+						});
+				}
+
+				// Re-run the P2P initialization against the host elected by the server, instead of dropping the whole session.
+				void migrateHost(std::string newHostUserId)
+				{
+					{
+						std::lock_guard<std::mutex> lg(_hostMigrationMutex);
+						if (_hostLostAt == std::chrono::steady_clock::time_point())
+						{
+							_hostLostAt = std::chrono::steady_clock::now();
+						}
+						_hostPeer = nullptr;
+					}
+					_logger->log(LogLevel::Info, "gamesession.hostMigration", "Host migration started", newHostUserId);
+
+					// The sequence numbers of the new host start over: forget the state replicated by the previous one.
+					_replicationClient.reset();
+					_replicationServer.reset();
+					_tunnel = nullptr;
+					_receivedP2PToken = false;
+					auto openTunnel = _openTunnel;
+					auto ct = _disconnectionCts.get_token();
+					std::weak_ptr<GameSessionService> wThat = this->shared_from_this();
+					requestP2PToken(ct)
+						.then([wThat, openTunnel, ct](std::string p2pToken)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									throw PointerDeletedException("GameSessionService");
+								}
+								return that->initializeP2P(p2pToken, openTunnel, ct);
+							}, ct)
+						.then([wThat, newHostUserId](pplx::task<std::shared_ptr<IP2PScenePeer>> task)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									return;
+								}
+
+								std::chrono::steady_clock::time_point hostLostAt;
+								{
+									std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+									hostLostAt = that->_hostLostAt;
+									that->_hostLostAt = std::chrono::steady_clock::time_point();
+								}
+
+								try
+								{
+									auto host = task.get();
+
+									HostMigrationInfo info;
+									info.newHostUserId = newHostUserId;
+									info.isHost = that->_myP2PRole == P2PRole::Host;
+									info.recoveryTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - hostLostAt);
+									that->_logger->log(LogLevel::Info, "gamesession.hostMigration", "Host migration completed", "newHost=" + newHostUserId + " recoveryTime=" + std::to_string(info.recoveryTime.count()) + "ms");
+									that->onHostMigrated(host, info);
+								}
+								catch (const std::exception& ex)
+								{
+									that->_logger->log(LogLevel::Error, "gamesession.hostMigration", "Host migration failed", ex);
+								}
+							});
+				}
+
+				// Sample the host clock at a fast pace until synchronized, then slowly to follow its drift.
+				void startClockSync()
+				{
+					bool expected = false;
+					if (_clockSyncRunning.compare_exchange_strong(expected, true))
+					{
+						sendClockSyncRequest();
+					}
+				}
+
+				void sendClockSyncRequest()
+				{
+					std::shared_ptr<IP2PScenePeer> host;
+					{
+						std::lock_guard<std::mutex> lg(_hostMigrationMutex);
+						host = _hostPeer;
+					}
+					auto scene = _scene.lock();
+					if (scene && host)
+					{
+						scene->send(PeerFilter::matchPeers(host->sessionId()), CLOCK_ROUTE, [](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, details::ClockSynchronizer::localTime());
+							}, PacketPriority::IMMEDIATE_PRIORITY, PacketReliability::UNRELIABLE, CLOCK_ROUTE);
+					}
+
+					auto delay = _clock.state().synchronized ? CLOCK_SYNC_INTERVAL : CLOCK_SYNC_BURST_INTERVAL;
+					std::weak_ptr<GameSessionService> wThat = this->shared_from_this();
+					taskDelay(delay, _disconnectionCts.get_token())
+						.then([wThat](pplx::task<void> task)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									return;
+								}
+								try
+								{
+									task.get();
+								}
+								catch (const pplx::task_canceled&)
+								{
+									that->_clockSyncRunning = false;
+									return;
+								}
+								// The host does not synchronize: it is the reference clock.
+								if (that->_clock.isHost())
+								{
+									that->_clockSyncRunning = false;
+									return;
+								}
+								that->sendClockSyncRequest();
+							});
+				}
+
+				void sendDictionaryAck(const PeerFilter& filter, uint32_t dictionaryId)
+				{
+					if (auto scene = _scene.lock())
+					{
+						scene->send(filter, DICTIONARY_ACK_ROUTE, [dictionaryId](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, dictionaryId);
+							}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED, DICTIONARY_ROUTE);
+					}
+				}
+
+				void publishInterest(const PeerFilter& filter, InterestUpdate interest)
+				{
+					if (auto scene = _scene.lock())
+					{
+						scene->send(filter, INTEREST_ROUTE, [interest](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, interest);
+							}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_SEQUENCED);
+					}
+				}
+
+				// Open a direct connection to every player we are not connected to yet.
+				// The server hands out each pair of players to only one of them, so that a link is never opened twice.
+				void connectMesh()
 				{
 					auto scene = _scene.lock();
 					if (!scene)
 					{
-						return pplx::task_from_exception<Packetisp_ptr>(std::runtime_error("Scene deleted"));
+						return;
 					}
 
+					auto ct = _disconnectionCts.get_token();
 					auto rpc = scene->dependencyResolver().resolve<RpcService>();
-					return rpc->rpc<Packetisp_ptr>("gamesession.postresults", ct, streamWriter);
-				}
-
-				P2PRole getMyP2PRole() const { return _myP2PRole; }
-
-				Event<void> onAllPlayersReady;
-				Event<P2PRole> onRoleReceived;
-				Event<std::shared_ptr<Stormancer::P2PTunnel>> onTunnelOpened;
-				Event<void> onShutdownReceived;
-				Event<SessionPlayer, std::string> onPlayerStateChanged;
-			private:
-
-				void initialize()
-				{
-					_disconnectionCts = pplx::cancellation_token_source();
 					std::weak_ptr<GameSessionService> wThat = this->shared_from_this();
+					rpc->rpc<std::vector<MeshPeerToken>>("GameSession.GetMeshP2PTokens", ct)
+						.then([wThat, ct](std::vector<MeshPeerToken> tokens)
+							{
+								auto that = wThat.lock();
+								auto scene = that ? that->_scene.lock() : nullptr;
+								if (!scene)
+								{
+									return;
+								}
 
+								that->_logger->log(LogLevel::Trace, "gamesession.mesh", "Opening direct P2P connections", std::to_string(tokens.size()));
+								for (auto& token : tokens)
+								{
+									auto userId = token.userId;
+									scene->openP2PConnection(token.p2pToken, ct)
+										.then([wThat, userId](pplx::task<std::shared_ptr<IP2PScenePeer>> task)
+											{
+												auto that = wThat.lock();
+												if (!that)
+												{
+													return;
+												}
 
-
-					_scene.lock()->addRoute("player.update", [wThat](Packetisp_ptr packet)
-						{
-							auto that = wThat.lock();
-							if (that)
+												try
+												{
+													auto peer = task.get();
+													std::lock_guard<std::mutex> lg(that->_hostMigrationMutex);
+													that->_directPeers[peer->sessionId()] = peer;
+												}
+												catch (const std::exception& ex)
+												{
+													that->_logger->log(LogLevel::Warn, "gamesession.mesh", "Direct P2P connection to " + userId + " failed, messages to this player will be relayed by the host", ex.what());
+												}
+											});
+								}
+							}, ct)
+						.then([wThat](pplx::task<void> task)
 							{
-								auto update = packet->readObject<Stormancer::GameSessions::PlayerUpdate>();
-								SessionPlayer player(update.userId, (PlayerStatus)update.status, update.isHost);
-
-								auto end = that->_users.end();
-								auto it = std::find_if(that->_users.begin(), end, [player](SessionPlayer p) { return p.playerId == player.playerId; });
-								if (it == end)
+								try
 								{
-									that->_users.push_back(player);
+									task.get();
 								}
-								else
+								catch (const std::exception& ex)
 								{
-									*it = player;
+									if (auto that = wThat.lock())
+									{
+										that->_logger->log(LogLevel::Warn, "gamesession.mesh", "Could not retrieve the mesh P2P tokens, falling back to the star topology", ex.what());
+									}
 								}
-								that->onPlayerStateChanged(player, update.data);
-							}
-						});
+							});
+				}
 
-					_scene.lock()->addRoute("players.allReady", [wThat](Packetisp_ptr packet) {
-						auto that = wThat.lock();
-						if (that)
+				// Host side of sendToSessionPeers(): forward a message to the players its sender could not reach directly.
+				void relay(Packetisp_ptr packet)
+				{
+					auto scene = _scene.lock();
+					if (!scene || _myP2PRole != P2PRole::Host)
+					{
+						return;
+					}
+
+					std::string route;
+					std::vector<std::string> alreadyReached;
+					int mode;
+					int priority;
+					RouteChannel channel;
+					Serializer serializer;
+					serializer.deserialize(packet->stream, route, alreadyReached, mode, priority, channel.orderingChannel);
+					channel.mode = static_cast<DeliveryMode>(mode);
+					channel.priority = static_cast<PacketPriority>(priority);
+
+					auto origin = packet->connection->sessionId();
+					std::vector<std::string> targets;
+					{
+						std::lock_guard<std::mutex> lg(_hostMigrationMutex);
+						for (auto& peer : _directPeers)
 						{
-							that->onAllPlayersReady();
+							if (peer.first != origin && std::find(alreadyReached.begin(), alreadyReached.end(), peer.first) == alreadyReached.end())
+							{
+								targets.push_back(peer.first);
+							}
 						}
-						});
+					}
+					if (targets.empty())
+					{
+						return;
+					}
+
+					auto size = packet->stream.availableSize();
+					auto content = std::make_shared<std::vector<byte>>(static_cast<std::size_t>(size));
+					if (size > 0)
+					{
+						packet->stream.read(content->data(), size);
+					}
+					scene->send(PeerFilter::matchPeers(targets), RELAYED_ROUTE, [origin, route, content](obytestream& stream)
+						{
+							Serializer serializer;
+							serializer.serialize(stream, origin, route);
+							stream.write(content->data(), content->size());
+						}, channel.priority, channel.reliability(), channel.orderingChannel);
 				}
 
 				pplx::cancellation_token linkTokenToDisconnection(pplx::cancellation_token tokenToLink)
@@ -435,12 +1624,56 @@ namespace Stormancer
 				pplx::task_completion_event<void> _waitServerTce;
 
 				std::weak_ptr<Scene> _scene;
-				std::vector<SessionPlayer> _users;
+				SessionRoster _roster;
 				std::shared_ptr<Stormancer::ILogger> _logger;
+				// Runs the application's handlers of replicated objects and compressed routes.
+				std::shared_ptr<IActionDispatcher> _dispatcher;
 				bool _receivedP2PToken = false;
+				bool _openTunnel = false;
 				pplx::cancellation_token_source _disconnectionCts;
 				P2PRole _myP2PRole = P2PRole::Client;
 
+				// Protects the host peer and the host migration timings, which are updated from network threads.
+				std::mutex _hostMigrationMutex;
+				std::shared_ptr<IP2PScenePeer> _hostPeer;
+				std::chrono::steady_clock::time_point _hostLostAt;
+				rxcpp::subscription _peerDisconnectedSubscription;
+
+				P2PTopology _topology = P2PTopology::Star;
+				// Peers we have a direct P2P connection with, by session Id. Protected by _hostMigrationMutex.
+				std::unordered_map<std::string, std::shared_ptr<IP2PScenePeer>> _directPeers;
+				rxcpp::subscription _peerConnectedSubscription;
+
+				details::InterestIndex _interests;
+				// Protects _localInterest, and keeps its publications ordered.
+				std::mutex _interestMutex;
+				InterestUpdate _localInterest;
+
+				details::PayloadCompressor _compressor;
+				// Dictionary used by each peer, as acknowledged by the peer. Protected by _hostMigrationMutex.
+				std::unordered_map<std::string, uint32_t> _peerDictionaries;
+
+				std::shared_ptr<details::P2PUserRequests> _userRequests;
+				details::ClockSynchronizer _clock;
+				std::atomic<bool> _clockSyncRunning{ false };
+
+				details::ReplicationServer _replicationServer;
+				details::ReplicationClient _replicationClient;
+
+				static constexpr std::chrono::milliseconds CLOCK_SYNC_BURST_INTERVAL{ 100 };
+				static constexpr std::chrono::milliseconds CLOCK_SYNC_INTERVAL{ 1000 };
+				static constexpr const char* CLOCK_ROUTE = "gamesession.clock";
+				static constexpr const char* CLOCK_REPLY_ROUTE = "gamesession.clock.reply";
+				static constexpr const char* REPLICATION_SNAPSHOT_ROUTE = "gamesession.replication.snapshot";
+				static constexpr const char* REPLICATION_ACK_ROUTE = "gamesession.replication.ack";
+				static constexpr const char* DICTIONARY_ROUTE = "gamesession.dictionary";
+				static constexpr const char* DICTIONARY_ACK_ROUTE = "gamesession.dictionary.ack";
+				static constexpr const char* INTEREST_ROUTE = "gamesession.interest";
+				static constexpr const char* RELAY_ROUTE = "gamesession.relay";
+				static constexpr const char* RELAYED_ROUTE = "gamesession.relayed";
+				static constexpr const char* CONNECTIVITY_ROUTE = "gamesession.connectivity";
+				static constexpr const char* PLAYER_UPDATE_BATCHES_ROUTE = "gamesession.playerUpdateBatches";
+
 			};
 
 
@@ -478,6 +1711,9 @@ namespace Stormancer
 				Subscription onTunnelOpened;
 				Subscription onShutdownRecieved;
 				Subscription onPlayerChanged;
+				Subscription onPlayersChanged;
+				Subscription onHostMigrated;
+				Subscription onRelayedMessage;
 
 
 
@@ -501,10 +1737,11 @@ namespace Stormancer
 			{
 				friend class ::Stormancer::GameSessions::GameSessionsPlugin;
 			public:
-				GameSession_Impl(std::weak_ptr<IClient> client, std::shared_ptr<ITokenHandler> tokens, std::shared_ptr<ILogger> logger)
+				GameSession_Impl(std::weak_ptr<IClient> client, std::shared_ptr<ITokenHandler> tokens, std::shared_ptr<ILogger> logger, std::shared_ptr<IActionDispatcher> dispatcher)
 					: _logger(logger)
 					, _tokens(tokens)
 					, _wClient(client)
+					, _dispatcher(dispatcher)
 					, _currentGameSession(nullptr)
 				{
 				}
@@ -520,8 +1757,7 @@ namespace Stormancer
 						return pplx::task_from_exception<GameSessionConnectionParameters>(std::runtime_error("Empty connection token"));
 					}
 
-					// Client should never be null here
-					auto dispatcher = _wClient.lock()->dependencyResolver().resolve<IActionDispatcher>();
+					auto dispatcher = _dispatcher;
 
 					std::weak_ptr<GameSession_Impl> wThat = this->shared_from_this();
 
@@ -543,7 +1779,7 @@ namespace Stormancer
 					auto cancellationToken = _currentGameSession->cancellationToken();
 					std::weak_ptr<GameSessionContainer> wContainer = _currentGameSession;
 
-					auto scene = connectToGameSessionImpl(token, openTunnel, cancellationToken, wContainer)
+					auto scene = connectToGameSessionImpl(token, openTunnel, _topology, cancellationToken, wContainer)
 						.then([wThat, openTunnel, cancellationToken, wContainer](std::shared_ptr<Scene> scene)
 							{
 								auto that = wThat.lock();
@@ -553,6 +1789,9 @@ namespace Stormancer
 									throw std::runtime_error("Game session deleted");
 								}
 
+								auto service = scene->dependencyResolver().resolve<GameSessionService>();
+								service->advertisePlayerUpdateBatches();
+								service->reportConnectivity(cancellationToken);
 								that->_logger->log(LogLevel::Trace, "GameSession", "Requesting P2P token", "");
 								return that->requestP2PToken(scene, cancellationToken)
 									.then([scene, openTunnel, cancellationToken, wThat](pplx::task<std::string> task)
@@ -701,6 +1940,23 @@ namespace Stormancer
 							});
 				}
 
+				pplx::task<Packetisp_ptr> postResultStreamImpl(ResultProducer producer, ResultUploadOptions options, pplx::cancellation_token ct)
+				{
+					return getCurrentGameSession(ct)
+						.then([producer, options, ct](std::shared_ptr<Scene> scene)
+							{
+								if (scene)
+								{
+									auto gameSessionService = scene->dependencyResolver().resolve<GameSessionService>();
+									return gameSessionService->streamGameResults(producer, options, ct);
+								}
+								else
+								{
+									throw std::runtime_error("Not connected to any game session");
+								}
+							});
+				}
+
 				pplx::task<std::string> getUserFromBearerToken(const std::string& token)
 				{
 					return getCurrentGameSession()
@@ -776,6 +2032,163 @@ namespace Stormancer
 
 				}
 
+				void setP2PTopology(P2PTopology topology)
+				{
+					_topology = topology;
+				}
+
+				void sendToSessionPeers(const std::string& route, const StreamWriter& streamWriter)
+				{
+					getCurrentService()->sendToSessionPeers(route, streamWriter, _routeChannels.get(route));
+				}
+
+				void declareRoute(const std::string& route, DeliveryMode mode, PacketPriority priority, const std::string& orderingChannel)
+				{
+					RouteChannel channel;
+					channel.mode = mode;
+					channel.priority = priority;
+					channel.orderingChannel = orderingChannel;
+					_routeChannels.declare(route, channel);
+				}
+
+				void send(const PeerFilter& filter, const std::string& route, const StreamWriter& streamWriter)
+				{
+					auto session = scene();
+					if (!session)
+					{
+						throw std::runtime_error("Not connected to any game session");
+					}
+					auto channel = _routeChannels.get(route);
+					session->send(filter, route, streamWriter, channel.priority, channel.reliability(), channel.orderingChannel);
+				}
+
+				void setInterestChannels(const std::vector<std::string>& channels)
+				{
+					getCurrentService()->setInterestChannels(channels);
+				}
+
+				void setInterestArea(float x, float y, float radius)
+				{
+					InterestArea area;
+					area.x = x;
+					area.y = y;
+					area.radius = radius;
+					getCurrentService()->setInterestArea(true, area);
+				}
+
+				void clearInterestArea()
+				{
+					getCurrentService()->setInterestArea(false, InterestArea());
+				}
+
+				std::vector<std::string> getPeersInChannel(const std::string& channel)
+				{
+					return getCurrentService()->interests().peersInChannel(channel);
+				}
+
+				bool setCompressionDictionary(const std::string& dictionary)
+				{
+					if (!details::PayloadCompressor::isSupported())
+					{
+						return false;
+					}
+					{
+						std::lock_guard<std::mutex> lg(_compressionMutex);
+						_compressionDictionary = dictionary;
+					}
+					auto session = scene();
+					if (session)
+					{
+						return session->dependencyResolver().resolve<GameSessionService>()->useDictionary(dictionary);
+					}
+					return true;
+				}
+
+				void startCompressionDictionaryTraining()
+				{
+					getCurrentService()->startDictionaryTraining();
+				}
+
+				bool trainCompressionDictionary(std::size_t dictionaryCapacity)
+				{
+					return getCurrentService()->trainDictionary(dictionaryCapacity);
+				}
+
+				void addCompressedRoute(const std::string& route, std::function<void(std::string, std::string)> handler)
+				{
+					std::lock_guard<std::mutex> lg(_compressionMutex);
+					_compressedRoutes[route] = handler;
+				}
+
+				void sendCompressed(const std::string& route, const std::string& payload, const std::vector<std::string>& sessionIds)
+				{
+					getCurrentService()->sendCompressed(sessionIds, route, payload, _routeChannels.get(route));
+				}
+
+				CompressionStats getCompressionStats()
+				{
+					return getCurrentService()->compressionStats();
+				}
+
+				std::chrono::microseconds sessionTime()
+				{
+					return getCurrentService()->sessionTime();
+				}
+
+				ClockSyncState getClockSyncState()
+				{
+					return getCurrentService()->clockSyncState();
+				}
+
+				bool areAllPlayersReady()
+				{
+					return getCurrentService()->areAllPlayersReady();
+				}
+
+				void setReplicatedObject(uint64_t id, const std::string& type, const StreamWriter& streamWriter)
+				{
+					getCurrentService()->replicationServer().set(id, type, streamWriter);
+				}
+
+				void removeReplicatedObject(uint64_t id)
+				{
+					getCurrentService()->replicationServer().remove(id);
+				}
+
+				void tickReplication()
+				{
+					getCurrentService()->tickReplication();
+				}
+
+				void subscribeReplicatedType(const std::string& type, std::function<void(uint64_t, ibytestream&)> onUpdated, std::function<void(uint64_t)> onRemoved)
+				{
+					std::lock_guard<std::mutex> lg(_replicationMutex);
+					_replicationHandlers[type] = std::make_pair(onUpdated, onRemoved);
+				}
+
+				ReplicationStats getReplicationStats()
+				{
+					auto service = getCurrentService();
+					return service->getMyP2PRole() == P2PRole::Host ? service->replicationServer().stats() : service->replicationClient().stats();
+				}
+
+				std::vector<std::string> getPeersInterestedIn(float x, float y)
+				{
+					return getCurrentService()->interests().peersInterestedIn(x, y);
+				}
+
+				void sendToChannel(const std::string& channel, const std::string& route, const StreamWriter& streamWriter)
+				{
+					auto service = getCurrentService();
+					service->sendToPeers(service->interests().peersInChannel(channel), route, streamWriter, _routeChannels.get(route));
+				}
+
+				void sendToArea(float x, float y, const std::string& route, const StreamWriter& streamWriter)
+				{
+					auto service = getCurrentService();
+					service->sendToPeers(service->interests().peersInterestedIn(x, y), route, streamWriter, _routeChannels.get(route));
+				}
+
 				bool isSessionHost() const
 				{
 					auto container = _currentGameSession;
@@ -795,10 +2208,10 @@ namespace Stormancer
 
 			private:
 				//methods
-				pplx::task<std::shared_ptr<Scene>> connectToGameSessionImpl(std::string token, bool useTunnel, pplx::cancellation_token ct, std::weak_ptr<GameSessionContainer> wContainer)
+				pplx::task<std::shared_ptr<Scene>> connectToGameSessionImpl(std::string token, bool useTunnel, P2PTopology topology, pplx::cancellation_token ct, std::weak_ptr<GameSessionContainer> wContainer)
 				{
 					std::weak_ptr<GameSession_Impl> wThat = this->shared_from_this();
-					return _wClient.lock()->connectToPrivateScene(token, [wContainer, useTunnel, wThat](std::shared_ptr<Scene> scene) {
+					return _wClient.lock()->connectToPrivateScene(token, [wContainer, useTunnel, topology, wThat](std::shared_ptr<Scene> scene) {
 
 						auto gameSessionContainer = wContainer.lock();
 						if (!gameSessionContainer)
@@ -808,6 +2221,12 @@ namespace Stormancer
 						
 
 						auto service = scene->dependencyResolver().resolve<GameSessionService>();
+						service->setTopology(topology);
+						if (auto that = wThat.lock())
+						{
+							that->configureCompression(scene, service);
+							that->configureReplication(service);
+						}
 
 						gameSessionContainer->onRoleReceived = service->onRoleReceived.subscribe([wThat, useTunnel, wContainer](P2PRole role)
 							{
@@ -820,7 +2239,7 @@ namespace Stormancer
 										GameSessionConnectionParameters gameSessionParameters;
 										gameSessionParameters.endpoint = gameSessionContainer->mapName;
 										gameSessionParameters.isHost = (role == P2PRole::Host);
-										that->onRoleReceived(gameSessionParameters);
+										that->raise([gameSessionParameters](GameSession_Impl& gameSession) { gameSession.onRoleReceived(gameSessionParameters); });
 										gameSessionContainer->sessionReadyTce.set(gameSessionParameters);
 									}
 								}
@@ -837,7 +2256,7 @@ namespace Stormancer
 										gameSessionParameters.isHost = false;
 										gameSessionParameters.endpoint = p2pTunnel->ip + ":" + std::to_string(p2pTunnel->port);
 
-										that->onTunnelOpened(gameSessionParameters);
+										that->raise([gameSessionParameters](GameSession_Impl& gameSession) { gameSession.onTunnelOpened(gameSessionParameters); });
 										gameSessionContainer->sessionReadyTce.set(gameSessionParameters);
 									}
 								});
@@ -847,21 +2266,49 @@ namespace Stormancer
 							{
 								if (auto that = wThat.lock())
 								{
-									that->onAllPlayersReady();
+									that->raise([](GameSession_Impl& gameSession) { gameSession.onAllPlayersReady(); });
+								}
+							});
+
+
+						gameSessionContainer->onHostMigrated = service->onHostMigrated.subscribe([wThat, wContainer](std::shared_ptr<IP2PScenePeer> host, HostMigrationInfo info)
+							{
+								auto gameSessionContainer = wContainer.lock();
+								auto that = wThat.lock();
+								if (gameSessionContainer && that)
+								{
+									gameSessionContainer->p2pHost = host;
+									that->raise([host, info](GameSession_Impl& gameSession)
+										{
+											gameSession.onSessionHostChanged(host);
+											gameSession.onHostMigrationCompleted(info);
+										});
 								}
 							});
 
+						gameSessionContainer->onRelayedMessage = service->onRelayedMessage.subscribe([wThat](std::string origin, std::string route, Packetisp_ptr packet)
+							{
+								if (auto that = wThat.lock())
+								{
+									that->raise([origin, route, packet](GameSession_Impl& gameSession) { gameSession.onRelayedMessage(origin, route, packet); });
+								}
+							});
 
 						auto tce = gameSessionContainer->_hostIsReadyTce;
-						gameSessionContainer->onPlayerChanged = service->onPlayerStateChanged.subscribe([wThat, tce](SessionPlayer player, std::string data)
+						gameSessionContainer->onPlayerChanged = service->onPlayerStateChanged.subscribe([wThat, tce](const SessionPlayer& player, const std::string& data)
 							{
 								if (auto that = wThat.lock())
 								{
-									that->onPlayerStateChanged(player, data);
-									if (player.isHost && player.status == PlayerStatus::Ready)
-									{
-										tce.set();
-									}
+									auto updated = std::make_shared<std::vector<SessionPlayerUpdate>>();
+									updated->push_back(SessionPlayerUpdate{ player, data });
+									that->raisePlayersStateChanged(std::move(updated), tce);
+								}
+							});
+						gameSessionContainer->onPlayersChanged = service->onPlayersStateChanged.subscribe([wThat, tce](std::shared_ptr<const std::vector<SessionPlayerUpdate>> updated)
+							{
+								if (auto that = wThat.lock())
+								{
+									that->raisePlayersStateChanged(std::move(updated), tce);
 								}
 							});
 
@@ -879,6 +2326,77 @@ namespace Stormancer
 						return pplx::task_from_result<std::shared_ptr<Scene>>(nullptr);
 					}
 				}
+				void configureReplication(std::shared_ptr<GameSessionService> service)
+				{
+					std::lock_guard<std::mutex> lg(_replicationMutex);
+					for (auto& handlers : _replicationHandlers)
+					{
+						service->replicationClient().subscribe(handlers.first, handlers.second.first, handlers.second.second);
+					}
+				}
+
+				void configureCompression(std::shared_ptr<Scene> scene, std::shared_ptr<GameSessionService> service)
+				{
+					std::lock_guard<std::mutex> lg(_compressionMutex);
+					if (!_compressionDictionary.empty())
+					{
+						service->useDictionary(_compressionDictionary);
+					}
+
+					std::weak_ptr<GameSessionService> wService = service;
+					auto logger = _logger;
+					auto dispatcher = _dispatcher;
+					for (auto& compressedRoute : _compressedRoutes)
+					{
+						auto handler = compressedRoute.second;
+						scene->addRoute(compressedRoute.first, [wService, handler, logger, dispatcher](Packetisp_ptr packet)
+							{
+								details::CompressedPayload compressed;
+								try
+								{
+									compressed = packet->readObject<details::CompressedPayload>();
+								}
+								catch (const std::exception& ex)
+								{
+									logger->log(LogLevel::Warn, "gamesession.compression", "Dropping a malformed compressed payload", ex.what());
+									return;
+								}
+								auto sessionId = packet->connection->sessionId();
+								// Decompressed on the action dispatcher too, after the dictionaries received before this payload were adopted.
+								dispatcher->post([wService, handler, logger, compressed, sessionId]()
+									{
+										auto service = wService.lock();
+										if (!service)
+										{
+											return;
+										}
+
+										std::string payload;
+										try
+										{
+											payload = service->decompress(compressed);
+										}
+										catch (const std::exception& ex)
+										{
+											logger->log(LogLevel::Warn, "gamesession.compression", "Dropping a payload that could not be decompressed", ex.what());
+											return;
+										}
+										handler(sessionId, payload);
+									});
+							}, MessageOriginFilter::Peer);
+					}
+				}
+
+				std::shared_ptr<GameSessionService> getCurrentService()
+				{
+					auto session = scene();
+					if (!session)
+					{
+						throw std::runtime_error("Not connected to any game session");
+					}
+					return session->dependencyResolver().resolve<GameSessionService>();
+				}
+
 				pplx::task<std::string> requestP2PToken(std::shared_ptr<Scene> scene, pplx::cancellation_token ct)
 				{
 					std::weak_ptr<GameSession> wThat = this->shared_from_this();
@@ -887,6 +2405,38 @@ namespace Stormancer
 					return gameSessionService->requestP2PToken(ct);
 				}
 
+				// Events are raised on the action dispatcher, so that handlers run on the thread the application dispatches its actions to.
+				void raise(std::function<void(GameSession_Impl&)> raiseEvent)
+				{
+					std::weak_ptr<GameSession_Impl> wThat = this->shared_from_this();
+					_dispatcher->post([wThat, raiseEvent]
+						{
+							if (auto that = wThat.lock())
+							{
+								raiseEvent(*that);
+							}
+						});
+				}
+
+				void raisePlayersStateChanged(std::shared_ptr<const std::vector<SessionPlayerUpdate>> updated, pplx::task_completion_event<void> hostIsReadyTce)
+				{
+					for (auto& update : *updated)
+					{
+						if (update.player.isHost && update.player.status == PlayerStatus::Ready)
+						{
+							hostIsReadyTce.set();
+						}
+					}
+					raise([updated](GameSession_Impl& gameSession)
+						{
+							gameSession.onPlayersStateChanged(*updated);
+							for (auto& update : *updated)
+							{
+								gameSession.onPlayerStateChanged(update.player, update.data);
+							}
+						});
+				}
+
 				void onDisconnectingFromGameSession(std::shared_ptr<Scene> scene)
 				{
 					_currentGameSession = nullptr;
@@ -900,8 +2450,17 @@ namespace Stormancer
 				std::shared_ptr<ITokenHandler> _tokens;
 
 				std::weak_ptr<IClient> _wClient;
+				// Set at construction and never changed: raise() reads it from any thread without locking.
+				const std::shared_ptr<IActionDispatcher> _dispatcher;
 				std::shared_ptr<GameSessionContainer> _currentGameSession;
 				std::mutex _lock;
+				std::atomic<P2PTopology> _topology{ P2PTopology::Star };
+				details::RouteChannels _routeChannels;
+				std::mutex _compressionMutex;
+				std::string _compressionDictionary;
+				std::unordered_map<std::string, std::function<void(std::string, std::string)>> _compressedRoutes;
+				std::mutex _replicationMutex;
+				std::unordered_map<std::string, std::pair<std::function<void(uint64_t, ibytestream&)>, std::function<void(uint64_t)>>> _replicationHandlers;
 			};
 
 
@@ -950,7 +2509,7 @@ namespace Stormancer
 
 			void registerClientDependencies(ContainerBuilder& builder) override
 			{
-				builder.registerDependency < details::GameSession_Impl, IClient, ITokenHandler, ILogger >().as<GameSession>().singleInstance();
+				builder.registerDependency < details::GameSession_Impl, IClient, ITokenHandler, ILogger, IActionDispatcher >().as<GameSession>().singleInstance();
 			}
 		};
 
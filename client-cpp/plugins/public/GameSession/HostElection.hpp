@@ -0,0 +1,210 @@
+#pragma once
+#include "Core/LatencyProbes.hpp"
+#include "stormancer/RPC/Service.h"
+#include "stormancer/Tasks.h"
+#include "stormancer/msgpack_define.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		enum class NatType : uint8_t
+		{
+			Unknown = 0,
+			// No NAT, or a NAT accepting incoming connections from any endpoint (full cone).
+			Open = 1,
+			// Restricted or port-restricted cone NAT.
+			Moderate = 2,
+			// Symmetric NAT: direct connections to other strict peers usually fail.
+			Strict = 3
+		};
+
+		/// <summary>
+		/// Provides the NAT type of the local network, for instance from a platform networking API.
+		/// </summary>
+		/// <remarks>
+		/// Register an implementation in the client's dependency scope to take the NAT type into account when the host of a game session is elected.
+		/// Without one, the NAT type is reported as <c>NatType::Unknown</c>.
+		/// </remarks>
+		class INatTypeProvider
+		{
+		public:
+			virtual ~INatTypeProvider() = default;
+
+			virtual NatType natType() = 0;
+		};
+
+		/// <summary>
+		/// Connectivity of a player, sent to the server when joining a game session, so that it elects the best connected player as P2P host.
+		/// </summary>
+		struct ConnectivityReport
+		{
+			/// <summary>
+			/// Measured upload throughput to the server, in kbit/s. 0 if it could not be measured.
+			/// </summary>
+			uint32_t uploadKbps = 0;
+			NatType natType = NatType::Unknown;
+			/// <summary>
+			/// Round-trip times to the server (<c>"server"</c>) and to the registered <c>ILatencyProbeTarget</c>s.
+			/// </summary>
+			/// <remarks>
+			/// The round-trip times between players are estimated by the server from the endpoints they share, as players are not connected to each other yet.
+			/// </remarks>
+			LatencyVector latencies;
+
+			MSGPACK_DEFINE(uploadKbps, natType, latencies);
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// Measures the <c>ConnectivityReport</c> of the local player, in a few round trips to the game session server.
+			/// </summary>
+			class ConnectivityProbe : public std::enable_shared_from_this<ConnectivityProbe>
+			{
+			public:
+				static constexpr const char* PROBE_ROUTE = "GameSession.Probe";
+				static constexpr int RTT_SAMPLES = 3;
+				static constexpr std::size_t UPLOAD_PAYLOAD_SIZE = 64 * 1024;
+				static constexpr std::chrono::seconds TARGET_TIMEOUT{ 1 };
+
+				ConnectivityProbe(std::shared_ptr<RpcService> rpc, std::vector<std::shared_ptr<ILatencyProbeTarget>> targets, std::shared_ptr<INatTypeProvider> natTypeProvider)
+					: _rpc(rpc)
+					, _targets(targets)
+					, _natTypeProvider(natTypeProvider)
+				{
+				}
+
+				// The RTT to the server is measured first: the upload measure subtracts it from the transfer time of its payload.
+				pplx::task<ConnectivityReport> measure(pplx::cancellation_token ct)
+				{
+					if (_natTypeProvider)
+					{
+						_report.natType = _natTypeProvider->natType();
+					}
+					auto that = this->shared_from_this();
+					auto targets = probeTargets(ct);
+					return probeServer(ct).then([that, ct]()
+					{
+						return that->probeUpload(ct);
+					}).then([that, targets]()
+					{
+						return targets;
+					}).then([that]()
+					{
+						return that->_report;
+					});
+				}
+
+			private:
+				// Each probe echoes the challenge returned by the previous one, so that the server times the probes too, to bound the report.
+				pplx::task<std::chrono::microseconds> probe(std::size_t payloadSize, pplx::cancellation_token ct)
+				{
+					auto that = this->shared_from_this();
+					auto sentAt = std::chrono::steady_clock::now();
+					return _rpc->rpc<uint64_t>(PROBE_ROUTE, ct, _challenge, std::vector<char>(payloadSize)).then([that, sentAt](uint64_t challenge)
+					{
+						auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt);
+						that->_challenge = challenge;
+						return elapsed;
+					});
+				}
+
+				pplx::task<void> probeServer(pplx::cancellation_token ct)
+				{
+					auto that = this->shared_from_this();
+					return probe(0, ct).then([that, ct](std::chrono::microseconds roundTripTime)
+					{
+						that->_rttSamples.push_back(roundTripTime);
+						if (that->_rttSamples.size() < RTT_SAMPLES)
+						{
+							return that->probeServer(ct);
+						}
+						auto median = that->_rttSamples.begin() + that->_rttSamples.size() / 2;
+						std::nth_element(that->_rttSamples.begin(), median, that->_rttSamples.end());
+						that->_serverRtt = *median;
+						std::lock_guard<std::mutex> lg(that->_reportMutex);
+						that->_report.latencies["server"] = ::Stormancer::details::LatencyEstimator::toMilliseconds(*median);
+						return pplx::task_from_result();
+					});
+				}
+
+				pplx::task<void> probeUpload(pplx::cancellation_token ct)
+				{
+					auto that = this->shared_from_this();
+					return probe(UPLOAD_PAYLOAD_SIZE, ct).then([that](std::chrono::microseconds elapsed)
+					{
+						auto transferTime = std::max<int64_t>((elapsed - that->_serverRtt).count(), 1000);
+						auto kbps = static_cast<int64_t>(UPLOAD_PAYLOAD_SIZE) * 8 * 1000 / transferTime;
+						that->_report.uploadKbps = static_cast<uint32_t>(std::min<int64_t>(kbps, UINT32_MAX));
+					});
+				}
+
+				// Never fails: the targets that could not be probed are left out of the report.
+				pplx::task<void> probeTargets(pplx::cancellation_token ct)
+				{
+					auto timeoutCts = pplx::cancellation_token_source::create_linked_source(ct);
+					auto that = this->shared_from_this();
+					std::vector<pplx::task<void>> probes;
+					for (const auto& target : _targets)
+					{
+						auto id = target->id();
+						pplx::task<std::chrono::microseconds> probe;
+						try
+						{
+							probe = target->probe(timeoutCts.get_token());
+						}
+						catch (...)
+						{
+							probe = pplx::task_from_exception<std::chrono::microseconds>(std::current_exception());
+						}
+						probes.push_back(probe.then([that, id](pplx::task<std::chrono::microseconds> task)
+						{
+							try
+							{
+								auto roundTripTime = ::Stormancer::details::LatencyEstimator::toMilliseconds(task.get());
+								std::lock_guard<std::mutex> lg(that->_reportMutex);
+								that->_report.latencies[id] = roundTripTime;
+							}
+							catch (...)
+							{
+							}
+						}));
+					}
+					taskDelay(TARGET_TIMEOUT, ct).then([timeoutCts](pplx::task<void> task)
+					{
+						try
+						{
+							task.get();
+						}
+						catch (...)
+						{
+						}
+						timeoutCts.cancel();
+					});
+					return pplx::when_all(probes.begin(), probes.end());
+				}
+
+				std::shared_ptr<RpcService> _rpc;
+				std::vector<std::shared_ptr<ILatencyProbeTarget>> _targets;
+				std::shared_ptr<INatTypeProvider> _natTypeProvider;
+
+				ConnectivityReport _report;
+				// Target probes complete concurrently with the server probes.
+				std::mutex _reportMutex;
+				std::vector<std::chrono::microseconds> _rttSamples;
+				std::chrono::microseconds _serverRtt{ 0 };
+				// The server probes are sequential.
+				uint64_t _challenge = 0;
+			};
+		}
+	}
+}
+
+MSGPACK_ADD_ENUM(Stormancer::GameSessions::NatType)
@@ -0,0 +1,227 @@
+#pragma once
+#include "stormancer/msgpack_define.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		/// <summary>
+		/// Circular area of the game world a player is interested in.
+		/// </summary>
+		struct InterestArea
+		{
+			float x = 0;
+			float y = 0;
+			float radius = 0;
+
+			MSGPACK_DEFINE(x, y, radius);
+		};
+
+		/// <summary>
+		/// Interests a player publishes to the other players of the game session.
+		/// </summary>
+		struct InterestUpdate
+		{
+			std::vector<std::string> channels;
+			bool hasArea = false;
+			InterestArea area;
+
+			MSGPACK_DEFINE(channels, hasArea, area);
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// Index of the interests of the remote peers of a game session, by channel and by position.
+			/// </summary>
+			/// <remarks>
+			/// Areas are stored in a uniform grid: a position query only looks at the peers whose area overlaps the queried cell,
+			/// so its cost depends on the local density of players rather than on the size of the session.
+			/// Areas come from remote peers: an area spans at most <c>MAX_CELLS_PER_AXIS</c> cells per axis, larger radiuses are clamped.
+			/// </remarks>
+			class InterestIndex
+			{
+			public:
+				static constexpr int32_t MAX_CELLS_PER_AXIS = 64;
+
+				InterestIndex(float cellSize = 64.f)
+					: _cellSize(cellSize)
+					// Beyond this, cell coordinates would not fit in an int32_t.
+					, _maxCoordinate(cellSize * static_cast<float>(1 << 30))
+				{
+				}
+
+				/// <returns>false if the area was rejected because it is not a valid position: the channels are kept, without area.</returns>
+				bool update(const std::string& sessionId, const InterestUpdate& interest)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					removeImpl(sessionId);
+
+					auto& peer = _peers[sessionId];
+					peer = interest;
+					bool valid = true;
+					if (peer.hasArea)
+					{
+						auto& area = peer.area;
+						valid = isValidPosition(area.x, area.y) && std::isfinite(area.radius) && area.radius >= 0;
+						if (valid)
+						{
+							area.radius = std::min(area.radius, _cellSize * (MAX_CELLS_PER_AXIS - 1) / 2);
+						}
+						peer.hasArea = valid;
+					}
+					for (auto& channel : interest.channels)
+					{
+						_channels[channel].insert(sessionId);
+					}
+					if (peer.hasArea)
+					{
+						forEachCell(peer.area, [this, &sessionId](uint64_t cell)
+							{
+								_cells[cell].insert(sessionId);
+							});
+					}
+					return valid;
+				}
+
+				void remove(const std::string& sessionId)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					removeImpl(sessionId);
+				}
+
+				void clear()
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_peers.clear();
+					_channels.clear();
+					_cells.clear();
+				}
+
+				std::vector<std::string> peersInChannel(const std::string& channel) const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					auto it = _channels.find(channel);
+					if (it == _channels.end())
+					{
+						return {};
+					}
+					return std::vector<std::string>(it->second.begin(), it->second.end());
+				}
+
+				std::vector<std::string> peersInterestedIn(float x, float y) const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					std::vector<std::string> result;
+					if (!isValidPosition(x, y))
+					{
+						return result;
+					}
+					auto it = _cells.find(cellKey(cellCoordinate(x), cellCoordinate(y)));
+					if (it == _cells.end())
+					{
+						return result;
+					}
+					for (auto& sessionId : it->second)
+					{
+						auto& area = _peers.at(sessionId).area;
+						auto dx = area.x - x;
+						auto dy = area.y - y;
+						if (dx * dx + dy * dy <= area.radius * area.radius)
+						{
+							result.push_back(sessionId);
+						}
+					}
+					return result;
+				}
+
+			private:
+
+				// The margin keeps the cells of a clamped area within range as well.
+				bool isValidPosition(float x, float y) const
+				{
+					auto limit = _maxCoordinate - _cellSize * MAX_CELLS_PER_AXIS;
+					return std::isfinite(x) && std::isfinite(y) && std::abs(x) < limit && std::abs(y) < limit;
+				}
+
+				void removeImpl(const std::string& sessionId)
+				{
+					auto it = _peers.find(sessionId);
+					if (it == _peers.end())
+					{
+						return;
+					}
+					for (auto& channel : it->second.channels)
+					{
+						auto channelIt = _channels.find(channel);
+						if (channelIt != _channels.end())
+						{
+							channelIt->second.erase(sessionId);
+							if (channelIt->second.empty())
+							{
+								_channels.erase(channelIt);
+							}
+						}
+					}
+					if (it->second.hasArea)
+					{
+						forEachCell(it->second.area, [this, &sessionId](uint64_t cell)
+							{
+								auto cellIt = _cells.find(cell);
+								if (cellIt != _cells.end())
+								{
+									cellIt->second.erase(sessionId);
+									if (cellIt->second.empty())
+									{
+										_cells.erase(cellIt);
+									}
+								}
+							});
+					}
+					_peers.erase(it);
+				}
+
+				int32_t cellCoordinate(float value) const
+				{
+					return static_cast<int32_t>(std::floor(value / _cellSize));
+				}
+
+				static uint64_t cellKey(int32_t x, int32_t y)
+				{
+					return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+				}
+
+				template<typename TFunc>
+				void forEachCell(const InterestArea& area, TFunc func) const
+				{
+					auto minX = cellCoordinate(area.x - area.radius);
+					auto maxX = cellCoordinate(area.x + area.radius);
+					auto minY = cellCoordinate(area.y - area.radius);
+					auto maxY = cellCoordinate(area.y + area.radius);
+					for (auto x = minX; x <= maxX; x++)
+					{
+						for (auto y = minY; y <= maxY; y++)
+						{
+							func(cellKey(x, y));
+						}
+					}
+				}
+
+				float _cellSize;
+				float _maxCoordinate;
+				mutable std::mutex _mutex;
+				std::unordered_map<std::string, InterestUpdate> _peers;
+				std::unordered_map<std::string, std::unordered_set<std::string>> _channels;
+				std::unordered_map<uint64_t, std::unordered_set<std::string>> _cells;
+			};
+		}
+	}
+}
@@ -0,0 +1,398 @@
+#pragma once
+#include "Users/Users.hpp"
+#include "stormancer/Scene.h"
+#include "stormancer/Streams/bytestream.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		namespace details
+		{
+			/// <summary>
+			/// Delivers user requests (<c>UsersApi::sendRequestToUser()</c>) through the P2P connections of a game session.
+			/// </summary>
+			/// <remarks>
+			/// Players announce their user id on every new P2P connection (see <c>IDENTITY_ROUTE</c>).
+			/// The announce is only trusted once it matches the session id the server gave for this user in the roster (see <c>setPlayerSession()</c>):
+			/// the user id of a request is the one the server attributes to the connection it arrived on, not one claimed by the request or by the peer.
+			/// </remarks>
+			class P2PUserRequests : public Users::IUserRequestTransport, public std::enable_shared_from_this<P2PUserRequests>
+			{
+			public:
+				P2PUserRequests(std::weak_ptr<Scene> scene, std::weak_ptr<Users::UsersApi> users)
+					: _scene(scene)
+					, _users(users)
+				{
+				}
+
+				void sendIdentity(const std::string& sessionId)
+				{
+					auto scene = _scene.lock();
+					auto users = _users.lock();
+					if (scene && users)
+					{
+						auto userId = users->userId();
+						scene->send(PeerFilter::matchPeers(sessionId), IDENTITY_ROUTE, [userId](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, userId);
+							}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED, REQUEST_ROUTE);
+					}
+				}
+
+				/// <summary>
+				/// Record the session id of a player, as sent by the server in the roster of the game session.
+				/// </summary>
+				/// <returns>false if the identity this session announced does not match.</returns>
+				bool setPlayerSession(const std::string& userId, const std::string& sessionId)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					// The player reconnected with a new session: the previous one is not this user anymore.
+					auto previous = _sessionIds.find(userId);
+					if (previous != _sessionIds.end() && previous->second != sessionId)
+					{
+						_userIds.erase(previous->second);
+						_sessionIds.erase(previous);
+					}
+					_rosterUserIds[sessionId] = userId;
+					return verifyImpl(sessionId);
+				}
+
+				/// <returns>false if the announced user id does not match the roster of the server.</returns>
+				bool onIdentity(Packetisp_ptr packet)
+				{
+					auto userId = packet->readObject<std::string>();
+					auto sessionId = packet->connection->sessionId();
+					std::lock_guard<std::mutex> lg(_mutex);
+					_announcedUserIds[sessionId] = userId;
+					return verifyImpl(sessionId);
+				}
+
+				/// <summary>
+				/// Forget a disconnected peer. Its pending requests fail, so that they are not left waiting for an answer that will never come.
+				/// </summary>
+				void removePeer(const std::string& sessionId)
+				{
+					std::vector<pplx::task_completion_event<Packetisp_ptr>> failed;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						auto it = _userIds.find(sessionId);
+						if (it != _userIds.end())
+						{
+							_sessionIds.erase(it->second);
+							_userIds.erase(it);
+						}
+						// The roster entry is kept: the peer announces itself again if it reconnects.
+						_announcedUserIds.erase(sessionId);
+						for (auto request = _pendingRequests.begin(); request != _pendingRequests.end();)
+						{
+							if (request->second.sessionId == sessionId)
+							{
+								failed.push_back(request->second.tce);
+								request = _pendingRequests.erase(request);
+							}
+							else
+							{
+								++request;
+							}
+						}
+					}
+					for (auto& tce : failed)
+					{
+						tce.set_exception(std::runtime_error("userDisconnected"));
+					}
+				}
+
+				void clear()
+				{
+					std::unordered_map<uint64_t, PendingRequest> pendingRequests;
+					std::unordered_map<std::string, pplx::cancellation_token_source> receivedRequests;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						_sessionIds.clear();
+						_userIds.clear();
+						_rosterUserIds.clear();
+						_announcedUserIds.clear();
+						pendingRequests.swap(_pendingRequests);
+						receivedRequests.swap(_receivedRequests);
+					}
+					for (auto& request : pendingRequests)
+					{
+						request.second.tce.set_exception(std::runtime_error("userDisconnected"));
+					}
+					for (auto& request : receivedRequests)
+					{
+						request.second.cancel();
+					}
+				}
+
+				bool canReach(const std::string& userId) override
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _sessionIds.find(userId) != _sessionIds.end();
+				}
+
+				pplx::task<Packetisp_ptr> sendRequest(const std::string& userId, const std::string& operation, const StreamWriter& streamWriter, pplx::cancellation_token ct) override
+				{
+					auto scene = _scene.lock();
+					if (!scene)
+					{
+						return pplx::task_from_exception<Packetisp_ptr>(std::runtime_error("Scene deleted"));
+					}
+
+					pplx::task_completion_event<Packetisp_ptr> tce;
+					std::string sessionId;
+					uint64_t requestId;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						auto it = _sessionIds.find(userId);
+						if (it == _sessionIds.end())
+						{
+							return pplx::task_from_exception<Packetisp_ptr>(std::runtime_error("userDisconnected?id=" + userId));
+						}
+						sessionId = it->second;
+						requestId = ++_lastRequestId;
+						_pendingRequests[requestId] = PendingRequest{ sessionId, tce };
+					}
+
+					scene->send(PeerFilter::matchPeers(sessionId), REQUEST_ROUTE, [requestId, operation, streamWriter](obytestream& stream)
+						{
+							Serializer serializer;
+							serializer.serialize(stream, requestId, operation);
+							streamWriter(stream);
+						}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED, REQUEST_ROUTE);
+
+					if (ct.is_cancelable())
+					{
+						std::weak_ptr<P2PUserRequests> wThat = this->shared_from_this();
+						ct.register_callback([wThat, requestId, sessionId]
+							{
+								if (auto that = wThat.lock())
+								{
+									that->cancelRequest(requestId, sessionId);
+								}
+							});
+					}
+					return pplx::create_task(tce);
+				}
+
+				void onRequest(Packetisp_ptr packet)
+				{
+					auto users = _users.lock();
+					if (!users)
+					{
+						return;
+					}
+
+					auto sessionId = packet->connection->sessionId();
+					Users::OperationCtx ctx;
+					uint64_t requestId;
+					Serializer serializer;
+					serializer.deserialize(packet->stream, requestId, ctx.operation);
+
+					pplx::cancellation_token_source cts;
+					bool verified;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						auto it = _userIds.find(sessionId);
+						verified = it != _userIds.end();
+						if (verified)
+						{
+							ctx.originId = it->second;
+							_receivedRequests[requestKey(sessionId, requestId)] = cts;
+						}
+					}
+					if (!verified)
+					{
+						// The server has not confirmed who this peer is yet, or it announced another user: answer, so that it does not wait forever.
+						if (auto scene = _scene.lock())
+						{
+							scene->send(PeerFilter::matchPeers(sessionId), RESPONSE_ROUTE, [requestId](obytestream& stream)
+								{
+									Serializer serializer;
+									serializer.serialize(stream, requestId, false, std::string("unverifiedPeer"));
+								}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED, REQUEST_ROUTE);
+						}
+						return;
+					}
+					ctx.packet = packet;
+					ctx.token = cts.get_token();
+					ctx.response = std::make_shared<StreamWriter>();
+
+					auto response = ctx.response;
+					std::weak_ptr<P2PUserRequests> wThat = this->shared_from_this();
+					users->handleDirectRequest(ctx)
+						.then([wThat, sessionId, requestId, response](pplx::task<void> task)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									return;
+								}
+								{
+									std::lock_guard<std::mutex> lg(that->_mutex);
+									that->_receivedRequests.erase(requestKey(sessionId, requestId));
+								}
+
+								bool success = true;
+								std::string error;
+								try
+								{
+									task.get();
+								}
+								catch (const std::exception& ex)
+								{
+									success = false;
+									error = ex.what();
+								}
+
+								if (auto scene = that->_scene.lock())
+								{
+									scene->send(PeerFilter::matchPeers(sessionId), RESPONSE_ROUTE, [requestId, success, error, response](obytestream& stream)
+										{
+											Serializer serializer;
+											serializer.serialize(stream, requestId, success, error);
+											if (success && *response)
+											{
+												(*response)(stream);
+											}
+										}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED, REQUEST_ROUTE);
+								}
+							});
+				}
+
+				void onResponse(Packetisp_ptr packet)
+				{
+					uint64_t requestId;
+					bool success;
+					std::string error;
+					Serializer serializer;
+					serializer.deserialize(packet->stream, requestId, success, error);
+
+					pplx::task_completion_event<Packetisp_ptr> tce;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						auto it = _pendingRequests.find(requestId);
+						if (it == _pendingRequests.end() || it->second.sessionId != packet->connection->sessionId())
+						{
+							return;
+						}
+						tce = it->second.tce;
+						_pendingRequests.erase(it);
+					}
+					if (success)
+					{
+						tce.set(packet);
+					}
+					else
+					{
+						tce.set_exception(std::runtime_error(error));
+					}
+				}
+
+				void onCancel(Packetisp_ptr packet)
+				{
+					auto requestId = packet->readObject<uint64_t>();
+					pplx::cancellation_token_source cts;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						auto it = _receivedRequests.find(requestKey(packet->connection->sessionId(), requestId));
+						if (it == _receivedRequests.end())
+						{
+							return;
+						}
+						cts = it->second;
+					}
+					cts.cancel();
+				}
+
+				static constexpr const char* IDENTITY_ROUTE = "gamesession.users.identity";
+				static constexpr const char* REQUEST_ROUTE = "gamesession.users.request";
+				static constexpr const char* RESPONSE_ROUTE = "gamesession.users.response";
+				static constexpr const char* CANCEL_ROUTE = "gamesession.users.cancel";
+
+			private:
+				struct PendingRequest
+				{
+					std::string sessionId;
+					pplx::task_completion_event<Packetisp_ptr> tce;
+				};
+
+				// Trust the identity of a session once its announce and the roster agree. Returns false if they disagree.
+				bool verifyImpl(const std::string& sessionId)
+				{
+					auto announced = _announcedUserIds.find(sessionId);
+					auto roster = _rosterUserIds.find(sessionId);
+					if (announced == _announcedUserIds.end() || roster == _rosterUserIds.end())
+					{
+						return true;
+					}
+					if (announced->second != roster->second)
+					{
+						_announcedUserIds.erase(announced);
+						return false;
+					}
+					auto& userId = roster->second;
+					auto existing = _sessionIds.find(userId);
+					if (existing != _sessionIds.end() && existing->second != sessionId)
+					{
+						// Never take over the mapping of another session.
+						return false;
+					}
+					_sessionIds[userId] = sessionId;
+					_userIds[sessionId] = userId;
+					return true;
+				}
+
+				static std::string requestKey(const std::string& sessionId, uint64_t requestId)
+				{
+					return sessionId + "|" + std::to_string(requestId);
+				}
+
+				void cancelRequest(uint64_t requestId, const std::string& sessionId)
+				{
+					pplx::task_completion_event<Packetisp_ptr> tce;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						auto it = _pendingRequests.find(requestId);
+						if (it == _pendingRequests.end())
+						{
+							return;
+						}
+						tce = it->second.tce;
+						_pendingRequests.erase(it);
+					}
+					if (auto scene = _scene.lock())
+					{
+						scene->send(PeerFilter::matchPeers(sessionId), CANCEL_ROUTE, [requestId](obytestream& stream)
+							{
+								Serializer serializer;
+								serializer.serialize(stream, requestId);
+							}, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED, REQUEST_ROUTE);
+					}
+					tce.set_exception(pplx::task_canceled());
+				}
+
+				std::weak_ptr<Scene> _scene;
+				std::weak_ptr<Users::UsersApi> _users;
+				std::mutex _mutex;
+				uint64_t _lastRequestId = 0;
+				// User id <-> session id of the connected peers whose identity is verified.
+				std::unordered_map<std::string, std::string> _sessionIds;
+				std::unordered_map<std::string, std::string> _userIds;
+				// User id by session id, as sent by the server, and as announced by the peers.
+				std::unordered_map<std::string, std::string> _rosterUserIds;
+				std::unordered_map<std::string, std::string> _announcedUserIds;
+				std::unordered_map<uint64_t, PendingRequest> _pendingRequests;
+				std::unordered_map<std::string, pplx::cancellation_token_source> _receivedRequests;
+			};
+		}
+	}
+}
@@ -0,0 +1,330 @@
+#pragma once
+#include "stormancer/msgpack_define.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Dictionary compression requires zstd: define STORMANCER_GAMESESSION_ZSTD and link against libzstd to enable it.
+// Without it, compressed routes still work, but their payloads are sent as is.
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		/// <summary>
+		/// Counters of the payload compression of a game session.
+		/// </summary>
+		struct CompressionStats
+		{
+			/// <summary>
+			/// Number of payloads compressed with the session dictionary.
+			/// </summary>
+			uint64_t compressedMessages = 0;
+			/// <summary>
+			/// Total size of these payloads before compression.
+			/// </summary>
+			uint64_t originalBytes = 0;
+			/// <summary>
+			/// Total size of these payloads after compression.
+			/// </summary>
+			uint64_t compressedBytes = 0;
+			/// <summary>
+			/// CPU time spent compressing them.
+			/// </summary>
+			std::chrono::nanoseconds compressionTime{ 0 };
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// Wire format of the messages of compressed routes.
+			/// </summary>
+			/// <remarks>
+			/// <c>dictionaryId</c> is 0 when <c>data</c> is not compressed.
+			/// </remarks>
+			struct CompressedPayload
+			{
+				uint32_t dictionaryId = 0;
+				uint32_t originalSize = 0;
+				std::string data;
+
+				MSGPACK_DEFINE(dictionaryId, originalSize, data);
+			};
+
+			/// <summary>
+			/// zstd compression of small payloads with a dictionary shared by the players of a game session.
+			/// </summary>
+			/// <remarks>
+			/// The dictionary can be loaded (see <c>setDictionary()</c>) or trained on the payloads sent and received since <c>startTraining()</c> (see <c>train()</c>).
+			/// Payloads are only kept as samples during a training, within <c>MAX_SAMPLES</c> samples of at most <c>MAX_SAMPLE_SIZE</c> bytes, and <c>MAX_SAMPLES_BYTES</c> in total.
+			/// Compression contexts are not thread-safe: every operation is serialized by a mutex.
+			/// </remarks>
+			class PayloadCompressor
+			{
+			public:
+				/// <summary>
+				/// Larger payloads are sent uncompressed, and compressed payloads announcing a larger size are rejected before anything is allocated.
+				/// </summary>
+				static constexpr uint32_t MAX_PAYLOAD_SIZE = 64 * 1024;
+				/// <summary>
+				/// Larger dictionaries are rejected.
+				/// </summary>
+				static constexpr std::size_t MAX_DICTIONARY_SIZE = 128 * 1024;
+				static constexpr std::size_t MAX_SAMPLES = 2000;
+				static constexpr std::size_t MAX_SAMPLE_SIZE = 4 * 1024;
+				static constexpr std::size_t MAX_SAMPLES_BYTES = 1024 * 1024;
+
+				PayloadCompressor() = default;
+				PayloadCompressor(const PayloadCompressor&) = delete;
+				PayloadCompressor& operator=(const PayloadCompressor&) = delete;
+
+				~PayloadCompressor()
+				{
+					release();
+				}
+
+				static constexpr bool isSupported()
+				{
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+					return true;
+#else
+					return false;
+#endif
+				}
+
+				/// <summary>
+				/// Use a new dictionary. Returns its id, or 0 if it is not a valid dictionary.
+				/// </summary>
+				uint32_t setDictionary(const std::string& dictionary)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+					if (dictionary.size() > MAX_DICTIONARY_SIZE)
+					{
+						return 0;
+					}
+					auto id = static_cast<uint32_t>(ZDICT_getDictID(dictionary.data(), dictionary.size()));
+					if (id == 0)
+					{
+						return 0;
+					}
+					if (id == _dictionaryId)
+					{
+						return id;
+					}
+
+					release();
+					_cctx = ZSTD_createCCtx();
+					_dctx = ZSTD_createDCtx();
+					_cdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), COMPRESSION_LEVEL);
+					_ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+					if (!_cctx || !_dctx || !_cdict || !_ddict)
+					{
+						release();
+						return 0;
+					}
+					// Frame fields that both sides already know would cost more than the compression gains on small payloads.
+					ZSTD_CCtx_setParameter(_cctx, ZSTD_c_contentSizeFlag, 0);
+					ZSTD_CCtx_setParameter(_cctx, ZSTD_c_checksumFlag, 0);
+					ZSTD_CCtx_setParameter(_cctx, ZSTD_c_dictIDFlag, 0);
+					ZSTD_CCtx_refCDict(_cctx, _cdict);
+					ZSTD_DCtx_refDDict(_dctx, _ddict);
+					_dictionary = dictionary;
+					_dictionaryId = id;
+					return id;
+#else
+					(void)dictionary;
+					return 0;
+#endif
+				}
+
+				uint32_t dictionaryId() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _dictionaryId;
+				}
+
+				std::string dictionary() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _dictionary;
+				}
+
+				/// <summary>
+				/// Compress a payload with the current dictionary, or leave it as is if there is no dictionary or compressing does not make it smaller.
+				/// </summary>
+				CompressedPayload compress(const std::string& payload)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					addSampleImpl(payload);
+
+					CompressedPayload result;
+					result.originalSize = static_cast<uint32_t>(payload.size());
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+					if (_dictionaryId != 0 && payload.size() <= MAX_PAYLOAD_SIZE)
+					{
+						auto start = std::chrono::steady_clock::now();
+						std::string compressed(ZSTD_compressBound(payload.size()), '\0');
+						auto size = ZSTD_compress2(_cctx, &compressed[0], compressed.size(), payload.data(), payload.size());
+						_stats.compressionTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+						if (!ZSTD_isError(size) && size < payload.size())
+						{
+							compressed.resize(size);
+							result.dictionaryId = _dictionaryId;
+							result.data = std::move(compressed);
+							_stats.compressedMessages++;
+							_stats.originalBytes += payload.size();
+							_stats.compressedBytes += size;
+							return result;
+						}
+					}
+#endif
+					result.data = payload;
+					return result;
+				}
+
+				std::string decompress(const CompressedPayload& payload)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					if (payload.dictionaryId == 0)
+					{
+						addSampleImpl(payload.data);
+						return payload.data;
+					}
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+					if (payload.dictionaryId != _dictionaryId)
+					{
+						throw std::runtime_error("Payload compressed with unknown dictionary " + std::to_string(payload.dictionaryId));
+					}
+					if (payload.originalSize > MAX_PAYLOAD_SIZE)
+					{
+						throw std::runtime_error("Compressed payload too large: " + std::to_string(payload.originalSize) + " bytes");
+					}
+					std::string result(payload.originalSize, '\0');
+					auto size = ZSTD_decompressDCtx(_dctx, &result[0], result.size(), payload.data.data(), payload.data.size());
+					if (ZSTD_isError(size) || size != payload.originalSize)
+					{
+						throw std::runtime_error("Invalid compressed payload");
+					}
+					addSampleImpl(result);
+					return result;
+#else
+					throw std::runtime_error("Received a compressed payload, but zstd support is not enabled");
+#endif
+				}
+
+				/// <summary>
+				/// Start keeping the payloads sent and received as samples, to train a dictionary with <c>train()</c>. Drops the samples of a previous training.
+				/// </summary>
+				void startTraining()
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_training = isSupported();
+					_samples.clear();
+					_samplesBytes = 0;
+				}
+
+				/// <summary>
+				/// Train a dictionary on the samples kept since <c>startTraining()</c>, and use it. Returns its id, or 0 if there were not enough samples.
+				/// </summary>
+				/// <remarks>
+				/// Ends the training, and releases the samples.
+				/// </remarks>
+				uint32_t train(std::size_t dictionaryCapacity)
+				{
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+					std::string samples;
+					std::vector<size_t> sampleSizes;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						samples.reserve(_samplesBytes);
+						for (auto& sample : _samples)
+						{
+							samples += sample;
+							sampleSizes.push_back(sample.size());
+						}
+						_training = false;
+						_samples.clear();
+						_samplesBytes = 0;
+					}
+					dictionaryCapacity = std::min(dictionaryCapacity, MAX_DICTIONARY_SIZE);
+					std::string dictionary(dictionaryCapacity, '\0');
+					auto size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), samples.data(), sampleSizes.data(), static_cast<unsigned int>(sampleSizes.size()));
+					if (ZDICT_isError(size))
+					{
+						return 0;
+					}
+					dictionary.resize(size);
+					return setDictionary(dictionary);
+#else
+					(void)dictionaryCapacity;
+					return 0;
+#endif
+				}
+
+				CompressionStats stats() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _stats;
+				}
+
+			private:
+
+				void addSampleImpl(const std::string& payload)
+				{
+					if (!_training || payload.empty() || payload.size() > MAX_SAMPLE_SIZE)
+					{
+						return;
+					}
+					_samples.push_back(payload);
+					_samplesBytes += payload.size();
+					while (_samples.size() > MAX_SAMPLES || _samplesBytes > MAX_SAMPLES_BYTES)
+					{
+						_samplesBytes -= _samples.front().size();
+						_samples.pop_front();
+					}
+				}
+
+				void release()
+				{
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+					ZSTD_freeCDict(_cdict);
+					ZSTD_freeDDict(_ddict);
+					ZSTD_freeCCtx(_cctx);
+					ZSTD_freeDCtx(_dctx);
+					_cdict = nullptr;
+					_ddict = nullptr;
+					_cctx = nullptr;
+					_dctx = nullptr;
+#endif
+					_dictionary.clear();
+					_dictionaryId = 0;
+				}
+
+#if defined(STORMANCER_GAMESESSION_ZSTD)
+				static constexpr int COMPRESSION_LEVEL = 3;
+				ZSTD_CCtx* _cctx = nullptr;
+				ZSTD_DCtx* _dctx = nullptr;
+				ZSTD_CDict* _cdict = nullptr;
+				ZSTD_DDict* _ddict = nullptr;
+#endif
+				mutable std::mutex _mutex;
+				std::string _dictionary;
+				uint32_t _dictionaryId = 0;
+				bool _training = false;
+				std::deque<std::string> _samples;
+				std::size_t _samplesBytes = 0;
+				CompressionStats _stats;
+			};
+		}
+	}
+}
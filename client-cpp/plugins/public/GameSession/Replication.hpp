@@ -0,0 +1,491 @@
+#pragma once
+#include "stormancer/Streams/bytestream.h"
+#include "stormancer/Scene.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		/// <summary>
+		/// Counters of the state replication of a game session.
+		/// </summary>
+		struct ReplicationStats
+		{
+			/// <summary>
+			/// Snapshots sent by the host, or applied by a client.
+			/// </summary>
+			uint64_t snapshots = 0;
+			/// <summary>
+			/// Object updates and removals sent by the host, or applied by a client.
+			/// </summary>
+			uint64_t objects = 0;
+			/// <summary>
+			/// Acknowledgements received by the host, or sent by a client.
+			/// </summary>
+			uint64_t acks = 0;
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// Identifies a fragment of a snapshot, to acknowledge it.
+			/// </summary>
+			struct SnapshotFragment
+			{
+				/// <summary>
+				/// Sequence number of the snapshot, 0 if there is nothing to acknowledge.
+				/// </summary>
+				uint64_t sequence = 0;
+				uint16_t fragment = 0;
+			};
+
+			/// <summary>
+			/// Host side of the state replication: replicated objects, and the state of each of them acknowledged by each peer.
+			/// </summary>
+			/// <remarks>
+			/// Every object remembers the snapshot sequence number of its last change, and every peer the change of each object it acknowledged.
+			/// The snapshot sent to a peer only contains the objects changed or removed since the change this peer acknowledged,
+			/// so its size depends on what changed rather than on the size of the replicated state.
+			/// Peers acknowledge each fragment of a snapshot: a lost fragment only causes its own objects to be sent again,
+			/// so that large snapshots, such as the whole state sent to a new peer, are delivered under packet loss.
+			/// </remarks>
+			class ReplicationServer
+			{
+			public:
+				void set(uint64_t id, const std::string& type, StreamWriter writer)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					auto& object = _objects[id];
+					object.type = type;
+					object.writer = std::move(writer);
+					object.removed = false;
+					object.changedAt = _sequence + 1;
+				}
+
+				void remove(uint64_t id)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					auto it = _objects.find(id);
+					if (it != _objects.end() && !it->second.removed)
+					{
+						it->second.removed = true;
+						it->second.writer = nullptr;
+						it->second.changedAt = _sequence + 1;
+					}
+				}
+
+				void addPeer(const std::string& sessionId)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_peers.emplace(sessionId, PeerState());
+				}
+
+				void removePeer(const std::string& sessionId)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_peers.erase(sessionId);
+				}
+
+				void ack(const std::string& sessionId, SnapshotFragment fragment)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					auto peer = _peers.find(sessionId);
+					if (peer == _peers.end())
+					{
+						return;
+					}
+					// Acks are unreliable and can arrive out of order, or after the fragment was forgotten: its objects are then sent again.
+					auto it = peer->second.inFlight.find(std::make_pair(fragment.sequence, fragment.fragment));
+					if (it != peer->second.inFlight.end())
+					{
+						for (auto& object : it->second)
+						{
+							auto known = peer->second.known.find(object.first);
+							if (known != peer->second.known.end())
+							{
+								known->second = std::max(known->second, object.second);
+							}
+						}
+						peer->second.inFlight.erase(it);
+					}
+					_stats.acks++;
+				}
+
+				/// <summary>
+				/// Build the next snapshot of every peer. <c>send</c> is called once per fragment of the snapshot of each peer that has something to receive.
+				/// </summary>
+				/// <remarks>
+				/// Snapshots are split into fragments of at most <c>MAX_FRAGMENT_SIZE</c> bytes, so that a new or lagging peer does not receive the whole state in a single message.
+				/// An object larger than this is sent alone in its fragment.
+				/// Objects are serialized, and <c>send</c> called, outside of the lock.
+				/// </remarks>
+				void tick(const std::function<void(const std::string& sessionId, const StreamWriter& writer)>& send)
+				{
+					std::vector<PeerSnapshot> snapshots;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						auto sequence = ++_sequence;
+
+						for (auto& peer : _peers)
+						{
+							auto& state = peer.second;
+							// Fragments not acknowledged within MAX_IN_FLIGHT snapshots are considered lost: their objects are sent again anyway.
+							while (!state.inFlight.empty() && state.inFlight.begin()->first.first + MAX_IN_FLIGHT < sequence)
+							{
+								state.inFlight.erase(state.inFlight.begin());
+							}
+
+							PeerSnapshot snapshot{ peer.first, sequence, {} };
+							for (auto& object : _objects)
+							{
+								auto known = state.known.find(object.first);
+								// A peer that was never sent an object has no use for its removal.
+								if (known == state.known.end() ? !object.second.removed : object.second.changedAt > known->second)
+								{
+									snapshot.entries.emplace_back(object.first, object.second);
+									state.known.emplace(object.first, 0);
+								}
+							}
+							if (!snapshot.entries.empty())
+							{
+								_stats.snapshots++;
+								_stats.objects += snapshot.entries.size();
+								snapshots.push_back(std::move(snapshot));
+							}
+						}
+
+						// Removals acknowledged by every peer they were sent to do not need to be sent anymore.
+						for (auto it = _objects.begin(); it != _objects.end();)
+						{
+							if (it->second.removed && isAcknowledged(it->first, it->second.changedAt))
+							{
+								for (auto& peer : _peers)
+								{
+									peer.second.known.erase(it->first);
+								}
+								it = _objects.erase(it);
+							}
+							else
+							{
+								++it;
+							}
+						}
+					}
+
+					// Most peers receive the same objects: serialize each of them once.
+					std::unordered_map<uint64_t, std::shared_ptr<std::vector<byte>>> encoded;
+					for (auto& snapshot : snapshots)
+					{
+						std::vector<std::vector<std::shared_ptr<std::vector<byte>>>> fragments(1);
+						// Objects of each fragment, with the change they contain.
+						std::vector<std::vector<std::pair<uint64_t, uint64_t>>> fragmentObjects(1);
+						std::size_t fragmentSize = 0;
+						for (auto& entry : snapshot.entries)
+						{
+							auto& bytes = encoded[entry.first];
+							if (!bytes)
+							{
+								obytestream stream;
+								Serializer serializer;
+								serializer.serialize(stream, entry.first, entry.second.type, entry.second.removed);
+								if (!entry.second.removed)
+								{
+									// Length-prefixed, so that a client without a handler for this type can skip the value.
+									obytestream value;
+									entry.second.writer(value);
+									auto valueBytes = value.bytes();
+									serializer.serialize(stream, static_cast<uint32_t>(valueBytes.size()));
+									stream.write(valueBytes.data(), valueBytes.size());
+								}
+								bytes = std::make_shared<std::vector<byte>>(stream.bytes());
+							}
+							if (fragmentSize > 0 && fragmentSize + bytes->size() > MAX_FRAGMENT_SIZE && fragments.size() < UINT16_MAX)
+							{
+								fragments.emplace_back();
+								fragmentObjects.emplace_back();
+								fragmentSize = 0;
+							}
+							fragments.back().push_back(bytes);
+							fragmentObjects.back().emplace_back(entry.first, entry.second.changedAt);
+							fragmentSize += bytes->size();
+						}
+
+						auto sequence = snapshot.sequence;
+						{
+							std::lock_guard<std::mutex> lg(_mutex);
+							auto peer = _peers.find(snapshot.sessionId);
+							if (peer == _peers.end())
+							{
+								continue;
+							}
+							for (uint16_t fragment = 0; fragment < fragments.size(); fragment++)
+							{
+								peer->second.inFlight[std::make_pair(sequence, fragment)] = std::move(fragmentObjects[fragment]);
+							}
+						}
+						for (uint16_t fragment = 0; fragment < fragments.size(); fragment++)
+						{
+							auto entries = std::move(fragments[fragment]);
+							send(snapshot.sessionId, [sequence, fragment, entries](obytestream& stream)
+								{
+									Serializer serializer;
+									serializer.serialize(stream, sequence, fragment, static_cast<uint32_t>(entries.size()));
+									for (auto& entry : entries)
+									{
+										stream.write(entry->data(), entry->size());
+									}
+								});
+						}
+					}
+				}
+
+				/// <summary>
+				/// Restart the sequence numbers, so that every peer receives the whole state again, as the snapshots of a new host.
+				/// </summary>
+				/// <remarks>
+				/// The objects are kept: removed objects are forgotten, and the others are sent in the first snapshot.
+				/// </remarks>
+				void reset()
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_sequence = 0;
+					for (auto it = _objects.begin(); it != _objects.end();)
+					{
+						if (it->second.removed)
+						{
+							it = _objects.erase(it);
+						}
+						else
+						{
+							it->second.changedAt = 1;
+							++it;
+						}
+					}
+					for (auto& peer : _peers)
+					{
+						peer.second = PeerState();
+					}
+				}
+
+				ReplicationStats stats() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _stats;
+				}
+
+			private:
+				// Leaves room for the snapshot header and the transport headers in a 1200 bytes datagram.
+				static constexpr std::size_t MAX_FRAGMENT_SIZE = 1100;
+				static constexpr uint64_t MAX_IN_FLIGHT = 32;
+
+				struct ReplicatedObject
+				{
+					std::string type;
+					StreamWriter writer;
+					bool removed = false;
+					uint64_t changedAt = 0;
+				};
+
+				struct PeerState
+				{
+					// Change of each object the peer acknowledged, 0 for the objects sent but not acknowledged yet.
+					std::unordered_map<uint64_t, uint64_t> known;
+					// Objects of the fragments sent and not acknowledged yet, with the change they contain.
+					std::map<std::pair<uint64_t, uint16_t>, std::vector<std::pair<uint64_t, uint64_t>>> inFlight;
+				};
+
+				struct PeerSnapshot
+				{
+					std::string sessionId;
+					uint64_t sequence;
+					std::vector<std::pair<uint64_t, ReplicatedObject>> entries;
+				};
+
+				bool isAcknowledged(uint64_t id, uint64_t changedAt) const
+				{
+					for (auto& peer : _peers)
+					{
+						auto known = peer.second.known.find(id);
+						if (known != peer.second.known.end() && known->second < changedAt)
+						{
+							return false;
+						}
+					}
+					return true;
+				}
+
+				mutable std::mutex _mutex;
+				uint64_t _sequence = 0;
+				std::unordered_map<uint64_t, ReplicatedObject> _objects;
+				std::unordered_map<std::string, PeerState> _peers;
+				ReplicationStats _stats;
+			};
+
+			/// <summary>
+			/// Client side of the state replication: applies the snapshots of the host to the handlers of each object type.
+			/// </summary>
+			/// <remarks>
+			/// Fragments are applied as they arrive, and each of them is acknowledged: if one is lost, the next snapshot contains its objects again.
+			/// Every object remembers the snapshot of the state it was last given, so that a fragment arriving late does not bring back an older state.
+			/// <c>apply()</c> only deserializes a fragment: the handlers are called by <c>notify()</c>, outside of the lock,
+			/// so that they can call back into the replication client.
+			/// Objects of a type without handler are skipped.
+			/// </remarks>
+			class ReplicationClient
+			{
+			public:
+				using UpdateHandler = std::function<void(uint64_t, ibytestream&)>;
+				using RemoveHandler = std::function<void(uint64_t)>;
+
+				/// <summary>
+				/// Update or removal of an object, with the handlers of its type at the time it was received.
+				/// </summary>
+				struct Change
+				{
+					uint64_t id = 0;
+					bool removed = false;
+					std::vector<byte> value;
+					UpdateHandler onUpdated;
+					RemoveHandler onRemoved;
+				};
+
+				void subscribe(const std::string& type, UpdateHandler onUpdated, RemoveHandler onRemoved)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_handlers[type] = std::make_pair(onUpdated, onRemoved);
+				}
+
+				void reset()
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_lastSequence = 0;
+					_objects.clear();
+				}
+
+				/// <summary>
+				/// Apply a snapshot fragment, and append its changes to <c>changes</c>. Returns the fragment to acknowledge.
+				/// </summary>
+				/// <remarks>
+				/// The fragment is read entirely before anything is applied: a malformed fragment throws, and is neither applied nor acknowledged.
+				/// </remarks>
+				SnapshotFragment apply(ibytestream& stream, std::vector<Change>& changes)
+				{
+					Serializer serializer;
+					SnapshotFragment fragment;
+					uint32_t count;
+					serializer.deserialize(stream, fragment.sequence, fragment.fragment, count);
+
+					std::vector<std::pair<std::string, Change>> entries;
+					for (uint32_t i = 0; i < count; i++)
+					{
+						std::string type;
+						Change change;
+						serializer.deserialize(stream, change.id, type, change.removed);
+						if (!change.removed)
+						{
+							uint32_t size;
+							serializer.deserialize(stream, size);
+							if (static_cast<std::streamsize>(size) > stream.availableSize())
+							{
+								throw std::runtime_error("Truncated replication snapshot");
+							}
+							change.value.resize(size);
+							if (size > 0)
+							{
+								stream.read(change.value.data(), size);
+							}
+						}
+						entries.emplace_back(std::move(type), std::move(change));
+					}
+
+					std::lock_guard<std::mutex> lg(_mutex);
+					if (fragment.sequence > _lastSequence)
+					{
+						_lastSequence = fragment.sequence;
+						_stats.snapshots++;
+					}
+					for (auto& entry : entries)
+					{
+						auto& change = entry.second;
+						auto& object = _objects[change.id];
+						// The object changed again in a snapshot already applied.
+						if (fragment.sequence <= object.sequence)
+						{
+							continue;
+						}
+						object.sequence = fragment.sequence;
+						auto handler = _handlers.find(entry.first);
+						if (change.removed)
+						{
+							// Removed objects are remembered, so that a late update does not bring them back.
+							if (object.live && handler != _handlers.end() && handler->second.second)
+							{
+								change.onRemoved = handler->second.second;
+								changes.push_back(std::move(change));
+							}
+							object.live = false;
+						}
+						else if (handler != _handlers.end())
+						{
+							object.live = true;
+							change.onUpdated = handler->second.first;
+							changes.push_back(std::move(change));
+						}
+						_stats.objects++;
+					}
+					_stats.acks++;
+					return fragment;
+				}
+
+				/// <summary>
+				/// Call the handlers of changes returned by <c>apply()</c>, in order. Must not be called with the lock of the client held.
+				/// </summary>
+				static void notify(std::vector<Change>& changes)
+				{
+					for (auto& change : changes)
+					{
+						if (change.removed)
+						{
+							change.onRemoved(change.id);
+						}
+						else if (change.onUpdated)
+						{
+							ibytestream value(change.value.data(), static_cast<std::streamsize>(change.value.size()));
+							change.onUpdated(change.id, value);
+						}
+					}
+				}
+
+				ReplicationStats stats() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _stats;
+				}
+
+			private:
+				struct ReplicatedObject
+				{
+					// Snapshot of the last state or removal applied.
+					uint64_t sequence = 0;
+					bool live = false;
+				};
+
+				mutable std::mutex _mutex;
+				uint64_t _lastSequence = 0;
+				std::unordered_map<uint64_t, ReplicatedObject> _objects;
+				std::unordered_map<std::string, std::pair<UpdateHandler, RemoveHandler>> _handlers;
+				ReplicationStats _stats;
+			};
+		}
+	}
+}
@@ -0,0 +1,384 @@
+#pragma once
+#include "stormancer/RPC/Service.h"
+#include "stormancer/Tasks.h"
+#include "stormancer/msgpack_define.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Result compression requires zlib: define STORMANCER_GAMESESSION_ZLIB and link against zlib to enable it.
+// Without it, streamed results are uploaded as is.
+#if defined(STORMANCER_GAMESESSION_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		/// <summary>
+		/// Writes the next bytes of a streamed game result into <c>buffer</c>, and returns how many bytes were written (at most <c>size</c>).
+		/// </summary>
+		/// <remarks>
+		/// Returning 0 ends the result. The producer is called from background threads, but never concurrently.
+		/// </remarks>
+		using ResultProducer = std::function<std::size_t(char* buffer, std::size_t size)>;
+
+		/// <summary>
+		/// Options of a streamed result upload.
+		/// </summary>
+		struct ResultUploadOptions
+		{
+			/// <summary>
+			/// Maximum size of a chunk sent to the server.
+			/// </summary>
+			/// <remarks>
+			/// The server rejects chunks larger than 1 MB, uploads larger than 64 MB, and compressed results that inflate to more than 256 MB.
+			/// </remarks>
+			std::size_t chunkSize = 64 * 1024;
+			/// <summary>
+			/// Maximum number of chunks sent and not yet acknowledged by the server.
+			/// </summary>
+			/// <remarks>
+			/// The memory used by the upload is bounded by <c>(maxChunksInFlight + 1) * chunkSize</c>, whatever the size of the result.
+			/// </remarks>
+			unsigned int maxChunksInFlight = 4;
+			/// <summary>
+			/// Number of times a chunk is sent before the upload fails.
+			/// </summary>
+			unsigned int maxAttempts = 3;
+			/// <summary>
+			/// Compress the result. Ignored if the plugin is built without zlib support.
+			/// </summary>
+			bool compress = true;
+		};
+
+		namespace details
+		{
+			struct ResultUploadStatus
+			{
+				std::string uploadId;
+
+				MSGPACK_DEFINE(uploadId);
+			};
+
+			/// <summary>
+			/// Cuts the output of a result producer into chunks, compressing it on the fly if possible.
+			/// </summary>
+			class ResultChunker
+			{
+			public:
+				ResultChunker(ResultProducer producer, std::size_t chunkSize, bool compress)
+					: _producer(producer)
+					, _chunkSize(chunkSize)
+					, _input(chunkSize)
+				{
+#if defined(STORMANCER_GAMESESSION_ZLIB)
+					// Raw deflate, without zlib header: this is what the server side DeflateStream reads.
+					_compressed = compress && deflateInit2(&_zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+#else
+					(void)compress;
+#endif
+				}
+
+				ResultChunker(const ResultChunker&) = delete;
+				ResultChunker& operator=(const ResultChunker&) = delete;
+
+				~ResultChunker()
+				{
+#if defined(STORMANCER_GAMESESSION_ZLIB)
+					if (_compressed)
+					{
+						deflateEnd(&_zstream);
+					}
+#endif
+				}
+
+				bool compressed() const
+				{
+					return _compressed;
+				}
+
+				bool finished() const
+				{
+					return _finished;
+				}
+
+				/// <summary>
+				/// Read the next chunk. Returns false if the result is complete.
+				/// </summary>
+				bool next(std::vector<char>& chunk)
+				{
+					if (_finished)
+					{
+						return false;
+					}
+					chunk.resize(_chunkSize);
+					std::size_t size = _compressed ? nextCompressed(chunk) : nextRaw(chunk);
+					chunk.resize(size);
+					return size > 0;
+				}
+
+			private:
+
+				std::size_t nextRaw(std::vector<char>& chunk)
+				{
+					std::size_t size = 0;
+					while (size < chunk.size())
+					{
+						auto read = _producer(chunk.data() + size, chunk.size() - size);
+						if (read == 0)
+						{
+							_finished = true;
+							break;
+						}
+						size += read;
+					}
+					return size;
+				}
+
+				std::size_t nextCompressed(std::vector<char>& chunk)
+				{
+#if defined(STORMANCER_GAMESESSION_ZLIB)
+					_zstream.next_out = reinterpret_cast<Bytef*>(chunk.data());
+					_zstream.avail_out = static_cast<uInt>(chunk.size());
+					while (_zstream.avail_out > 0)
+					{
+						if (_zstream.avail_in == 0 && !_endOfInput)
+						{
+							auto read = _producer(_input.data(), _input.size());
+							_endOfInput = read == 0;
+							_zstream.next_in = reinterpret_cast<Bytef*>(_input.data());
+							_zstream.avail_in = static_cast<uInt>(read);
+						}
+						auto result = deflate(&_zstream, _endOfInput ? Z_FINISH : Z_NO_FLUSH);
+						if (result == Z_STREAM_END)
+						{
+							_finished = true;
+							break;
+						}
+						if (result != Z_OK && result != Z_BUF_ERROR)
+						{
+							throw std::runtime_error("Result compression failed");
+						}
+					}
+					return chunk.size() - _zstream.avail_out;
+#else
+					(void)chunk;
+					return 0;
+#endif
+				}
+
+				ResultProducer _producer;
+				std::size_t _chunkSize;
+				std::vector<char> _input;
+				bool _compressed = false;
+				bool _endOfInput = false;
+				bool _finished = false;
+#if defined(STORMANCER_GAMESESSION_ZLIB)
+				z_stream _zstream{};
+#endif
+			};
+
+			/// <summary>
+			/// Uploads a streamed result in chunks, with at most <c>maxChunksInFlight</c> chunks waiting for an acknowledgement.
+			/// </summary>
+			/// <remarks>
+			/// The server accepts chunks out of order and ignores duplicates, so a chunk that failed is simply sent again:
+			/// an upload survives transient failures without starting over.
+			/// It does not survive the connection to the game session: the server discards it when the player disconnects, or begins another upload.
+			/// </remarks>
+			class ResultUploader : public std::enable_shared_from_this<ResultUploader>
+			{
+			public:
+				ResultUploader(std::shared_ptr<RpcService> rpc, ResultProducer producer, ResultUploadOptions options, pplx::cancellation_token ct)
+					: _rpc(rpc)
+					, _options(options)
+					, _chunker(producer, options.chunkSize, options.compress)
+					, _ct(ct)
+				{
+				}
+
+				pplx::task<Packetisp_ptr> run()
+				{
+					std::weak_ptr<ResultUploader> wThat = this->shared_from_this();
+					return _rpc->rpc<ResultUploadStatus>(BEGIN_ROUTE, _ct)
+						.then([wThat](ResultUploadStatus status)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									throw PointerDeletedException("ResultUploader");
+								}
+								that->_uploadId = status.uploadId;
+								that->pump();
+								return pplx::create_task(that->_completed, pplx::task_options(that->_ct));
+							}, _ct);
+				}
+
+			private:
+
+				void pump()
+				{
+					std::vector<std::pair<uint32_t, std::shared_ptr<std::vector<char>>>> chunks;
+					bool complete = false;
+					{
+						std::lock_guard<std::mutex> lg(_mutex);
+						if (_failed)
+						{
+							return;
+						}
+						try
+						{
+							while (_inFlight < _options.maxChunksInFlight && !_chunker.finished())
+							{
+								auto chunk = std::make_shared<std::vector<char>>();
+								if (!_chunker.next(*chunk))
+								{
+									break;
+								}
+								_inFlight++;
+								chunks.emplace_back(_chunkCount++, chunk);
+							}
+						}
+						catch (...)
+						{
+							failImpl(std::current_exception());
+							return;
+						}
+						if (_inFlight == 0 && _chunker.finished() && !_completing)
+						{
+							_completing = true;
+							complete = true;
+						}
+					}
+
+					for (auto& chunk : chunks)
+					{
+						sendChunk(chunk.first, chunk.second, 1);
+					}
+					if (complete)
+					{
+						completeUpload();
+					}
+				}
+
+				void sendChunk(uint32_t index, std::shared_ptr<std::vector<char>> chunk, unsigned int attempt)
+				{
+					std::weak_ptr<ResultUploader> wThat = this->shared_from_this();
+					_rpc->rpc<uint32_t>(CHUNK_ROUTE, _ct, _uploadId, index, *chunk)
+						.then([wThat, index, chunk, attempt](pplx::task<uint32_t> task)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									return;
+								}
+								try
+								{
+									task.get();
+								}
+								catch (...)
+								{
+									if (attempt < that->_options.maxAttempts && !that->_ct.is_canceled())
+									{
+										that->retryChunk(index, chunk, attempt);
+									}
+									else
+									{
+										that->fail(std::current_exception());
+									}
+									return;
+								}
+								{
+									std::lock_guard<std::mutex> lg(that->_mutex);
+									that->_inFlight--;
+								}
+								that->pump();
+							});
+				}
+
+				void retryChunk(uint32_t index, std::shared_ptr<std::vector<char>> chunk, unsigned int attempt)
+				{
+					std::weak_ptr<ResultUploader> wThat = this->shared_from_this();
+					taskDelay(std::chrono::milliseconds(500 * attempt), _ct)
+						.then([wThat, index, chunk, attempt](pplx::task<void> task)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									return;
+								}
+								try
+								{
+									task.get();
+									that->sendChunk(index, chunk, attempt + 1);
+								}
+								catch (...)
+								{
+									that->fail(std::current_exception());
+								}
+							});
+				}
+
+				void completeUpload()
+				{
+					std::weak_ptr<ResultUploader> wThat = this->shared_from_this();
+					_rpc->rpc<Packetisp_ptr>(COMPLETE_ROUTE, _ct, _uploadId, _chunkCount, _chunker.compressed())
+						.then([wThat](pplx::task<Packetisp_ptr> task)
+							{
+								auto that = wThat.lock();
+								if (!that)
+								{
+									return;
+								}
+								try
+								{
+									that->_completed.set(task.get());
+								}
+								catch (...)
+								{
+									that->fail(std::current_exception());
+								}
+							});
+				}
+
+				void fail(std::exception_ptr ex)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					failImpl(ex);
+				}
+
+				void failImpl(std::exception_ptr ex)
+				{
+					if (!_failed)
+					{
+						_failed = true;
+						_completed.set_exception(ex);
+					}
+				}
+
+				static constexpr const char* BEGIN_ROUTE = "GameSession.BeginResultUpload";
+				static constexpr const char* CHUNK_ROUTE = "GameSession.PostResultChunk";
+				static constexpr const char* COMPLETE_ROUTE = "gamesession.completeresultupload";
+
+				std::shared_ptr<RpcService> _rpc;
+				ResultUploadOptions _options;
+				std::mutex _mutex;
+				ResultChunker _chunker;
+				pplx::cancellation_token _ct;
+				std::string _uploadId;
+				uint32_t _chunkCount = 0;
+				unsigned int _inFlight = 0;
+				bool _completing = false;
+				bool _failed = false;
+				pplx::task_completion_event<Packetisp_ptr> _completed;
+			};
+		}
+	}
+}
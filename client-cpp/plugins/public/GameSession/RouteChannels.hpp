@@ -0,0 +1,102 @@
+#pragma once
+#include "stormancer/Scene.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		/// <summary>
+		/// Delivery guarantees of the messages sent on a route.
+		/// </summary>
+		enum class DeliveryMode
+		{
+			/// <summary>
+			/// Messages can be lost, duplicated or reordered. Suited to data that is resent continuously.
+			/// </summary>
+			Unreliable,
+			/// <summary>
+			/// Messages can be lost, and older messages are dropped when a newer one has already been received. Suited to state snapshots.
+			/// </summary>
+			UnreliableSequenced,
+			/// <summary>
+			/// Messages are always delivered, in any order. A lost message never delays the following ones.
+			/// </summary>
+			ReliableUnordered,
+			/// <summary>
+			/// Messages are always delivered, in order. A lost message delays the following messages of the same ordering channel.
+			/// </summary>
+			ReliableOrdered
+		};
+
+		/// <summary>
+		/// How the messages of a route are sent.
+		/// </summary>
+		struct RouteChannel
+		{
+			DeliveryMode mode = DeliveryMode::ReliableOrdered;
+			PacketPriority priority = PacketPriority::MEDIUM_PRIORITY;
+			/// <summary>
+			/// Ordering channel of the route. Routes that do not share an ordering channel never block each other.
+			/// </summary>
+			std::string orderingChannel;
+
+			PacketReliability reliability() const
+			{
+				switch (mode)
+				{
+				case DeliveryMode::Unreliable:
+					return PacketReliability::UNRELIABLE;
+				case DeliveryMode::UnreliableSequenced:
+					return PacketReliability::UNRELIABLE_SEQUENCED;
+				case DeliveryMode::ReliableUnordered:
+					return PacketReliability::RELIABLE;
+				default:
+					return PacketReliability::RELIABLE_ORDERED;
+				}
+			}
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// Channel declarations of the P2P routes of a game session.
+			/// </summary>
+			/// <remarks>
+			/// A route that was not declared is sent reliable and ordered, on an ordering channel of its own.
+			/// </remarks>
+			class RouteChannels
+			{
+			public:
+				void declare(const std::string& route, RouteChannel channel)
+				{
+					if (channel.orderingChannel.empty())
+					{
+						channel.orderingChannel = route;
+					}
+					std::lock_guard<std::mutex> lg(_mutex);
+					_channels[route] = channel;
+				}
+
+				RouteChannel get(const std::string& route) const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					auto it = _channels.find(route);
+					if (it != _channels.end())
+					{
+						return it->second;
+					}
+					RouteChannel channel;
+					channel.orderingChannel = route;
+					return channel;
+				}
+
+			private:
+				mutable std::mutex _mutex;
+				std::unordered_map<std::string, RouteChannel> _channels;
+			};
+		}
+	}
+}
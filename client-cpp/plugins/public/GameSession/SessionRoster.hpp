@@ -0,0 +1,181 @@
+#pragma once
+#include "stormancer/msgpack_define.h"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		enum class PlayerStatus
+		{
+			NotConnected = 0,
+			Connected = 1,
+			Ready = 2,
+			Faulted = 3,
+			Disconnected = 4
+		};
+
+		struct SessionPlayer
+		{
+		public:
+			SessionPlayer(std::string playerId, PlayerStatus status, bool isHost = false)
+				: playerId(playerId)
+				, status(status)
+				, isHost(isHost)
+			{
+			}
+
+			std::string playerId;
+			PlayerStatus status;
+			bool isHost;
+		};
+
+		struct PlayerUpdate
+		{
+		public:
+			std::string userId;
+			int status;
+			std::string data;
+			bool isHost;
+			// Empty if the player is disconnected, or if the server does not send it.
+			std::string sessionId;
+
+			MSGPACK_DEFINE(userId, status, data, isHost, sessionId);
+		};
+
+		struct PlayerUpdateBatch
+		{
+		public:
+			uint64_t sequence;
+			std::vector<PlayerUpdate> updates;
+
+			MSGPACK_DEFINE(sequence, updates);
+		};
+
+		/// <summary>
+		/// New state of a player, with the data the player sent along (e.g. with <c>setPlayerReady()</c>).
+		/// </summary>
+		struct SessionPlayerUpdate
+		{
+			SessionPlayer player;
+			std::string data;
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// Players of a game session, indexed by player id.
+			/// </summary>
+			/// <remarks>
+			/// A player keeps the same slot for the whole session, even once disconnected.
+			/// The roster is updated from the network thread: players are returned by copy, taken under its lock.
+			/// The number of ready players is updated with each player, so that knowing whether everyone is ready does not require going through the players.
+			/// </remarks>
+			class SessionRoster
+			{
+			public:
+				/// <summary>
+				/// Apply a player update, and return the updated player.
+				/// </summary>
+				SessionPlayer update(const PlayerUpdate& update)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return apply(update);
+				}
+
+				/// <summary>
+				/// Apply a batch of player updates as a whole.
+				/// </summary>
+				/// <returns>False, without applying the batch, if this batch or a more recent one was already applied.</returns>
+				bool update(const PlayerUpdateBatch& batch, std::vector<SessionPlayerUpdate>& updated)
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					if (_hasSequence && batch.sequence <= _sequence)
+					{
+						return false;
+					}
+					_hasSequence = true;
+					_sequence = batch.sequence;
+					updated.reserve(batch.updates.size());
+					for (auto& update : batch.updates)
+					{
+						updated.push_back(SessionPlayerUpdate{ apply(update), update.data });
+					}
+					return true;
+				}
+
+				std::vector<SessionPlayer> players() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return std::vector<SessionPlayer>(_players.begin(), _players.end());
+				}
+
+				/// <summary>
+				/// True if every player still in the session is ready.
+				/// </summary>
+				bool allReady() const
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					return _activeCount > 0 && _readyCount == _activeCount;
+				}
+
+				void clear()
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					_players.clear();
+					_indices.clear();
+					_activeCount = 0;
+					_readyCount = 0;
+					_hasSequence = false;
+					_sequence = 0;
+				}
+
+			private:
+				const SessionPlayer& apply(const PlayerUpdate& update)
+				{
+					auto it = _indices.find(update.userId);
+					if (it == _indices.end())
+					{
+						_indices.emplace(update.userId, _players.size());
+						_players.emplace_back(update.userId, (PlayerStatus)update.status, update.isHost);
+						count(_players.back(), 1);
+						return _players.back();
+					}
+
+					auto& player = _players[it->second];
+					count(player, -1);
+					player.status = (PlayerStatus)update.status;
+					player.isHost = update.isHost;
+					count(player, 1);
+					return player;
+				}
+
+				void count(const SessionPlayer& player, int delta)
+				{
+					if (player.status != PlayerStatus::Disconnected)
+					{
+						_activeCount += delta;
+					}
+					if (player.status == PlayerStatus::Ready)
+					{
+						_readyCount += delta;
+					}
+				}
+
+				mutable std::mutex _mutex;
+				// A deque, because references to its elements survive insertions.
+				std::deque<SessionPlayer> _players;
+				std::unordered_map<std::string, std::size_t> _indices;
+				int _activeCount = 0;
+				int _readyCount = 0;
+				bool _hasSequence = false;
+				uint64_t _sequence = 0;
+			};
+		}
+	}
+}
@@ -0,0 +1,98 @@
+// Accuracy of ClockSynchronizer on a link with random, asymmetric queuing delays.
+//
+// No dependency besides the header:
+//   g++ -std=c++17 -O2 -I client-cpp/plugins/public client-cpp/plugins/public/GameSession/Tests/ClockSyncAccuracyTest.cpp -o clock-sync-test
+//   ./clock-sync-test
+//
+// The host clock is simulated with an offset and a drift. Each sample crosses a link with a 20 ms base delay per direction,
+// and an exponential queuing delay drawn independently for each direction. Over 20 seeds, the worst error of the session time
+// must stay below a fraction of the mean jitter. Returns 1 otherwise.
+
+#include "GameSession/ClockSync.hpp"
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace Stormancer::GameSessions;
+
+namespace
+{
+	constexpr int64_t HOST_OFFSET = 3600LL * 1000 * 1000;
+	constexpr double HOST_DRIFT = 50e-6;
+	constexpr int64_t BASE_DELAY = 20000;
+
+	int64_t hostTime(int64_t local)
+	{
+		return local + HOST_OFFSET + static_cast<int64_t>(HOST_DRIFT * local);
+	}
+
+	struct Result
+	{
+		double maxError = 0;
+		bool synchronized = false;
+	};
+
+	// Sends one sample per second for `duration` seconds, then measures the error of toSessionTime() over the next 10 seconds.
+	Result run(double meanJitter, int duration, unsigned int seed)
+	{
+		std::mt19937 random(seed);
+		std::exponential_distribution<double> jitter(1.0 / meanJitter);
+		details::ClockSynchronizer clock;
+		clock.reset(false);
+
+		int64_t now = 1000000;
+		for (int i = 0; i < duration; i++)
+		{
+			auto t0 = now;
+			auto forward = BASE_DELAY + static_cast<int64_t>(jitter(random));
+			auto backward = BASE_DELAY + static_cast<int64_t>(jitter(random));
+			auto t1 = hostTime(t0 + forward);
+			auto t2 = t1 + 100;
+			auto t3 = t0 + forward + 100 + backward;
+			clock.addSample(t0, t1, t2, t3);
+			now += 1000000;
+		}
+
+		Result result;
+		result.synchronized = clock.state().synchronized;
+		for (int64_t t = now; t < now + 10000000; t += 100000)
+		{
+			result.maxError = std::max(result.maxError, std::abs(static_cast<double>(clock.toSessionTime(t) - hostTime(t))));
+		}
+		return result;
+	}
+}
+
+int main()
+{
+	struct Case
+	{
+		double meanJitter;
+		int duration;
+	};
+	// Averaging every sample leaves an error of about 0.45 times the mean jitter on this link, keeping the fastest half about 0.43.
+	const double TOLERANCE = 0.35;
+	const Case cases[] = {
+		{ 1000, 60 },
+		{ 10000, 60 },
+		{ 30000, 120 },
+	};
+
+	bool failed = false;
+	for (auto& test : cases)
+	{
+		double worst = 0;
+		bool synchronized = true;
+		for (unsigned int seed = 1; seed <= 20; seed++)
+		{
+			auto result = run(test.meanJitter, test.duration, seed);
+			worst = std::max(worst, result.maxError);
+			synchronized = synchronized && result.synchronized;
+		}
+		auto tolerance = TOLERANCE * test.meanJitter;
+		auto ok = synchronized && worst <= tolerance;
+		failed = failed || !ok;
+		std::printf("%s mean jitter %6.0f us, %3d samples: max error %7.0f us (tolerance %6.0f us)\n", ok ? "PASS" : "FAIL", test.meanJitter, test.duration, worst, tolerance);
+	}
+	return failed ? 1 : 0;
+}
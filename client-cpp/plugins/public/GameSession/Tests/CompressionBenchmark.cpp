@@ -0,0 +1,167 @@
+// Compression ratio and CPU cost of PayloadCompressor on small game payloads, with a trained dictionary and without dictionary.
+//
+// Requires zstd:
+//   g++ -std=c++17 -O2 -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/GameSession/Tests/CompressionBenchmark.cpp -lzstd -o compression-benchmark
+//   ./compression-benchmark [payloads] [dictionaryCapacity]
+//
+// Payloads are msgpack-encoded snapshots of 1 to 8 entities (id, type, position, orientation, health, flags), as a game sends every tick.
+// A dictionary is trained on <payloads> payloads with startTraining() and train(), then a different set of payloads of the same game is
+// compressed with it, and with zstd at the same level without dictionary, each payload on its own.
+
+#define STORMANCER_GAMESESSION_ZSTD
+#include "GameSession/PayloadCompression.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace Stormancer::GameSessions;
+
+namespace
+{
+	constexpr int COMPRESSION_LEVEL = 3;
+
+	class PayloadGenerator
+	{
+	public:
+		PayloadGenerator(unsigned int seed) : _random(seed)
+		{
+		}
+
+		std::string next()
+		{
+			static const char* TYPES[] = { "soldier", "vehicle", "projectile", "pickup" };
+			std::uniform_int_distribution<int> count(1, 8);
+			std::uniform_int_distribution<uint32_t> id(1000, 1200);
+			std::uniform_int_distribution<int> type(0, 3);
+			std::uniform_real_distribution<float> position(-500.f, 500.f);
+			std::uniform_real_distribution<float> angle(0.f, 360.f);
+			std::uniform_int_distribution<int> health(0, 100);
+			std::bernoulli_distribution flag(0.2);
+
+			std::string payload;
+			auto entities = count(_random);
+			payload += static_cast<char>(0x90 | entities);
+			for (int i = 0; i < entities; i++)
+			{
+				payload += static_cast<char>(0x98);
+				writeUint32(payload, id(_random));
+				auto name = TYPES[type(_random)];
+				payload += static_cast<char>(0xa0 | std::strlen(name));
+				payload += name;
+				// Positions on a 1 cm grid, as game engines quantize them.
+				writeFloat(payload, std::round(position(_random) * 100) / 100);
+				writeFloat(payload, std::round(position(_random) * 100) / 100);
+				writeFloat(payload, 0.f);
+				writeFloat(payload, std::round(angle(_random)));
+				payload += static_cast<char>(health(_random));
+				payload += static_cast<char>(flag(_random) ? 0xc3 : 0xc2);
+			}
+			return payload;
+		}
+
+	private:
+		static void writeUint32(std::string& payload, uint32_t value)
+		{
+			payload += static_cast<char>(0xce);
+			for (int shift = 24; shift >= 0; shift -= 8)
+			{
+				payload += static_cast<char>((value >> shift) & 0xff);
+			}
+		}
+
+		static void writeFloat(std::string& payload, float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			payload += static_cast<char>(0xca);
+			for (int shift = 24; shift >= 0; shift -= 8)
+			{
+				payload += static_cast<char>((bits >> shift) & 0xff);
+			}
+		}
+
+		std::mt19937 _random;
+	};
+
+	double microseconds(std::chrono::steady_clock::duration duration, std::size_t count)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count() / count;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t payloads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+	std::size_t dictionaryCapacity = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 16 * 1024;
+
+	details::PayloadCompressor compressor;
+	PayloadGenerator training(1);
+	compressor.startTraining();
+	for (std::size_t i = 0; i < payloads; i++)
+	{
+		compressor.compress(training.next());
+	}
+	auto trainingStart = std::chrono::steady_clock::now();
+	auto dictionaryId = compressor.train(dictionaryCapacity);
+	auto trainingTime = std::chrono::steady_clock::now() - trainingStart;
+	if (dictionaryId == 0)
+	{
+		std::printf("Could not train a dictionary\n");
+		return 1;
+	}
+
+	PayloadGenerator test(2);
+	std::vector<std::string> originals;
+	std::size_t originalBytes = 0;
+	for (std::size_t i = 0; i < payloads; i++)
+	{
+		originals.push_back(test.next());
+		originalBytes += originals.back().size();
+	}
+
+	std::vector<details::CompressedPayload> compressed;
+	std::size_t dictionaryBytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (auto& payload : originals)
+	{
+		compressed.push_back(compressor.compress(payload));
+		dictionaryBytes += compressed.back().data.size();
+	}
+	auto compressionTime = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < compressed.size(); i++)
+	{
+		if (compressor.decompress(compressed[i]) != originals[i])
+		{
+			std::printf("Decompressed payload %zu differs\n", i);
+			return 1;
+		}
+	}
+	auto decompressionTime = std::chrono::steady_clock::now() - start;
+
+	auto cctx = ZSTD_createCCtx();
+	std::size_t plainBytes = 0;
+	std::string buffer;
+	start = std::chrono::steady_clock::now();
+	for (auto& payload : originals)
+	{
+		buffer.resize(ZSTD_compressBound(payload.size()));
+		auto size = ZSTD_compressCCtx(cctx, &buffer[0], buffer.size(), payload.data(), payload.size(), COMPRESSION_LEVEL);
+		// As PayloadCompressor, payloads that do not get smaller are sent as is.
+		plainBytes += ZSTD_isError(size) ? payload.size() : std::min(size, payload.size());
+	}
+	auto plainTime = std::chrono::steady_clock::now() - start;
+	ZSTD_freeCCtx(cctx);
+
+	std::printf("%zu payloads, %.1f bytes on average; dictionary of %zu bytes trained in %.1f ms\n", payloads, static_cast<double>(originalBytes) / payloads,
+		compressor.dictionary().size(), std::chrono::duration<double, std::milli>(trainingTime).count());
+	std::printf("without dictionary   ratio %.3f, compression %6.2f us/payload\n", static_cast<double>(plainBytes) / originalBytes, microseconds(plainTime, payloads));
+	std::printf("with dictionary      ratio %.3f, compression %6.2f us/payload, decompression %6.2f us/payload\n", static_cast<double>(dictionaryBytes) / originalBytes,
+		microseconds(compressionTime, payloads), microseconds(decompressionTime, payloads));
+	return 0;
+}
@@ -0,0 +1,216 @@
+// Delivery ratio and latency of the P2P delivery modes under packet loss, and head-of-line blocking between ordering channels.
+//
+// Requires the Stormancer client library, and the p2p sample server application (see server/) running on this machine:
+//   g++ -std=c++17 -O2 -pthread -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/GameSession/Tests/DeliveryModesBenchmark.cpp -L <StormancerSDK>/lib -lstormancer -o delivery-modes-benchmark
+//   sudo tc qdisc add dev lo root netem delay 20ms loss 2%
+//   ./delivery-modes-benchmark [endpoint] [account] [application] [seconds]
+//   sudo tc qdisc del dev lo root
+//
+// Two players join a game session from this process: the P2P link between them crosses the loopback interface, where netem injects the loss.
+// The client sends to the host, at 60 messages per second on each route: a message on a route of each delivery mode, and a 1 KB message
+// on a reliable "bulk" route. The bulk route shares the ordering channel of the "ordered-shared" route, which is otherwise identical to
+// the "ordered" route: the difference between the two is the delay added by the retransmissions of the bulk route.
+
+#include "stormancer/IClient.h"
+#include "Users/Users.hpp"
+#include "GameFinder/GameFinder.hpp"
+#include "GameSession/Gamesessions.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace Stormancer;
+using GameSessions::DeliveryMode;
+
+namespace
+{
+	constexpr std::chrono::microseconds SEND_INTERVAL{ 1000000 / 60 };
+	constexpr char BULK_ROUTE[] = "benchmark.bulk";
+	constexpr std::size_t BULK_SIZE = 1024;
+
+	struct GameFinderParameters
+	{
+		std::string gameId;
+		MSGPACK_DEFINE(gameId)
+	};
+
+	struct TestRoute
+	{
+		const char* route;
+		DeliveryMode mode;
+		const char* orderingChannel;
+	};
+
+	const TestRoute ROUTES[] = {
+		{ "benchmark.unreliable", DeliveryMode::Unreliable, "" },
+		{ "benchmark.sequenced", DeliveryMode::UnreliableSequenced, "" },
+		{ "benchmark.unordered", DeliveryMode::ReliableUnordered, "" },
+		{ "benchmark.ordered", DeliveryMode::ReliableOrdered, "" },
+		{ "benchmark.ordered-shared", DeliveryMode::ReliableOrdered, "shared" },
+	};
+
+	int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	class Latencies
+	{
+	public:
+		void add(ibytestream& stream)
+		{
+			Serializer serializer;
+			auto sent = serializer.deserializeOne<int64_t>(stream);
+			auto latency = (now() - sent) / 1000.0;
+			std::lock_guard<std::mutex> lg(_mutex);
+			_values.push_back(latency);
+		}
+
+		std::vector<double> values()
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			auto values = _values;
+			std::sort(values.begin(), values.end());
+			return values;
+		}
+
+	private:
+		std::mutex _mutex;
+		std::vector<double> _values;
+	};
+
+	struct Player
+	{
+		std::shared_ptr<IClient> client;
+		std::shared_ptr<GameSessions::GameSession> gameSession;
+		Event<std::shared_ptr<Scene>>::Subscription connecting;
+		GameSessions::GameSessionConnectionParameters connection;
+	};
+
+	Player createPlayer(const std::string& endpoint, const std::string& account, const std::string& application, const std::string& userId, std::vector<std::shared_ptr<Latencies>> latencies)
+	{
+		auto config = Configuration::create(endpoint, account, application);
+		config->addPlugin(new Users::UsersPlugin());
+		config->addPlugin(new GameFinder::GameFinderPlugin());
+		config->addPlugin(new GameSessions::GameSessionsPlugin());
+
+		Player player;
+		player.client = IClient::create(config);
+		auto users = player.client->dependencyResolver().resolve<Users::UsersApi>();
+		users->getCredentialsCallback = [userId]()
+		{
+			Users::AuthParameters p;
+			p.type = "deviceidentifier";
+			p.parameters.emplace("deviceidentifier", userId);
+			return pplx::task_from_result(p);
+		};
+
+		player.gameSession = player.client->dependencyResolver().resolve<GameSessions::GameSession>();
+		for (auto& route : ROUTES)
+		{
+			player.gameSession->declareRoute(route.route, route.mode, PacketPriority::MEDIUM_PRIORITY, route.orderingChannel);
+		}
+		player.gameSession->declareRoute(BULK_ROUTE, DeliveryMode::ReliableOrdered, PacketPriority::MEDIUM_PRIORITY, "shared");
+		player.connecting = player.gameSession->onConnectingToScene.subscribe([latencies](std::shared_ptr<Scene> scene)
+		{
+			for (std::size_t i = 0; i < latencies.size(); i++)
+			{
+				auto routeLatencies = latencies[i];
+				scene->addRoute(ROUTES[i].route, [routeLatencies](Packetisp_ptr packet)
+				{
+					routeLatencies->add(packet->stream);
+				}, MessageOriginFilter::Peer);
+			}
+			scene->addRoute(BULK_ROUTE, [](Packetisp_ptr) {}, MessageOriginFilter::Peer);
+		});
+		return player;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string endpoint = argc > 1 ? argv[1] : "http://localhost:8081";
+	std::string account = argc > 2 ? argv[2] : "samples";
+	std::string application = argc > 3 ? argv[3] : "p2p";
+	int seconds = argc > 4 ? std::atoi(argv[4]) : 30;
+
+	std::vector<std::shared_ptr<Latencies>> latencies;
+	for (std::size_t i = 0; i < sizeof(ROUTES) / sizeof(ROUTES[0]); i++)
+	{
+		latencies.push_back(std::make_shared<Latencies>());
+	}
+
+	auto gameId = "delivery-modes-benchmark-" + std::to_string(now());
+	std::vector<Player> players;
+	std::vector<pplx::task<GameSessions::GameSessionConnectionParameters>> joins;
+	for (int i = 0; i < 2; i++)
+	{
+		players.push_back(createPlayer(endpoint, account, application, gameId + "-" + std::to_string(i), latencies));
+		auto gameFinder = players.back().client->dependencyResolver().resolve<GameFinder::GameFinderApi>();
+		auto gameSession = players.back().gameSession;
+		auto gameFound = gameFinder->waitGameFound();
+		GameFinderParameters parameters;
+		parameters.gameId = gameId;
+		joins.push_back(gameFinder->findGame("default", "p2p-sample", parameters)
+			.then([gameFound]()
+			{
+				return gameFound;
+			})
+			.then([gameSession](GameFinder::GameFoundEvent event)
+			{
+				return gameSession->connectToGameSession(event.data.connectionToken, "", false);
+			}));
+	}
+	for (std::size_t i = 0; i < players.size(); i++)
+	{
+		players[i].connection = joins[i].get();
+	}
+	auto& sender = players[0].connection.isHost ? players[1] : players[0];
+
+	int messages = seconds * 60;
+	std::string bulk(BULK_SIZE, 'b');
+	auto next = std::chrono::steady_clock::now();
+	for (int m = 0; m < messages; m++)
+	{
+		auto sent = now();
+		for (auto& route : ROUTES)
+		{
+			sender.gameSession->sendToSessionPeers(route.route, [sent](obytestream& stream)
+			{
+				Serializer serializer;
+				serializer.serialize(stream, sent);
+			});
+		}
+		sender.gameSession->sendToSessionPeers(BULK_ROUTE, [bulk](obytestream& stream)
+		{
+			Serializer serializer;
+			serializer.serialize(stream, bulk);
+		});
+		next += SEND_INTERVAL;
+		std::this_thread::sleep_until(next);
+	}
+	// Leaves time for the retransmissions.
+	std::this_thread::sleep_for(std::chrono::seconds(3));
+
+	std::printf("%d messages per route\n", messages);
+	for (std::size_t i = 0; i < latencies.size(); i++)
+	{
+		auto values = latencies[i]->values();
+		auto percentile = [&values](double p)
+		{
+			return values.empty() ? 0.0 : values[std::min(values.size() - 1, static_cast<std::size_t>(p * values.size()))];
+		};
+		std::printf("%-26s delivered %5.1f%%, latency p50 %7.2f ms, p99 %7.2f ms, max %7.2f ms\n",
+			ROUTES[i].route, 100.0 * values.size() / messages, percentile(0.5), percentile(0.99), percentile(1));
+	}
+
+	for (auto& player : players)
+	{
+		player.gameSession->disconnectFromGameSession().get();
+		player.client->disconnect().get();
+	}
+	return 0;
+}
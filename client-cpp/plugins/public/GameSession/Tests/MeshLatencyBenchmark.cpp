@@ -0,0 +1,198 @@
+// Latency of the messages exchanged by every player of a game session, in the star and mesh P2P topologies.
+//
+// Requires the Stormancer client library, and the p2p sample server application (see server/):
+//   g++ -std=c++17 -O2 -pthread -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/GameSession/Tests/MeshLatencyBenchmark.cpp -L <StormancerSDK>/lib -lstormancer -o mesh-latency-benchmark
+//   ./mesh-latency-benchmark [endpoint] [account] [application] [messages]
+//
+// For 8 then 16 players, and each topology, the players join the same game session from this process, then each of them sends <messages>
+// messages to every other player with sendToSessionPeers(), one every 20 ms. Messages carry the time they were sent, so that the receivers,
+// which share the clock of the process, measure their one-way latency. In the star topology, the messages between clients are relayed by the host.
+
+#include "stormancer/IClient.h"
+#include "Users/Users.hpp"
+#include "GameFinder/GameFinder.hpp"
+#include "GameSession/Gamesessions.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace Stormancer;
+
+namespace
+{
+	constexpr char LATENCY_ROUTE[] = "benchmark.latency";
+	constexpr std::chrono::milliseconds SEND_INTERVAL{ 20 };
+	// Mesh links are opened after connectToGameSession() completes.
+	constexpr std::chrono::seconds MESH_DELAY{ 5 };
+
+	struct GameFinderParameters
+	{
+		std::string gameId;
+		MSGPACK_DEFINE(gameId)
+	};
+
+	int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	class Latencies
+	{
+	public:
+		void add(ibytestream& stream)
+		{
+			Serializer serializer;
+			auto sent = serializer.deserializeOne<int64_t>(stream);
+			auto latency = (now() - sent) / 1000.0;
+			std::lock_guard<std::mutex> lg(_mutex);
+			_values.push_back(latency);
+		}
+
+		std::vector<double> values()
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			auto values = _values;
+			std::sort(values.begin(), values.end());
+			return values;
+		}
+
+	private:
+		std::mutex _mutex;
+		std::vector<double> _values;
+	};
+
+	struct Player
+	{
+		std::shared_ptr<IClient> client;
+		std::shared_ptr<GameSessions::GameSession> gameSession;
+		Event<std::shared_ptr<Scene>>::Subscription connecting;
+		Event<std::string, std::string, Packetisp_ptr>::Subscription relayed;
+	};
+
+	Player createPlayer(const std::string& endpoint, const std::string& account, const std::string& application, const std::string& userId, GameSessions::P2PTopology topology, std::shared_ptr<Latencies> latencies)
+	{
+		auto config = Configuration::create(endpoint, account, application);
+		config->addPlugin(new Users::UsersPlugin());
+		config->addPlugin(new GameFinder::GameFinderPlugin());
+		config->addPlugin(new GameSessions::GameSessionsPlugin());
+
+		Player player;
+		player.client = IClient::create(config);
+		auto users = player.client->dependencyResolver().resolve<Users::UsersApi>();
+		users->getCredentialsCallback = [userId]()
+		{
+			Users::AuthParameters p;
+			p.type = "deviceidentifier";
+			p.parameters.emplace("deviceidentifier", userId);
+			return pplx::task_from_result(p);
+		};
+
+		player.gameSession = player.client->dependencyResolver().resolve<GameSessions::GameSession>();
+		player.gameSession->setP2PTopology(topology);
+		player.connecting = player.gameSession->onConnectingToScene.subscribe([latencies](std::shared_ptr<Scene> scene)
+		{
+			scene->addRoute(LATENCY_ROUTE, [latencies](Packetisp_ptr packet)
+			{
+				latencies->add(packet->stream);
+			}, MessageOriginFilter::Peer);
+		});
+		player.relayed = player.gameSession->onRelayedMessage.subscribe([latencies](std::string, std::string route, Packetisp_ptr packet)
+		{
+			if (route == LATENCY_ROUTE)
+			{
+				latencies->add(packet->stream);
+			}
+		});
+		return player;
+	}
+
+	void run(const std::string& endpoint, const std::string& account, const std::string& application, int players, GameSessions::P2PTopology topology, int messages)
+	{
+		auto name = topology == GameSessions::P2PTopology::Mesh ? "mesh" : "star";
+		auto gameId = "mesh-latency-benchmark-" + std::string(name) + "-" + std::to_string(players) + "-" + std::to_string(now());
+		auto latencies = std::make_shared<Latencies>();
+
+		std::vector<Player> session;
+		std::vector<pplx::task<void>> joins;
+		for (int i = 0; i < players; i++)
+		{
+			session.push_back(createPlayer(endpoint, account, application, gameId + "-" + std::to_string(i), topology, latencies));
+			auto& player = session.back();
+			auto gameFinder = player.client->dependencyResolver().resolve<GameFinder::GameFinderApi>();
+			auto gameSession = player.gameSession;
+			auto gameFound = gameFinder->waitGameFound();
+			GameFinderParameters parameters;
+			parameters.gameId = gameId;
+			joins.push_back(gameFinder->findGame("default", "p2p-sample", parameters)
+				.then([gameFound]()
+				{
+					return gameFound;
+				})
+				.then([gameSession](GameFinder::GameFoundEvent event)
+				{
+					return gameSession->connectToGameSession(event.data.connectionToken, "", false);
+				})
+				.then([gameSession](GameSessions::GameSessionConnectionParameters)
+				{
+					return gameSession->setPlayerReady();
+				}));
+		}
+		pplx::when_all(joins.begin(), joins.end()).get();
+		std::this_thread::sleep_for(MESH_DELAY);
+
+		for (int m = 0; m < messages; m++)
+		{
+			for (auto& player : session)
+			{
+				auto sent = now();
+				player.gameSession->sendToSessionPeers(LATENCY_ROUTE, [sent](obytestream& stream)
+				{
+					Serializer serializer;
+					serializer.serialize(stream, sent);
+				});
+			}
+			std::this_thread::sleep_for(SEND_INTERVAL);
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(2));
+
+		auto values = latencies->values();
+		auto expected = static_cast<std::size_t>(players) * (players - 1) * messages;
+		auto percentile = [&values](double p)
+		{
+			return values.empty() ? 0.0 : values[std::min(values.size() - 1, static_cast<std::size_t>(p * values.size()))];
+		};
+		double sum = 0;
+		for (auto value : values)
+		{
+			sum += value;
+		}
+		std::printf("%2d players, %s: %zu/%zu messages, latency mean %6.2f ms, p50 %6.2f ms, p99 %6.2f ms, max %6.2f ms\n",
+			players, name, values.size(), expected, values.empty() ? 0.0 : sum / values.size(), percentile(0.5), percentile(0.99), percentile(1));
+
+		for (auto& player : session)
+		{
+			player.gameSession->disconnectFromGameSession().get();
+			player.client->disconnect().get();
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string endpoint = argc > 1 ? argv[1] : "http://gc3.stormancer.com:81";
+	std::string account = argc > 2 ? argv[2] : "samples";
+	std::string application = argc > 3 ? argv[3] : "p2p";
+	int messages = argc > 4 ? std::atoi(argv[4]) : 500;
+
+	for (int players : { 8, 16 })
+	{
+		for (auto topology : { GameSessions::P2PTopology::Star, GameSessions::P2PTopology::Mesh })
+		{
+			run(endpoint, account, application, players, topology, messages);
+		}
+	}
+	return 0;
+}
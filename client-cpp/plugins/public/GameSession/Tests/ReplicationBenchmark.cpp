@@ -0,0 +1,225 @@
+// Bandwidth and CPU cost of the state replication of a host with 10,000 entities and 16 players, under packet loss.
+//
+// Requires the Stormancer client library headers:
+//   g++ -std=c++17 -O2 -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/GameSession/Tests/ReplicationBenchmark.cpp -L <StormancerSDK>/lib -lstormancer -o replication-benchmark
+//   ./replication-benchmark [entities] [peers] [changesPerTick] [ticks] [lossPercent]
+//
+// The host replicates <entities> entities, and changes <changesPerTick> of them every tick: 1% of the changes destroy the entity, the others move it.
+// Its snapshots and the acknowledgements of the players go through an in-memory link that loses <lossPercent>% of the messages.
+// The benchmark reports the size of the first snapshot of a player (the whole state), the size of the following ones, compared with sending
+// the whole state every tick, and the CPU time of the host and the players.
+// Players have no handler for the 100 "effect" objects the host also replicates, and skip them. Their handlers call back into their
+// replication client, which therefore must not hold its lock while calling them.
+// After the last tick, two snapshots are sent without loss: every player must then have the state of the host.
+// Returns 1 otherwise.
+
+#include "GameSession/Replication.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace Stormancer;
+using namespace Stormancer::GameSessions;
+
+namespace
+{
+	constexpr char ENTITY_TYPE[] = "entity";
+	constexpr char EFFECT_TYPE[] = "effect";
+	constexpr uint64_t EFFECTS = 100;
+
+	struct Entity
+	{
+		float x = 0;
+		float y = 0;
+		float yaw = 0;
+		uint32_t health = 100;
+		bool removed = false;
+	};
+
+	struct Player
+	{
+		std::string sessionId;
+		details::ReplicationClient client;
+		std::unordered_map<uint64_t, Entity> entities;
+		uint64_t applied = 0;
+	};
+
+	StreamWriter entityWriter(const Entity& entity)
+	{
+		return [entity](obytestream& stream)
+		{
+			Serializer serializer;
+			serializer.serialize(stream, entity.x, entity.y, entity.yaw, entity.health);
+		};
+	}
+
+	double microseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t entityCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+	int peers = argc > 2 ? std::atoi(argv[2]) : 16;
+	uint64_t changesPerTick = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000;
+	int ticks = argc > 4 ? std::atoi(argv[4]) : 100;
+	double loss = (argc > 5 ? std::atof(argv[5]) : 5) / 100;
+
+	std::mt19937 random(1);
+	std::bernoulli_distribution lost(loss);
+	std::uniform_int_distribution<uint64_t> anyEntity(1, entityCount);
+	std::uniform_real_distribution<float> step(-1.f, 1.f);
+	// Entities are destroyed now and then, and spawned again by their next change.
+	std::bernoulli_distribution destroyed(0.01);
+
+	details::ReplicationServer server;
+	std::vector<Entity> entities(entityCount + 1);
+	for (uint64_t id = 1; id <= entityCount; id++)
+	{
+		entities[id].x = static_cast<float>(id % 1000);
+		entities[id].y = static_cast<float>(id / 1000);
+		server.set(id, ENTITY_TYPE, entityWriter(entities[id]));
+	}
+	for (uint64_t id = entityCount + 1; id <= entityCount + EFFECTS; id++)
+	{
+		server.set(id, EFFECT_TYPE, [id](obytestream& stream)
+		{
+			Serializer serializer;
+			serializer.serialize(stream, std::string("explosion"), static_cast<uint32_t>(id));
+		});
+	}
+
+	std::vector<std::unique_ptr<Player>> players;
+	std::unordered_map<std::string, Player*> playersBySessionId;
+	for (int i = 0; i < peers; i++)
+	{
+		players.emplace_back(new Player());
+		auto player = players.back().get();
+		player->sessionId = "player-" + std::to_string(i);
+		player->client.subscribe(ENTITY_TYPE, [player](uint64_t id, ibytestream& stream)
+		{
+			Serializer serializer;
+			auto& entity = player->entities[id];
+			serializer.deserialize(stream, entity.x, entity.y, entity.yaw, entity.health);
+			player->applied = player->client.stats().objects;
+		}, [player](uint64_t id)
+		{
+			player->entities.erase(id);
+		});
+		playersBySessionId[player->sessionId] = player;
+		server.addPeer(player->sessionId);
+	}
+
+	uint64_t bytes = 0;
+	uint64_t messages = 0;
+	std::chrono::steady_clock::duration clientTime{ 0 };
+	bool lossy = true;
+	auto send = [&](const std::string& sessionId, const StreamWriter& writer)
+	{
+		obytestream stream;
+		writer(stream);
+		auto snapshot = stream.bytes();
+		bytes += snapshot.size();
+		messages++;
+		if (lossy && lost(random))
+		{
+			return;
+		}
+
+		auto player = playersBySessionId[sessionId];
+		auto start = std::chrono::steady_clock::now();
+		ibytestream input(snapshot.data(), static_cast<std::streamsize>(snapshot.size()));
+		std::vector<details::ReplicationClient::Change> changes;
+		auto fragment = player->client.apply(input, changes);
+		details::ReplicationClient::notify(changes);
+		clientTime += std::chrono::steady_clock::now() - start;
+		if (fragment.sequence != 0 && !(lossy && lost(random)))
+		{
+			server.ack(sessionId, fragment);
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	server.tick(send);
+	auto firstServerTime = std::chrono::steady_clock::now() - start - clientTime;
+	auto firstBytes = bytes;
+	auto firstMessages = messages;
+	bytes = 0;
+	messages = 0;
+	clientTime = std::chrono::steady_clock::duration{ 0 };
+
+	std::chrono::steady_clock::duration serverTime{ 0 };
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		for (uint64_t i = 0; i < changesPerTick; i++)
+		{
+			auto id = anyEntity(random);
+			if (destroyed(random))
+			{
+				entities[id].removed = true;
+				server.remove(id);
+				continue;
+			}
+			entities[id].removed = false;
+			entities[id].x += step(random);
+			entities[id].y += step(random);
+			entities[id].yaw += step(random) * 10;
+			server.set(id, ENTITY_TYPE, entityWriter(entities[id]));
+		}
+		auto clientTimeBefore = clientTime;
+		start = std::chrono::steady_clock::now();
+		server.tick(send);
+		serverTime += std::chrono::steady_clock::now() - start - (clientTime - clientTimeBefore);
+	}
+	auto steadyBytes = bytes;
+	auto steadyMessages = messages;
+	auto steadyClientTime = clientTime;
+
+	// Without loss, each player catches up with its next snapshot.
+	lossy = false;
+	server.tick(send);
+	server.tick(send);
+
+	bool ok = true;
+	for (auto& player : players)
+	{
+		for (uint64_t id = 1; id <= entityCount; id++)
+		{
+			auto it = player->entities.find(id);
+			auto found = it != player->entities.end();
+			if (entities[id].removed ? found : !found || it->second.x != entities[id].x || it->second.y != entities[id].y || it->second.yaw != entities[id].yaw)
+			{
+				std::printf("FAIL %s does not have the state of entity %llu\n", player->sessionId.c_str(), static_cast<unsigned long long>(id));
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	// The size of the whole state, as it would be sent every tick without deltas.
+	obytestream fullState;
+	for (uint64_t id = 1; id <= entityCount; id++)
+	{
+		if (entities[id].removed)
+		{
+			continue;
+		}
+		Serializer serializer;
+		serializer.serialize(fullState, id, std::string(ENTITY_TYPE), false);
+		entityWriter(entities[id])(fullState);
+	}
+	auto fullStateBytes = fullState.bytes().size();
+
+	std::printf("%llu entities, %d players, %llu changes per tick, %d ticks, %.1f%% loss\n", static_cast<unsigned long long>(entityCount), peers,
+		static_cast<unsigned long long>(changesPerTick), ticks, loss * 100);
+	std::printf("first snapshot:  %8.0f bytes per player in %5.1f fragments, host %8.0f us\n", static_cast<double>(firstBytes) / peers,
+		static_cast<double>(firstMessages) / peers, microseconds(firstServerTime));
+	std::printf("next snapshots:  %8.0f bytes per player per tick in %5.1f fragments (whole state: %zu bytes), host %8.0f us per tick, player %6.0f us per tick\n",
+		static_cast<double>(steadyBytes) / peers / ticks, static_cast<double>(steadyMessages) / peers / ticks, fullStateBytes,
+		microseconds(serverTime) / ticks, microseconds(steadyClientTime) / peers / ticks);
+	std::printf("%s\n", ok ? "PASS every player has the state of the host" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// Cost of dispatching the roster changes of a game session to the players, one "player.update" per player against one "players.update" batch.
+//
+// Requires the Stormancer client library headers (for IActionDispatcher):
+//   g++ -std=c++17 -O2 -pthread -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/GameSession/Tests/RosterDispatchBenchmark.cpp -L <StormancerSDK>/lib -lstormancer -o roster-dispatch-benchmark
+//   ./roster-dispatch-benchmark [rounds] [players...]
+//
+// For each session size (64 and 256 players by default), every player changes state at once: they all connect, then they all get ready,
+// as at the start of a game. The server sends these changes to each player, and each player applies them to its SessionRoster and
+// posts the events to its FrameDispatcher, as GameSession does, then its game loop pumps them.
+// Players are all alike: the benchmark runs one of them, and counts the messages sent by the server for the whole session.
+// It reports, per state change wave, the messages sent by the server, the actions posted on each player, and the CPU time of each player.
+// The messages are applied as already deserialized: the cost of receiving and deserializing each one in the client library is not included.
+// Returns 1 if a roster does not end with every player ready.
+
+#include "GameSession/SessionRoster.hpp"
+#include "Core/FrameDispatcher.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+
+using namespace Stormancer;
+using namespace Stormancer::GameSessions;
+
+namespace
+{
+	struct Player
+	{
+		GameSessions::details::SessionRoster roster;
+		FrameDispatcher dispatcher;
+		// Stand-ins of onPlayersStateChanged and onPlayerStateChanged.
+		std::function<void(const std::vector<SessionPlayerUpdate>&)> onPlayersStateChanged;
+		std::function<void(const SessionPlayer&, const std::string&)> onPlayerStateChanged;
+		uint64_t posted = 0;
+		uint64_t events = 0;
+
+		Player()
+		{
+			onPlayersStateChanged = [this](const std::vector<SessionPlayerUpdate>&) { events++; };
+			onPlayerStateChanged = [this](const SessionPlayer&, const std::string&) { events++; };
+		}
+
+		// As GameSession_Impl::raisePlayersStateChanged().
+		void raise(std::shared_ptr<const std::vector<SessionPlayerUpdate>> updated)
+		{
+			posted++;
+			dispatcher.post([this, updated]()
+			{
+				onPlayersStateChanged(*updated);
+				for (auto& update : *updated)
+				{
+					onPlayerStateChanged(update.player, update.data);
+				}
+			});
+		}
+
+		// The "player.update" route.
+		void receive(const PlayerUpdate& update)
+		{
+			auto player = roster.update(update);
+			auto updated = std::make_shared<std::vector<SessionPlayerUpdate>>();
+			updated->push_back(SessionPlayerUpdate{ player, update.data });
+			raise(std::move(updated));
+		}
+
+		// The "players.update" route.
+		void receive(const PlayerUpdateBatch& batch)
+		{
+			auto updated = std::make_shared<std::vector<SessionPlayerUpdate>>();
+			if (roster.update(batch, *updated))
+			{
+				raise(std::move(updated));
+			}
+		}
+	};
+
+	std::vector<PlayerUpdate> wave(int players, PlayerStatus status)
+	{
+		std::vector<PlayerUpdate> updates;
+		for (int i = 0; i < players; i++)
+		{
+			PlayerUpdate update;
+			update.userId = "user-" + std::to_string(i);
+			update.status = static_cast<int>(status);
+			update.isHost = i == 0;
+			update.sessionId = "session-" + std::to_string(i);
+			updates.push_back(update);
+		}
+		return updates;
+	}
+
+	struct Result
+	{
+		double microseconds = 0;
+		uint64_t posted = 0;
+		uint64_t events = 0;
+		bool ok = true;
+	};
+
+	Result run(int players, int rounds, bool batches)
+	{
+		auto connected = wave(players, PlayerStatus::Connected);
+		auto ready = wave(players, PlayerStatus::Ready);
+		Result result;
+		std::chrono::steady_clock::duration time{ 0 };
+		for (int round = 0; round < rounds; round++)
+		{
+			Player player;
+			uint64_t sequence = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (auto updates : { &connected, &ready })
+			{
+				if (batches)
+				{
+					player.receive(PlayerUpdateBatch{ ++sequence, *updates });
+				}
+				else
+				{
+					for (auto& update : *updates)
+					{
+						player.receive(update);
+					}
+				}
+				// The game loop runs the events at its next frame.
+				player.dispatcher.pump(std::chrono::seconds(1));
+			}
+			time += std::chrono::steady_clock::now() - start;
+			result.posted += player.posted;
+			result.events += player.events;
+			result.ok = result.ok && player.roster.allReady() && player.roster.players().size() == static_cast<std::size_t>(players);
+		}
+		// Two waves per round.
+		result.microseconds = std::chrono::duration<double, std::micro>(time).count() / rounds / 2;
+		result.posted /= rounds * 2;
+		result.events /= rounds * 2;
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 1000;
+	std::vector<int> sizes;
+	for (int i = 2; i < argc; i++)
+	{
+		sizes.push_back(std::atoi(argv[i]));
+	}
+	if (sizes.empty())
+	{
+		sizes = { 64, 256 };
+	}
+
+	bool ok = true;
+	std::printf("per wave of state changes     messages sent by the server   actions posted per player   events per player   CPU per player\n");
+	for (auto players : sizes)
+	{
+		for (auto batches : { false, true })
+		{
+			auto result = run(players, rounds, batches);
+			// Every player receives the changes of every player (the server does not skip the player's own).
+			auto messages = batches ? static_cast<uint64_t>(players) : static_cast<uint64_t>(players) * players;
+			std::printf("%3d players, %-15s  %27llu   %25llu   %17llu   %11.1f us\n", players, batches ? "players.update" : "player.update",
+				static_cast<unsigned long long>(messages), static_cast<unsigned long long>(result.posted), static_cast<unsigned long long>(result.events), result.microseconds);
+			if (!result.ok)
+			{
+				std::printf("FAIL the roster of %d players does not have every player ready\n", players);
+				ok = false;
+			}
+		}
+	}
+	return ok ? 0 : 1;
+}
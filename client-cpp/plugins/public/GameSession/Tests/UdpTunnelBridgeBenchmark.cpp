@@ -0,0 +1,331 @@
+// Packets-per-second benchmark of UdpTunnelBridge against a loopback UDP echo engine, compared with a bridge forwarding one datagram per system call.
+//
+// Linux only, no dependency besides the header:
+//   g++ -std=c++17 -O2 -pthread -I client-cpp/plugins/public client-cpp/plugins/public/GameSession/Tests/UdpTunnelBridgeBenchmark.cpp -o udp-bridge-benchmark
+//   ./udp-bridge-benchmark [datagrams] [datagramSize] [window] [clients]
+//
+// Each client socket sends its datagrams to the front port of the bridge, which forwards them to the echo engine on its own socket for this client.
+// The engine sends every datagram back, and the bridge forwards it to the client: both directions of the bridge are exercised, as with a game server.
+// Datagrams are sent by windows, and counted when they are back at the client. Datagrams lost by a bridge are reported, not retried.
+
+#include "GameSession/UdpTunnelBridge.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+using namespace Stormancer::GameSessions;
+
+namespace
+{
+	constexpr uint16_t FRONT_PORT = 47800;
+	constexpr uint16_t ENGINE_PORT = 47801;
+	constexpr std::size_t MAX_DATAGRAM_SIZE = 1500;
+
+	sockaddr_in loopback(uint16_t port)
+	{
+		sockaddr_in address;
+		std::memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		return address;
+	}
+
+	int openSocket(bool nonBlocking)
+	{
+		int fd = socket(AF_INET, SOCK_DGRAM | (nonBlocking ? SOCK_NONBLOCK : 0), 0);
+		int bufferSize = 8 * 1024 * 1024;
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+		return fd;
+	}
+
+	int bindSocket(uint16_t port, bool nonBlocking)
+	{
+		int fd = openSocket(nonBlocking);
+		auto address = loopback(port);
+		if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			std::perror("bind");
+			std::exit(1);
+		}
+		return fd;
+	}
+
+	// Game server stand-in: sends every datagram back to its sender, in batches, so that it is not the bottleneck.
+	class EchoEngine
+	{
+	public:
+		EchoEngine(unsigned int batchSize)
+			: _buffers(batchSize * MAX_DATAGRAM_SIZE)
+			, _iovecs(batchSize)
+			, _addresses(batchSize)
+			, _headers(batchSize)
+		{
+			_fd = bindSocket(ENGINE_PORT, true);
+			_thread = std::thread([this]()
+			{
+				while (_running)
+				{
+					pollfd fd{ _fd, POLLIN, 0 };
+					if (poll(&fd, 1, 100) <= 0)
+					{
+						continue;
+					}
+					int count;
+					while ((count = receive()) > 0)
+					{
+						for (int i = 0; i < count; i++)
+						{
+							// Sent back from the same buffers, to the address it came from.
+							_iovecs[i].iov_len = _headers[i].msg_len;
+							_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+						}
+						for (int sent = 0; sent < count;)
+						{
+							auto result = sendmmsg(_fd, _headers.data() + sent, count - sent, 0);
+							if (result <= 0)
+							{
+								break;
+							}
+							sent += result;
+						}
+					}
+				}
+			});
+		}
+
+		~EchoEngine()
+		{
+			_running = false;
+			_thread.join();
+			close(_fd);
+		}
+
+	private:
+		int receive()
+		{
+			for (std::size_t i = 0; i < _headers.size(); i++)
+			{
+				std::memset(&_headers[i], 0, sizeof(mmsghdr));
+				_iovecs[i] = iovec{ &_buffers[i * MAX_DATAGRAM_SIZE], MAX_DATAGRAM_SIZE };
+				_headers[i].msg_hdr.msg_iov = &_iovecs[i];
+				_headers[i].msg_hdr.msg_iovlen = 1;
+				_headers[i].msg_hdr.msg_name = &_addresses[i];
+				_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			}
+			return recvmmsg(_fd, _headers.data(), static_cast<unsigned int>(_headers.size()), MSG_DONTWAIT, nullptr);
+		}
+
+		std::vector<char> _buffers;
+		std::vector<iovec> _iovecs;
+		std::vector<sockaddr_in> _addresses;
+		std::vector<mmsghdr> _headers;
+		int _fd;
+		std::atomic<bool> _running{ true };
+		std::thread _thread;
+	};
+
+	// Reference: recvfrom()/sendto() for every datagram, with a socket towards the engine for each client, as a naive bridge would do.
+	class NaiveBridge
+	{
+	public:
+		NaiveBridge()
+			: _buffer(MAX_DATAGRAM_SIZE)
+		{
+			_front = bindSocket(FRONT_PORT, true);
+			_thread = std::thread([this]()
+			{
+				std::vector<pollfd> fds;
+				while (_running)
+				{
+					fds.clear();
+					fds.push_back(pollfd{ _front, POLLIN, 0 });
+					for (auto& route : _routes)
+					{
+						fds.push_back(pollfd{ route.fd, POLLIN, 0 });
+					}
+					if (poll(fds.data(), fds.size(), 100) <= 0)
+					{
+						continue;
+					}
+					sockaddr_in sender;
+					socklen_t senderSize = sizeof(sender);
+					ssize_t size;
+					while ((size = recvfrom(_front, _buffer.data(), _buffer.size(), 0, reinterpret_cast<sockaddr*>(&sender), &senderSize)) >= 0)
+					{
+						send(route(sender).fd, _buffer.data(), size, 0);
+						senderSize = sizeof(sender);
+					}
+					for (auto& route : _routes)
+					{
+						while ((size = recv(route.fd, _buffer.data(), _buffer.size(), 0)) >= 0)
+						{
+							sendto(_front, _buffer.data(), size, 0, reinterpret_cast<const sockaddr*>(&route.sender), sizeof(route.sender));
+						}
+					}
+				}
+			});
+		}
+
+		~NaiveBridge()
+		{
+			_running = false;
+			_thread.join();
+			close(_front);
+			for (auto& route : _routes)
+			{
+				close(route.fd);
+			}
+		}
+
+	private:
+		struct Route
+		{
+			sockaddr_in sender;
+			int fd;
+		};
+
+		Route& route(const sockaddr_in& sender)
+		{
+			for (auto& route : _routes)
+			{
+				if (route.sender.sin_addr.s_addr == sender.sin_addr.s_addr && route.sender.sin_port == sender.sin_port)
+				{
+					return route;
+				}
+			}
+			int fd = openSocket(true);
+			auto engine = loopback(ENGINE_PORT);
+			connect(fd, reinterpret_cast<sockaddr*>(&engine), sizeof(engine));
+			_routes.push_back(Route{ sender, fd });
+			return _routes.back();
+		}
+
+		std::vector<char> _buffer;
+		int _front;
+		// Only used by the bridge thread.
+		std::vector<Route> _routes;
+		std::atomic<bool> _running{ true };
+		std::thread _thread;
+	};
+
+	// Closed loop: every client sends a window of datagrams, then waits for them to come back before sending the next one.
+	// The window keeps every socket buffer from overflowing, so that the rate measures the forwarding cost of the bridge.
+	double run(const char* name, uint64_t datagrams, std::size_t datagramSize, unsigned int window, unsigned int clientCount, const std::function<std::shared_ptr<void>()>& startBridge)
+	{
+		EchoEngine engine(window);
+		auto bridge = startBridge();
+
+		std::vector<int> clients;
+		auto front = loopback(FRONT_PORT);
+		for (unsigned int i = 0; i < clientCount; i++)
+		{
+			int fd = openSocket(false);
+			connect(fd, reinterpret_cast<sockaddr*>(&front), sizeof(front));
+			timeval timeout{ 0, 200 * 1000 };
+			setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			clients.push_back(fd);
+		}
+
+		std::vector<char> payload(datagramSize, 'x');
+		iovec payloadVec{ payload.data(), payload.size() };
+		std::vector<mmsghdr> sendHeaders(window);
+		for (auto& header : sendHeaders)
+		{
+			std::memset(&header, 0, sizeof(header));
+			header.msg_hdr.msg_iov = &payloadVec;
+			header.msg_hdr.msg_iovlen = 1;
+		}
+		std::vector<char> buffers(window * datagramSize);
+		std::vector<iovec> receiveVecs(window);
+		std::vector<mmsghdr> receiveHeaders(window);
+		for (unsigned int i = 0; i < window; i++)
+		{
+			receiveVecs[i] = iovec{ &buffers[i * datagramSize], datagramSize };
+			std::memset(&receiveHeaders[i], 0, sizeof(mmsghdr));
+			receiveHeaders[i].msg_hdr.msg_iov = &receiveVecs[i];
+			receiveHeaders[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		uint64_t sent = 0;
+		uint64_t received = 0;
+		auto start = std::chrono::steady_clock::now();
+		while (sent < datagrams)
+		{
+			std::vector<int> pending(clients.size(), 0);
+			for (std::size_t c = 0; c < clients.size() && sent < datagrams; c++)
+			{
+				auto count = static_cast<unsigned int>(std::min<uint64_t>(window, datagrams - sent));
+				auto result = sendmmsg(clients[c], sendHeaders.data(), count, 0);
+				if (result > 0)
+				{
+					sent += result;
+					pending[c] = result;
+				}
+			}
+			for (std::size_t c = 0; c < clients.size(); c++)
+			{
+				while (pending[c] > 0)
+				{
+					// Blocks until the first datagram arrives, then returns what is already queued.
+					auto batch = recvmmsg(clients[c], receiveHeaders.data(), pending[c], MSG_WAITFORONE, nullptr);
+					if (batch <= 0)
+					{
+						// Lost in the bridge: go on with the next window.
+						break;
+					}
+					received += batch;
+					pending[c] -= batch;
+				}
+			}
+		}
+		auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bridge.reset();
+		for (auto fd : clients)
+		{
+			close(fd);
+		}
+
+		auto pps = seconds > 0 ? received / seconds : 0;
+		std::printf("%-16s %10llu/%llu datagrams echoed, %12.0f round trips/s\n", name, static_cast<unsigned long long>(received), static_cast<unsigned long long>(sent), pps);
+		return pps;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t datagrams = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::size_t datagramSize = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+	unsigned int window = argc > 3 ? static_cast<unsigned int>(std::strtoul(argv[3], nullptr, 10)) : 64;
+	unsigned int clients = argc > 4 ? static_cast<unsigned int>(std::strtoul(argv[4], nullptr, 10)) : 16;
+	datagramSize = std::min(datagramSize, MAX_DATAGRAM_SIZE);
+
+	std::printf("%llu datagrams of %zu bytes, %u clients, windows of %u datagrams per client\n", static_cast<unsigned long long>(datagrams), datagramSize, clients, window);
+	auto naive = run("recvfrom/sendto", datagrams, datagramSize, window, clients, []()
+	{
+		return std::static_pointer_cast<void>(std::make_shared<NaiveBridge>());
+	});
+
+	std::shared_ptr<UdpTunnelBridge> bridge;
+	auto batched = run("UdpTunnelBridge", datagrams, datagramSize, window, clients, [&bridge, window]()
+	{
+		bridge = std::make_shared<UdpTunnelBridge>(FRONT_PORT, "127.0.0.1", ENGINE_PORT, window, MAX_DATAGRAM_SIZE);
+		bridge->start();
+		return std::static_pointer_cast<void>(bridge);
+	});
+
+	auto stats = bridge->stats();
+	std::printf("UdpTunnelBridge: %llu to the engine, %llu back, %llu batches (%.1f datagrams per batch), %llu dropped, %llu truncated\n",
+		static_cast<unsigned long long>(stats.datagramsToTarget),
+		static_cast<unsigned long long>(stats.datagramsFromTarget),
+		static_cast<unsigned long long>(stats.batches),
+		stats.batches ? static_cast<double>(stats.datagramsToTarget + stats.datagramsFromTarget) / stats.batches : 0.0,
+		static_cast<unsigned long long>(stats.datagramsDropped),
+		static_cast<unsigned long long>(stats.datagramsTruncated));
+	std::printf("Speedup: %.2fx\n", naive > 0 ? batched / naive : 0.0);
+	return 0;
+}
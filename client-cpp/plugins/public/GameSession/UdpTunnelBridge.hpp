@@ -0,0 +1,476 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace Stormancer
+{
+	namespace GameSessions
+	{
+		/// <summary>
+		/// Counters of a running <c>UdpTunnelBridge</c>.
+		/// </summary>
+		struct UdpTunnelBridgeStats
+		{
+			/// <summary>
+			/// Datagrams forwarded from the front socket to the target.
+			/// </summary>
+			uint64_t datagramsToTarget = 0;
+			/// <summary>
+			/// Datagrams forwarded from the target back to the front socket.
+			/// </summary>
+			uint64_t datagramsFromTarget = 0;
+			/// <summary>
+			/// Number of recvmmsg() calls that returned at least one datagram.
+			/// </summary>
+			uint64_t batches = 0;
+			/// <summary>
+			/// Datagrams that could not be sent, because the send buffer stayed full or the send failed.
+			/// </summary>
+			uint64_t datagramsDropped = 0;
+			/// <summary>
+			/// Datagrams larger than the receive buffers. They are dropped instead of being forwarded truncated.
+			/// </summary>
+			uint64_t datagramsTruncated = 0;
+			/// <summary>
+			/// Routes closed because their front sender stayed idle.
+			/// </summary>
+			uint64_t routesExpired = 0;
+		};
+
+		/// <summary>
+		/// Linux UDP bridge that moves datagrams between a game engine and a game session P2P tunnel in batches, using recvmmsg()/sendmmsg().
+		/// </summary>
+		/// <remarks>
+		/// The bridge listens on a local "front" port and forwards every datagram to a "target" endpoint.
+		/// Each front sender gets its own socket towards the target, so that the target still sees one UDP peer per sender.
+		/// Typical setups:
+		/// - on the host, listen on the port the tunnel delivers to (<c>Configuration::serverGamePort</c>) and target the port the game server actually listens on;
+		/// - on a client, target the endpoint provided by <c>GameSession::onTunnelOpened</c>, and point the engine at the front port.
+		/// Receive buffers are allocated once per socket and reused for every batch.
+		/// The socket of a sender is closed when no datagram went through it, in either direction, for <c>routeIdleTimeout</c>.
+		/// </remarks>
+		class UdpTunnelBridge
+		{
+		public:
+			/// <param name="frontPort">Local port the bridge listens on.</param>
+			/// <param name="targetIp">IPv4 address datagrams are forwarded to.</param>
+			/// <param name="targetPort">Port datagrams are forwarded to.</param>
+			/// <param name="batchSize">Maximum number of datagrams moved by a single system call.</param>
+			/// <param name="maxDatagramSize">Size of each receive buffer. Larger datagrams are dropped.</param>
+			/// <param name="routeIdleTimeout">Time after which the socket dedicated to an idle front sender is closed.</param>
+			UdpTunnelBridge(uint16_t frontPort, const std::string& targetIp, uint16_t targetPort, unsigned int batchSize = 64, std::size_t maxDatagramSize = 1500, std::chrono::seconds routeIdleTimeout = std::chrono::seconds(60))
+				: _batchSize(batchSize)
+				, _maxDatagramSize(maxDatagramSize)
+				, _routeIdleTimeout(routeIdleTimeout)
+				, _front(batchSize, maxDatagramSize)
+			{
+				_out.reserve(batchSize);
+				std::memset(&_target, 0, sizeof(_target));
+				_target.sin_family = AF_INET;
+				_target.sin_port = htons(targetPort);
+				if (inet_pton(AF_INET, targetIp.c_str(), &_target.sin_addr) != 1)
+				{
+					throw std::invalid_argument("Invalid target address " + targetIp);
+				}
+
+				sockaddr_in local;
+				std::memset(&local, 0, sizeof(local));
+				local.sin_family = AF_INET;
+				// The engine and the tunnel endpoint both live on this machine.
+				local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+				local.sin_port = htons(frontPort);
+				_front.fd = openSocket();
+				if (bind(_front.fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+				{
+					close(_front.fd);
+					throw std::runtime_error("Could not bind the tunnel bridge on port " + std::to_string(frontPort));
+				}
+			}
+
+			UdpTunnelBridge(const UdpTunnelBridge&) = delete;
+			UdpTunnelBridge& operator=(const UdpTunnelBridge&) = delete;
+
+			~UdpTunnelBridge()
+			{
+				stop();
+				for (auto& route : _routes)
+				{
+					close(route.second->fd);
+				}
+				close(_front.fd);
+			}
+
+			/// <summary>
+			/// Start forwarding datagrams on a background thread.
+			/// </summary>
+			void start()
+			{
+				bool expected = false;
+				if (_running.compare_exchange_strong(expected, true))
+				{
+					_thread = std::thread([this]() { run(); });
+				}
+			}
+
+			/// <summary>
+			/// Stop forwarding datagrams. Blocks until the background thread has exited.
+			/// </summary>
+			void stop()
+			{
+				_running = false;
+				if (_thread.joinable())
+				{
+					_thread.join();
+				}
+			}
+
+			/// <summary>
+			/// Get a snapshot of the bridge counters.
+			/// </summary>
+			UdpTunnelBridgeStats stats() const
+			{
+				UdpTunnelBridgeStats stats;
+				stats.datagramsToTarget = _datagramsToTarget.load(std::memory_order_relaxed);
+				stats.datagramsFromTarget = _datagramsFromTarget.load(std::memory_order_relaxed);
+				stats.batches = _batches.load(std::memory_order_relaxed);
+				stats.datagramsDropped = _datagramsDropped.load(std::memory_order_relaxed);
+				stats.datagramsTruncated = _datagramsTruncated.load(std::memory_order_relaxed);
+				stats.routesExpired = _routesExpired.load(std::memory_order_relaxed);
+				return stats;
+			}
+
+		private:
+			// When the send buffer of a socket is full, the bridge waits up to SEND_RETRIES * SEND_RETRY_TIMEOUT_MS for it to drain before dropping the rest of the batch.
+			static constexpr int SEND_RETRIES = 3;
+			static constexpr int SEND_RETRY_TIMEOUT_MS = 1;
+			static constexpr int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+
+			// Receive side of a socket: buffers and headers are allocated once and reused for every recvmmsg() call.
+			struct BatchSocket
+			{
+				BatchSocket(unsigned int batchSize, std::size_t maxDatagramSize)
+					: buffers(batchSize * maxDatagramSize)
+					, iovecs(batchSize)
+					, addresses(batchSize)
+					, headers(batchSize)
+				{
+					for (unsigned int i = 0; i < batchSize; i++)
+					{
+						iovecs[i].iov_base = &buffers[i * maxDatagramSize];
+						iovecs[i].iov_len = maxDatagramSize;
+					}
+				}
+
+				int receive()
+				{
+					for (std::size_t i = 0; i < headers.size(); i++)
+					{
+						std::memset(&headers[i], 0, sizeof(mmsghdr));
+						headers[i].msg_hdr.msg_iov = &iovecs[i];
+						headers[i].msg_hdr.msg_iovlen = 1;
+						headers[i].msg_hdr.msg_name = &addresses[i];
+						headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+					}
+					return recvmmsg(fd, headers.data(), static_cast<unsigned int>(headers.size()), MSG_DONTWAIT, nullptr);
+				}
+
+				int fd = -1;
+				std::vector<char> buffers;
+				std::vector<iovec> iovecs;
+				std::vector<sockaddr_in> addresses;
+				std::vector<mmsghdr> headers;
+			};
+
+			// Socket towards the target dedicated to one front sender.
+			struct Route : BatchSocket
+			{
+				Route(unsigned int batchSize, std::size_t maxDatagramSize, const sockaddr_in& sender)
+					: BatchSocket(batchSize, maxDatagramSize)
+					, sender(sender)
+				{
+				}
+
+				sockaddr_in sender;
+				std::chrono::steady_clock::time_point lastActivity = std::chrono::steady_clock::now();
+			};
+
+			struct AddressLess
+			{
+				bool operator()(const sockaddr_in& a, const sockaddr_in& b) const
+				{
+					return std::tie(a.sin_addr.s_addr, a.sin_port) < std::tie(b.sin_addr.s_addr, b.sin_port);
+				}
+			};
+
+			// Returns -1 on failure.
+			static int createSocket()
+			{
+				int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+				if (fd >= 0)
+				{
+					// The default buffers only hold about 150 small datagrams: the snapshots of a tick to 16 clients, or their inputs, would overflow them.
+					// The kernel caps the size to net.core.rmem_max and net.core.wmem_max.
+					int bufferSize = SOCKET_BUFFER_SIZE;
+					setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+					setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+				}
+				return fd;
+			}
+
+			static int openSocket()
+			{
+				int fd = createSocket();
+				if (fd < 0)
+				{
+					throw std::runtime_error("Could not create a UDP socket");
+				}
+				return fd;
+			}
+
+			// Returns nullptr if no socket could be opened for this sender: its datagrams are dropped, as UDP would.
+			Route* getRoute(const sockaddr_in& sender)
+			{
+				auto it = _routes.find(sender);
+				if (it != _routes.end())
+				{
+					return it->second.get();
+				}
+
+				auto route = std::make_shared<Route>(_batchSize, _maxDatagramSize, sender);
+				route->fd = createSocket();
+				if (route->fd < 0)
+				{
+					return nullptr;
+				}
+				if (connect(route->fd, reinterpret_cast<const sockaddr*>(&_target), sizeof(_target)) != 0)
+				{
+					close(route->fd);
+					return nullptr;
+				}
+				_routes.emplace(sender, route);
+				return route.get();
+			}
+
+			// sendmmsg() stops at the first datagram it cannot send: send the rest of the batch until it is accepted or dropped.
+			void sendBatch(int fd, std::vector<mmsghdr>& headers, std::atomic<uint64_t>& sentCounter)
+			{
+				std::size_t sent = 0;
+				int retries = 0;
+				while (sent < headers.size())
+				{
+					auto result = sendmmsg(fd, headers.data() + sent, static_cast<unsigned int>(headers.size() - sent), 0);
+					if (result > 0)
+					{
+						sent += result;
+						sentCounter.fetch_add(result, std::memory_order_relaxed);
+					}
+					else if (errno == EINTR)
+					{
+						continue;
+					}
+					else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+					{
+						if (retries++ == SEND_RETRIES)
+						{
+							_datagramsDropped.fetch_add(headers.size() - sent, std::memory_order_relaxed);
+							return;
+						}
+						pollfd writable{ fd, POLLOUT, 0 };
+						poll(&writable, 1, SEND_RETRY_TIMEOUT_MS);
+					}
+					else
+					{
+						// Other errors concern a single datagram, like a pending ICMP error on the connected socket: skip it.
+						sent++;
+						_datagramsDropped.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			}
+
+			bool isTruncated(const BatchSocket& socket, int i)
+			{
+				if (socket.headers[i].msg_hdr.msg_flags & MSG_TRUNC)
+				{
+					_datagramsTruncated.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+				return false;
+			}
+
+			// Forward a front batch: consecutive datagrams from the same sender go out in one sendmmsg() call.
+			void forwardToTarget(int count)
+			{
+				auto& out = _out;
+				auto now = std::chrono::steady_clock::now();
+				int i = 0;
+				while (i < count)
+				{
+					auto sender = _front.addresses[i];
+					auto route = getRoute(sender);
+					out.clear();
+					for (; i < count && !AddressLess()(sender, _front.addresses[i]) && !AddressLess()(_front.addresses[i], sender); i++)
+					{
+						if (isTruncated(_front, i))
+						{
+							continue;
+						}
+						mmsghdr header;
+						std::memset(&header, 0, sizeof(header));
+						_front.iovecs[i].iov_len = _front.headers[i].msg_len;
+						header.msg_hdr.msg_iov = &_front.iovecs[i];
+						header.msg_hdr.msg_iovlen = 1;
+						out.push_back(header);
+					}
+					if (!route)
+					{
+						_datagramsDropped.fetch_add(out.size(), std::memory_order_relaxed);
+						continue;
+					}
+					route->lastActivity = now;
+					sendBatch(route->fd, out, _datagramsToTarget);
+				}
+				for (auto& iov : _front.iovecs)
+				{
+					iov.iov_len = _maxDatagramSize;
+				}
+			}
+
+			void forwardToFront(Route& route, int count)
+			{
+				auto& out = _out;
+				out.clear();
+				route.lastActivity = std::chrono::steady_clock::now();
+				for (int i = 0; i < count; i++)
+				{
+					if (isTruncated(route, i))
+					{
+						continue;
+					}
+					mmsghdr header;
+					std::memset(&header, 0, sizeof(header));
+					route.iovecs[i].iov_len = route.headers[i].msg_len;
+					header.msg_hdr.msg_iov = &route.iovecs[i];
+					header.msg_hdr.msg_iovlen = 1;
+					header.msg_hdr.msg_name = &route.sender;
+					header.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+					out.push_back(header);
+				}
+				sendBatch(_front.fd, out, _datagramsFromTarget);
+				for (auto& iov : route.iovecs)
+				{
+					iov.iov_len = _maxDatagramSize;
+				}
+			}
+
+			// Close the sockets of the senders that went away, for instance a client that left the session.
+			void expireRoutes()
+			{
+				auto now = std::chrono::steady_clock::now();
+				for (auto it = _routes.begin(); it != _routes.end();)
+				{
+					if (now - it->second->lastActivity > _routeIdleTimeout)
+					{
+						close(it->second->fd);
+						it = _routes.erase(it);
+						_routesExpired.fetch_add(1, std::memory_order_relaxed);
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+
+			void run()
+			{
+				std::vector<pollfd> fds;
+				std::vector<Route*> routes;
+				auto lastExpiration = std::chrono::steady_clock::now();
+				while (_running)
+				{
+					auto now = std::chrono::steady_clock::now();
+					if (now - lastExpiration > std::chrono::seconds(1))
+					{
+						lastExpiration = now;
+						expireRoutes();
+					}
+
+					fds.clear();
+					routes.clear();
+					fds.push_back(pollfd{ _front.fd, POLLIN, 0 });
+					for (auto& route : _routes)
+					{
+						fds.push_back(pollfd{ route.second->fd, POLLIN, 0 });
+						routes.push_back(route.second.get());
+					}
+
+					// The timeout only bounds how long stop() waits for the thread.
+					if (poll(fds.data(), fds.size(), 100) <= 0)
+					{
+						continue;
+					}
+
+					if (fds[0].revents & POLLIN)
+					{
+						int count;
+						while ((count = _front.receive()) > 0)
+						{
+							_batches.fetch_add(1, std::memory_order_relaxed);
+							forwardToTarget(count);
+						}
+					}
+					for (std::size_t i = 1; i < fds.size(); i++)
+					{
+						if (fds[i].revents & POLLIN)
+						{
+							int count;
+							while ((count = routes[i - 1]->receive()) > 0)
+							{
+								_batches.fetch_add(1, std::memory_order_relaxed);
+								forwardToFront(*routes[i - 1], count);
+							}
+						}
+					}
+				}
+			}
+
+			unsigned int _batchSize;
+			std::size_t _maxDatagramSize;
+			std::chrono::steady_clock::duration _routeIdleTimeout;
+			sockaddr_in _target;
+			BatchSocket _front;
+			// Send headers, reused for every sendmmsg() call.
+			std::vector<mmsghdr> _out;
+			// Only accessed by the bridge thread once started.
+			std::map<sockaddr_in, std::shared_ptr<Route>, AddressLess> _routes;
+
+			std::atomic<bool> _running{ false };
+			std::thread _thread;
+			std::atomic<uint64_t> _datagramsToTarget{ 0 };
+			std::atomic<uint64_t> _datagramsFromTarget{ 0 };
+			std::atomic<uint64_t> _batches{ 0 };
+			std::atomic<uint64_t> _datagramsDropped{ 0 };
+			std::atomic<uint64_t> _datagramsTruncated{ 0 };
+			std::atomic<uint64_t> _routesExpired{ 0 };
+		};
+	}
+}
+
+#endif
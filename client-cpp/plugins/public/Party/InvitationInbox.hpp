@@ -0,0 +1,115 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Stormancer
+{
+	namespace Party
+	{
+		namespace details
+		{
+			/// <summary>
+			/// Party invitations received by the local player, keyed by the id of their sender: a sender has at most one pending invitation.
+			/// </summary>
+			/// <remarks>
+			/// An invitation is only the scene id of the party and an expiration date: it holds no task, completion event or cancellation registration.
+			/// Expired invitations are purged when the inbox is accessed, with <c>purgeExpired()</c>.
+			/// The inbox is not thread-safe.
+			/// </remarks>
+			class InvitationInbox
+			{
+			public:
+				struct Invitation
+				{
+					std::string sceneId;
+					std::chrono::steady_clock::time_point expiration;
+				};
+
+				/// <summary>
+				/// Store an invitation, replacing the pending invitation of the same sender, if any.
+				/// </summary>
+				/// <returns>True if it replaced a pending invitation.</returns>
+				bool add(const std::string& senderId, const std::string& sceneId, std::chrono::steady_clock::time_point expiration)
+				{
+					auto it = _invitations.find(senderId);
+					if (it != _invitations.end())
+					{
+						it->second = Invitation{ sceneId, expiration };
+						return true;
+					}
+					_invitations.emplace(senderId, Invitation{ sceneId, expiration });
+					return false;
+				}
+
+				/// <summary>
+				/// Remove the invitation of a sender to a party.
+				/// </summary>
+				/// <returns>False if there is no such invitation.</returns>
+				bool remove(const std::string& senderId, const std::string& sceneId)
+				{
+					auto it = _invitations.find(senderId);
+					if (it == _invitations.end() || it->second.sceneId != sceneId)
+					{
+						return false;
+					}
+					_invitations.erase(it);
+					return true;
+				}
+
+				/// <summary>
+				/// Remove the invitations expired at <c>now</c>.
+				/// </summary>
+				/// <returns>The senders of these invitations.</returns>
+				std::vector<std::string> purgeExpired(std::chrono::steady_clock::time_point now)
+				{
+					std::vector<std::string> expired;
+					for (auto it = _invitations.begin(); it != _invitations.end();)
+					{
+						if (it->second.expiration <= now)
+						{
+							expired.push_back(it->first);
+							it = _invitations.erase(it);
+						}
+						else
+						{
+							++it;
+						}
+					}
+					return expired;
+				}
+
+				const std::unordered_map<std::string, Invitation>& invitations() const
+				{
+					return _invitations;
+				}
+
+			private:
+				std::unordered_map<std::string, Invitation> _invitations;
+			};
+		}
+	}
+}
@@ -29,6 +29,9 @@
 #include "Users/ClientAPI.hpp"
 #include "Users/Users.hpp"
 #include "GameFinder/GameFinder.hpp"
+#include "Party/InvitationInbox.hpp"
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <unordered_map>
 
@@ -70,7 +73,9 @@ namespace Stormancer
 				NotInParty,
 				PartyNotReady,
 				SettingsOutdated,
-				Unauthorized
+				Unauthorized,
+				InvitationDeclined,
+				InvitationExpired
 			};
 
 			struct Str
@@ -81,6 +86,8 @@ namespace Stormancer
 				static constexpr const char* PartyNotReady = "party.partyNotReady";
 				static constexpr const char* SettingsOutdated = "party.settingsOutdated";
 				static constexpr const char* Unauthorized = "unauthorized";
+				static constexpr const char* InvitationDeclined = "party.invitationDeclined";
+				static constexpr const char* InvitationExpired = "party.invitationExpired";
 
 				Str() = delete;
 			};
@@ -99,6 +106,10 @@ namespace Stormancer
 
 				if (std::strcmp(error, Str::Unauthorized) == 0) { return Unauthorized; }
 
+				if (std::strcmp(error, Str::InvitationDeclined) == 0) { return InvitationDeclined; }
+
+				if (std::strcmp(error, Str::InvitationExpired) == 0) { return InvitationExpired; }
+
 				return UnspecifiedError;
 			}
 
@@ -136,6 +147,13 @@ namespace Stormancer
 			/// <returns>A task that completes once the party has been joined.</returns>
 			virtual pplx::task<void> joinParty(const PartyInvitation& invitation) = 0;
 
+			/// <summary>
+			/// Decline an invitation to join a party.
+			/// </summary>
+			/// <param name="invitation">The invitation that you want to decline.</param>
+			/// <returns>A task that completes once the sender of the invitation has been notified.</returns>
+			virtual pplx::task<void> declineInvitation(const PartyInvitation& invitation) = 0;
+
 			/// <summary>
 			/// Leave the party
 			/// </summary>
@@ -266,12 +284,32 @@ namespace Stormancer
 			/// <returns>
 			/// A task that completes when the recipient has either:
 			/// - accepted the invitation
-			/// - declined the invitation
-			/// - quit the game.
+			/// - declined the invitation (the task fails with <c>PartyError::Str::InvitationDeclined</c>)
+			/// - not answered before the invitation expired (the task fails with <c>PartyError::Str::InvitationExpired</c>).
 			/// </returns>
+			/// <remarks>
+			/// The recipient acknowledges the invitation as soon as it receives it, and answers it with a separate message:
+			/// no request stays open on the server while the invitation is pending.
+			/// </remarks>
 			/// <exception cref="std::exception">If you are not in a party.</exception>
 			virtual pplx::task<void> invitePlayer(const std::string& userId, pplx::cancellation_token ct = pplx::cancellation_token::none()) = 0;
 
+			/// <summary>
+			/// Invite several players to join the party, in a single request to the server.
+			/// </summary>
+			/// <param name="userIds">The stormancer ids of the players to invite.</param>
+			/// <param name="ct">A token that can be used to cancel the invitations.</param>
+			/// <returns>
+			/// A task that completes when every recipient has accepted or declined the invitation, or let it expire.
+			/// It contains one result per recipient, in the order of <c>userIds</c>: the invitations that failed do not fail the others.
+			/// </returns>
+			/// <remarks>
+			/// Recipients that already have a pending invitation are not invited again: their result is the result of the pending invitation.
+			/// Cancelling the invitation of one of the recipients (see <c>cancelPartyInvitation()</c>) withdraws it, and completes its result immediately.
+			/// </remarks>
+			/// <exception cref="std::exception">If you are not in a party.</exception>
+			virtual pplx::task<std::vector<Users::UserRequestResult>> invitePlayers(const std::vector<std::string>& userIds, pplx::cancellation_token ct = pplx::cancellation_token::none()) = 0;
+
 			/// <summary>
 			/// Cancels an invitation to join the party
 			/// </summary>
@@ -500,10 +538,35 @@ namespace Stormancer
 
 			struct InvitationRequest
 			{
+				uint64_t id = 0;
+				// Cancels the expiration timer.
 				pplx::cancellation_token_source cts;
+				pplx::task_completion_event<void> tce;
 				pplx::task<void> task;
 			};
 
+			/// <summary>
+			/// Invitation protocol, on top of <c>UsersApi::sendRequestToUser()</c>.
+			/// </summary>
+			/// <remarks>
+			/// Each of these requests is acknowledged as soon as it is received:
+			/// the recipient of an invitation keeps it in its inbox, and answers it later with an <c>ANSWER</c> request.
+			/// </remarks>
+			struct Invitations
+			{
+				// Sender -> recipient: scene id of the party, lifetime of the invitation in seconds.
+				static constexpr const char* INVITE = "party.invite";
+				// Recipient -> sender: scene id of the party, true if the invitation is accepted.
+				static constexpr const char* ANSWER = "party.invite.answer";
+				// Sender -> recipient: scene id of the party.
+				static constexpr const char* CANCEL = "party.invite.cancel";
+
+				// How long an invitation stays pending without an answer.
+				static constexpr std::chrono::seconds LIFETIME{ 300 };
+
+				Invitations() = delete;
+			};
+
 			struct PartyState
 			{
 				PartySettingsInternal		settings;
@@ -794,14 +857,7 @@ namespace Stormancer
 								}
 								else if (state == ConnectionState::Disconnected)
 								{
-									that->_gameFinder->disconnectFromGameFinder(that->_state.settings.gameFinderName)
-										.then([](pplx::task<void> t)
-											{
-												try {
-													t.get();
-												}
-												catch (...) {}
-											});
+									that->leaveGameFinders();
 
 									MemberDisconnectionReason reason = MemberDisconnectionReason::Left;
 									if (state.reason == "party.kicked")
@@ -847,6 +903,8 @@ namespace Stormancer
 					}, _dispatcher);
 				}
 
+				// Make-before-break: the party stays connected to its current GameFinder until the new one is connected,
+				// so that it can keep matchmaking during the switch.
 				void updateGameFinder()
 				{
 					std::lock_guard<std::recursive_mutex> lg(_stateMutex);
@@ -856,67 +914,112 @@ namespace Stormancer
 						return;
 					}
 
-					// This CTS prevents multiple game finder connection requests from queuing up.
+					// Supersede the pending switch, if any. It disconnects from its GameFinder when it completes, unless it is selected again.
 					_gameFinderConnectionCts.cancel();
 					_gameFinderConnectionCts = pplx::cancellation_token_source();
 
-					// No need to wait for the old GF disconnection before connecting to the new GF
-					_gameFinder->disconnectFromGameFinder(_currentGameFinder).then([](pplx::task<void> task)
-						{
-							try { task.wait(); }
-							catch (...) {}
-						});
-
 					_currentGameFinder = _state.settings.gameFinderName;
+					if (_currentGameFinder == _connectedGameFinder)
+					{
+						_logger->log(LogLevel::Trace, "PartyService", "Back to the connected GameFinder", _currentGameFinder);
+						_gameFinderConnectionTask = pplx::task_from_result();
+						return;
+					}
+
 					if (_currentGameFinder.empty())
 					{
+						disconnectFromGameFinder(_connectedGameFinder);
+						_connectedGameFinder.clear();
+						_gameFinderConnectionTask = pplx::task_from_result();
 						return;
 					}
 
-					_logger->log(LogLevel::Trace, "PartyService", "Connecting to the party's GameFinder", _state.settings.gameFinderName);
+					_logger->log(LogLevel::Trace, "PartyService", "Connecting to the party's GameFinder", _currentGameFinder);
 
 					std::string newGameFinderName = _currentGameFinder;
 					auto token = _gameFinderConnectionCts.get_token();
+					auto switchStart = std::chrono::steady_clock::now();
 					std::weak_ptr<PartyService> wThat = this->shared_from_this();
-					_gameFinderConnectionTask = _gameFinderConnectionTask.then([wThat, newGameFinderName, token](pplx::task<void> task)
-						{
-							// I want to recover from cancellation, but not from error, since error means we're leaving the party
-							task.wait();
-
-							auto that = wThat.lock();
-							if (!that || token.is_canceled())
-							{
-								pplx::cancel_current_task();
-							}
-
-							return that->_gameFinder->connectToGameFinder(newGameFinderName);
-						}, token)
-						.then([wThat, newGameFinderName](pplx::task<void> task)
+					_gameFinderConnectionTask = _gameFinder->connectToGameFinder(newGameFinderName)
+						.then([wThat, newGameFinderName, token, switchStart](pplx::task<void> task)
 							{
 								auto that = wThat.lock();
+								if (!that)
+								{
+									task.wait();
+									return;
+								}
+
+								std::lock_guard<std::recursive_mutex> lg(that->_stateMutex);
 								try
 								{
-									auto status = task.wait();
-									if (that && status == pplx::completed)
-									{
-										that->_logger->log(LogLevel::Trace, "PartyService", "Connected to the GameFinder", newGameFinderName);
-									}
+									task.get();
 								}
 								catch (const std::exception& ex)
 								{
-									if (that)
+									if (token.is_canceled())
 									{
-										that->_logger->log(LogLevel::Error, "PartyService", "Error connecting to the GameFinder '" + newGameFinderName + "'", ex);
-										if (auto scene = that->_scene.lock())
-										{
-											std::lock_guard<std::recursive_mutex> lg(that->_stateMutex);
-											scene->disconnect().then([](pplx::task<void> t) { try { t.get(); } catch (...) {}});
-											that->_scene.reset();
-										}
+										that->_logger->log(LogLevel::Debug, "PartyService", "Error connecting to a superseded GameFinder '" + newGameFinderName + "'", ex.what());
+										pplx::cancel_current_task();
+									}
+									that->_logger->log(LogLevel::Error, "PartyService", "Error connecting to the GameFinder '" + newGameFinderName + "'", ex);
+									if (auto scene = that->_scene.lock())
+									{
+										scene->disconnect().then([](pplx::task<void> t) { try { t.get(); } catch (...) {}});
+										that->_scene.reset();
 									}
 									throw;
 								}
-							}, token);
+
+								if (token.is_canceled())
+								{
+									if (newGameFinderName != that->_currentGameFinder && newGameFinderName != that->_connectedGameFinder)
+									{
+										that->disconnectFromGameFinder(newGameFinderName);
+									}
+									pplx::cancel_current_task();
+								}
+
+								// The new GameFinder is ready: the old one can be released.
+								auto oldGameFinderName = that->_connectedGameFinder;
+								that->_connectedGameFinder = newGameFinderName;
+								if (!oldGameFinderName.empty() && oldGameFinderName != newGameFinderName)
+								{
+									that->disconnectFromGameFinder(oldGameFinderName);
+								}
+
+								auto switchLatency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - switchStart);
+								that->_logger->log(LogLevel::Info, "PartyService", "Switched GameFinder", "from='" + oldGameFinderName + "' to='" + newGameFinderName + "' latency=" + std::to_string(switchLatency.count()) + "ms");
+							});
+				}
+
+				// A pending switch is canceled: it disconnects from its GameFinder when it completes, as neither name matches it anymore.
+				void leaveGameFinders()
+				{
+					std::lock_guard<std::recursive_mutex> lg(_stateMutex);
+					_gameFinderConnectionCts.cancel();
+					_gameFinderConnectionCts = pplx::cancellation_token_source();
+					disconnectFromGameFinder(_connectedGameFinder);
+					if (_currentGameFinder != _connectedGameFinder)
+					{
+						disconnectFromGameFinder(_currentGameFinder);
+					}
+					_currentGameFinder.clear();
+					_connectedGameFinder.clear();
+					_gameFinderConnectionTask = pplx::task_from_result();
+				}
+
+				void disconnectFromGameFinder(const std::string& gameFinderName)
+				{
+					if (gameFinderName.empty())
+					{
+						return;
+					}
+					_gameFinder->disconnectFromGameFinder(gameFinderName).then([](pplx::task<void> task)
+						{
+							try { task.wait(); }
+							catch (...) {}
+						});
 				}
 
 				bool checkVersionNumber(RpcRequestContext_ptr ctx)
@@ -1260,7 +1363,10 @@ namespace Stormancer
 				}
 
 				PartyState _state;
+				// GameFinder selected by the party settings.
 				std::string _currentGameFinder;
+				// GameFinder the party is connected to. Differs from _currentGameFinder while a switch is pending.
+				std::string _connectedGameFinder;
 				std::weak_ptr<Scene> _scene;
 				std::shared_ptr<ILogger> _logger;
 				std::shared_ptr<RpcService> _rpcService;
@@ -1271,7 +1377,7 @@ namespace Stormancer
 				// Synchronize async state update, as well as getters.
 				// This is "coarse grain" synchronization, but the simplicity gains vs. multiple mutexes win against the possible performance loss imo.
 				mutable std::recursive_mutex _stateMutex;
-				// Prevent having multiple game finder connection tasks at the same time (could happen if multiple settings updates are received in a short amount of time)
+				// Connection to _currentGameFinder. Completes when the party can matchmake with it.
 				pplx::task<void> _gameFinderConnectionTask = pplx::task_from_result();
 				pplx::cancellation_token_source _gameFinderConnectionCts;
 				// Used to signal to client code when the party is ready
@@ -1326,40 +1432,139 @@ namespace Stormancer
 				{
 					std::lock_guard<std::mutex> lg(_invitationsMutex);
 
-					auto it = _pendingInvitationRequests.find(recipientId);
-					request = _pendingInvitationRequests[recipientId];
-					if (it == _pendingInvitationRequests.end())
+					return registerInvitationRequestImpl(recipientId, request);
+				}
+
+				// Registers the requests of several recipients under a single lock acquisition.
+				// newRecipientIds receives the recipients that had no pending request.
+				std::unordered_map<std::string, InvitationRequest> registerInvitationRequests(const std::vector<std::string>& recipientIds, std::vector<std::string>& newRecipientIds)
+				{
+					std::unordered_map<std::string, InvitationRequest> requests;
+					requests.reserve(recipientIds.size());
+
+					std::lock_guard<std::mutex> lg(_invitationsMutex);
+					for (auto& recipientId : recipientIds)
 					{
-						return true;
+						if (requests.find(recipientId) != requests.end())
+						{
+							continue;
+						}
+						if (registerInvitationRequestImpl(recipientId, requests[recipientId]))
+						{
+							newRecipientIds.push_back(recipientId);
+						}
 					}
-					else
+					return requests;
+				}
+
+				// Complete a pending request with the answer of its recipient.
+				void answerInvitationRequest(const std::string& recipientId, bool accepted)
+				{
+					InvitationRequest request;
+					if (removeInvitationRequest(recipientId, 0, request))
 					{
-						return false;
+						if (accepted)
+						{
+							request.tce.set();
+						}
+						else
+						{
+							request.tce.set_exception(std::runtime_error(PartyError::Str::InvitationDeclined));
+						}
 					}
 				}
 
-				void closeInvitationRequest(std::string recipientId)
+				// Fail a pending request that could not be delivered, or expired. requestId prevents failing a newer request to the same recipient.
+				void failInvitationRequest(const std::string& recipientId, uint64_t requestId, std::exception_ptr error)
 				{
-					std::lock_guard<std::mutex> lg(_invitationsMutex);
+					InvitationRequest request;
+					if (removeInvitationRequest(recipientId, requestId, request))
+					{
+						request.tce.set_exception(error);
+					}
+				}
 
-					if (_pendingInvitationRequests.find(recipientId) != _pendingInvitationRequests.end())
+				// Withdraw a pending invitation from its recipient.
+				void closeInvitationRequest(std::string recipientId)
+				{
+					InvitationRequest request;
+					if (removeInvitationRequest(recipientId, 0, request))
 					{
-						_pendingInvitationRequests[recipientId].cts.cancel();
-						_pendingInvitationRequests.erase(recipientId);
+						request.tce.set_exception(pplx::task_canceled());
+						withdrawInvitation(recipientId);
 					}
 				}
 
 				~PartyContainer()
 				{
-					std::lock_guard<std::mutex> lg(_invitationsMutex);
-
-					for (auto& request : _pendingInvitationRequests)
+					std::unordered_map<std::string, InvitationRequest> requests;
+					{
+						std::lock_guard<std::mutex> lg(_invitationsMutex);
+						requests.swap(_pendingInvitationRequests);
+					}
+					for (auto& request : requests)
 					{
 						request.second.cts.cancel();
+						request.second.tce.set_exception(pplx::task_canceled());
+						withdrawInvitation(request.first);
 					}
 				}
 
 			private:
+
+				// A requestId of 0 matches any request.
+				bool removeInvitationRequest(const std::string& recipientId, uint64_t requestId, InvitationRequest& request)
+				{
+					std::lock_guard<std::mutex> lg(_invitationsMutex);
+					auto it = _pendingInvitationRequests.find(recipientId);
+					if (it == _pendingInvitationRequests.end() || (requestId != 0 && it->second.id != requestId))
+					{
+						return false;
+					}
+					request = it->second;
+					_pendingInvitationRequests.erase(it);
+					request.cts.cancel();
+					return true;
+				}
+
+				void withdrawInvitation(const std::string& recipientId)
+				{
+					try
+					{
+						auto users = _partyScene->dependencyResolver().resolve<Stormancer::Users::UsersApi>();
+						users->sendRequestToUser<void>(recipientId, Invitations::CANCEL, pplx::cancellation_token::none(), _partyScene->id())
+							.then([](pplx::task<void> task)
+							{
+								try
+								{
+									task.get();
+								}
+								catch (...)
+								{
+									// The invitation expires on its own if the recipient can't be reached.
+								}
+							});
+					}
+					catch (...)
+					{
+					}
+				}
+
+				bool registerInvitationRequestImpl(const std::string& recipientId, InvitationRequest& request)
+				{
+					auto it = _pendingInvitationRequests.find(recipientId);
+					if (it != _pendingInvitationRequests.end())
+					{
+						request = it->second;
+						return false;
+					}
+					// The task is created here, so that concurrent invitations of the same recipient share it.
+					request.id = ++_lastInvitationRequestId;
+					request.task = pplx::create_task(request.tce);
+					_pendingInvitationRequests[recipientId] = request;
+					return true;
+				}
+
 				std::shared_ptr<Scene> _partyScene;
 				std::shared_ptr<PartyService> _partyService;
 
@@ -1368,6 +1573,7 @@ namespace Stormancer
 				Event<PartySettings>::Subscription UpdatedPartySettingsSubscription;
 
 				std::unordered_map<std::string, InvitationRequest> _pendingInvitationRequests;
+				uint64_t _lastInvitationRequestId = 0;
 				std::mutex _invitationsMutex;
 			};
 
@@ -1493,17 +1699,23 @@ namespace Stormancer
 
 				pplx::task<void> joinParty(const PartyInvitation& invitation) override
 				{
+					if (!takeInvitation(invitation))
 					{
-						std::lock_guard<std::recursive_mutex> lg(_invitationsMutex);
+						return pplx::task_from_exception<void>(std::runtime_error(PartyError::Str::InvalidInvitation));
+					}
 
-						auto it = _invitations.find(invitation.UserId);
-						if (it == _invitations.end())
+					auto logger = _logger;
+					answerInvitation(invitation, true).then([logger](pplx::task<void> task)
 						{
-							return pplx::task_from_exception<void>(std::runtime_error(PartyError::Str::InvalidInvitation));
-						}
-						it->second.tce.set();
-						_invitations.erase(it);
-					}
+							try
+							{
+								task.get();
+							}
+							catch (const std::exception& ex)
+							{
+								logger->log(LogLevel::Debug, "Party_Impl::joinParty", "Could not notify the sender that the invitation was accepted", ex);
+							}
+						});
 
 					auto wThat = this->weak_from_this();
 					return _users.lock()->getSceneConnectionToken("stormancer.plugins.party", invitation.SceneId, pplx::cancellation_token::none())
@@ -1517,6 +1729,15 @@ namespace Stormancer
 							});
 				}
 
+				pplx::task<void> declineInvitation(const PartyInvitation& invitation) override
+				{
+					if (!takeInvitation(invitation))
+					{
+						return pplx::task_from_exception<void>(std::runtime_error(PartyError::Str::InvalidInvitation));
+					}
+					return answerInvitation(invitation, false);
+				}
+
 				pplx::task<void> leaveParty() override
 				{
 					if (!_party)
@@ -1636,10 +1857,11 @@ namespace Stormancer
 					std::vector<PartyInvitation> pendingInvitations;
 					{
 						std::lock_guard<std::recursive_mutex> lg(_invitationsMutex);
+						purgeExpiredInvitations();
 
-						for (const auto& it : _invitations)
+						for (const auto& it : _invitations.invitations())
 						{
-							pendingInvitations.push_back(it.second.invite);
+							pendingInvitations.emplace_back(it.first, it.second.sceneId);
 						}
 					}
 					return pendingInvitations;
@@ -1758,17 +1980,147 @@ namespace Stormancer
 							}
 							else
 							{
-								auto requestTask = users->sendRequestToUser<void>(recipient, "party.invite", request.cts.get_token(), partyId)
-									.then([recipient, wParty]
+								// The recipient acknowledges the invitation on receipt: the request completes with its answer (see invitationAnswerHandler()).
+								auto requestId = request.id;
+								users->sendRequestToUser<void>(recipient, Invitations::INVITE, pplx::cancellation_token::none(), partyId, static_cast<int64_t>(Invitations::LIFETIME.count()))
+									.then([recipient, wParty, requestId](pplx::task<void> task)
+										{
+											try
+											{
+												task.get();
+											}
+											catch (...)
+											{
+												if (auto party = wParty.lock())
+												{
+													party->failInvitationRequest(recipient, requestId, std::current_exception());
+												}
+											}
+										});
+								expireInvitationRequest(wParty, recipient, request);
+								return request.task;
+							}
+						});
+				}
+
+				pplx::task<std::vector<Users::UserRequestResult>> invitePlayers(const std::vector<std::string>& recipients, pplx::cancellation_token ct) override
+				{
+					if (!isInParty())
+					{
+						return pplx::task_from_exception<std::vector<Users::UserRequestResult>>(std::runtime_error(PartyError::Str::NotInParty));
+					}
+
+					auto wUsers = _users;
+					return _party->then([wUsers, recipients, ct](std::shared_ptr<PartyContainer> party)
+						{
+							auto users = wUsers.lock();
+							if (!users)
+							{
+								throw PointerDeletedException("UsersApi");
+							}
+
+							std::vector<std::string> newRecipients;
+							auto requests = party->registerInvitationRequests(recipients, newRecipients);
+							std::weak_ptr<PartyContainer> wParty(party);
+
+							// Kept to be released when the batch completes, instead of living as long as the token.
+							pplx::cancellation_token_registration registration;
+							bool registered = false;
+							if (!newRecipients.empty())
+							{
+								if (ct.is_cancelable())
+								{
+									registered = true;
+									registration = ct.register_callback([newRecipients, wParty]
 										{
 											if (auto party = wParty.lock())
 											{
-												party->closeInvitationRequest(recipient);
+												for (auto& recipient : newRecipients)
+												{
+													party->closeInvitationRequest(recipient);
+												}
+											}
+										});
+								}
+
+								std::unordered_map<std::string, uint64_t> requestIds;
+								for (auto& recipient : newRecipients)
+								{
+									requestIds[recipient] = requests[recipient].id;
+									expireInvitationRequest(wParty, recipient, requests[recipient]);
+								}
+
+								// The recipients acknowledge the invitation on receipt: only the failed deliveries complete here.
+								users->sendRequestToUsers(newRecipients, Invitations::INVITE, pplx::cancellation_token::none(), party->id(), static_cast<int64_t>(Invitations::LIFETIME.count()))
+									.then([wParty, requestIds](pplx::task<std::vector<Users::UserRequestResult>> task)
+										{
+											auto party = wParty.lock();
+											if (!party)
+											{
+												return;
+											}
+											auto undelivered = requestIds;
+											try
+											{
+												for (auto& result : task.get())
+												{
+													auto it = undelivered.find(result.userId);
+													if (it == undelivered.end())
+													{
+														continue;
+													}
+													if (!result.success)
+													{
+														party->failInvitationRequest(it->first, it->second, std::make_exception_ptr(std::runtime_error(result.error)));
+													}
+													undelivered.erase(it);
+												}
+												// Recipients missing from the response are not left pending.
+												for (auto& request : undelivered)
+												{
+													party->failInvitationRequest(request.first, request.second, std::make_exception_ptr(std::runtime_error("party.invite.noResult")));
+												}
+											}
+											catch (...)
+											{
+												for (auto& request : undelivered)
+												{
+													party->failInvitationRequest(request.first, request.second, std::current_exception());
+												}
 											}
 										});
-								request.task = requestTask;
-								return requestTask;
 							}
+
+							std::vector<pplx::task<Users::UserRequestResult>> results;
+							results.reserve(recipients.size());
+							for (auto& recipient : recipients)
+							{
+								results.push_back(requests[recipient].task.then([recipient](pplx::task<void> task)
+									{
+										Users::UserRequestResult result;
+										result.userId = recipient;
+										try
+										{
+											task.get();
+											result.success = true;
+										}
+										catch (const std::exception& ex)
+										{
+											result.error = ex.what();
+										}
+										return result;
+									}));
+							}
+							auto batch = pplx::when_all(results.begin(), results.end());
+							if (!registered)
+							{
+								return batch;
+							}
+							return batch.then([ct, registration](pplx::task<std::vector<Users::UserRequestResult>> task)
+								{
+									ct.deregister_callback(registration);
+									return task.get();
+								});
 						});
 				}
 
@@ -1835,7 +2187,7 @@ namespace Stormancer
 				void initialize()
 				{
 					auto wThat = this->weak_from_this();
-					_users.lock()->setOperationHandler("party.invite", [wThat](Stormancer::Users::OperationCtx& ctx)
+					_users.lock()->setOperationHandler(Invitations::INVITE, [wThat](Stormancer::Users::OperationCtx& ctx)
 						{
 							if (auto that = wThat.lock())
 							{
@@ -1843,6 +2195,29 @@ namespace Stormancer
 							}
 							return pplx::task_from_result();
 						});
+					_users.lock()->setOperationHandler(Invitations::ANSWER, [wThat](Stormancer::Users::OperationCtx& ctx)
+						{
+							if (auto that = wThat.lock())
+							{
+								that->invitationAnswerHandler(ctx);
+							}
+							return pplx::task_from_result();
+						});
+					_users.lock()->setOperationHandler(Invitations::CANCEL, [wThat](Stormancer::Users::OperationCtx& ctx)
+						{
+							if (auto that = wThat.lock())
+							{
+								that->invitationCanceledHandler(ctx);
+							}
+							return pplx::task_from_result();
+						});
+					_subscriptions.push_back(_users.lock()->connectionStateChanged.subscribe([wThat](Stormancer::Users::GameConnectionState state)
+						{
+							if (auto that = wThat.lock())
+							{
+								that->onConnectionStateChanged(state);
+							}
+						}));
 					_subscriptions.push_back(_gameFinder->subsribeGameFinderStateChanged([wThat](GameFinder::GameFinderStatusChangedEvent evt)
 						{
 							if (auto that = wThat.lock())
@@ -1885,14 +2260,6 @@ namespace Stormancer
 
 			private:
 
-				struct InvitePair
-				{
-					PartyInvitation invite;
-					pplx::task_completion_event<void> tce;
-
-					InvitePair(PartyInvitation invite) : invite(invite) {}
-				};
-
 				// Events
 				Event<PartySettings> _onUpdatedPartySettings;
 				Event<std::vector<PartyUserDto>> _onUpdatedPartyMembers;
@@ -2024,7 +2391,11 @@ namespace Stormancer
 									if (partyManagement->isInParty())
 									{
 										partyManagement->_party = nullptr;
-										partyManagement->_onLeftParty(reason);
+										partyManagement->raise([reason, sceneId](Party_Impl& party)
+											{
+												party.onPartyLost(sceneId, reason);
+												party._onLeftParty(reason);
+											});
 									}
 								}
 							}),
@@ -2032,20 +2403,26 @@ namespace Stormancer
 							{
 								if (auto partyManagement = wPartyManagement.lock())
 								{
-									if (partyManagement->isInParty())
-									{
-										partyManagement->_onUpdatedPartyMembers(partyUsers);
-									}
+									partyManagement->raise([partyUsers](Party_Impl& party)
+										{
+											if (party.isInParty())
+											{
+												party._onUpdatedPartyMembers(partyUsers);
+											}
+										});
 								}
 							}),
 						partyService->UpdatedPartySettings.subscribe([wPartyManagement](PartySettings settings)
 							{
 								if (auto partyManagement = wPartyManagement.lock())
 								{
-									if (partyManagement->isInParty())
-									{
-										partyManagement->_onUpdatedPartySettings(settings);
-									}
+									partyManagement->raise([settings](Party_Impl& party)
+										{
+											if (party.isInParty())
+											{
+												party._onUpdatedPartySettings(settings);
+											}
+										});
 								}
 							})
 					);
@@ -2053,52 +2430,199 @@ namespace Stormancer
 					return partyService->waitForPartyReady().then([party] { return party; });
 				}
 
+				// Called on the action dispatcher when the party was left without calling leaveParty().
+				// If the connection to the server was lost meanwhile, the party is joined again once the user is authenticated again.
+				void onPartyLost(const std::string& sceneId, MemberDisconnectionReason reason)
+				{
+					auto users = _users.lock();
+					if (reason == MemberDisconnectionReason::Kicked || !users)
+					{
+						return;
+					}
+					if (_reconnecting || users->connectionState() != Stormancer::Users::GameConnectionState::Authenticated)
+					{
+						_partyToRestore = sceneId;
+					}
+				}
+
+				void onConnectionStateChanged(Stormancer::Users::GameConnectionState state)
+				{
+					if (state == Stormancer::Users::GameConnectionState::Reconnecting)
+					{
+						_reconnecting = true;
+					}
+					else if (state == Stormancer::Users::GameConnectionState::Authenticated)
+					{
+						auto sceneId = _partyToRestore;
+						auto restore = _reconnecting && !sceneId.empty() && !_party;
+						_reconnecting = false;
+						_partyToRestore.clear();
+						if (restore)
+						{
+							restoreParty(sceneId);
+						}
+					}
+					else if (state == Stormancer::Users::GameConnectionState::Disconnected)
+					{
+						_reconnecting = false;
+						_partyToRestore.clear();
+					}
+				}
+
+				void restoreParty(const std::string& sceneId)
+				{
+					auto users = _users.lock();
+					if (!users)
+					{
+						return;
+					}
+
+					auto wThat = this->weak_from_this();
+					auto logger = _logger;
+					users->getSceneConnectionToken("stormancer.plugins.party", sceneId, pplx::cancellation_token::none())
+						.then([wThat](std::string token)
+							{
+								if (auto that = wThat.lock())
+								{
+									return that->joinParty(token);
+								}
+								throw PointerDeletedException("PartyApi");
+							}, _dispatcher)
+						.then([logger, sceneId](pplx::task<void> task)
+							{
+								try
+								{
+									task.get();
+									logger->log(LogLevel::Info, "Party_Impl::restoreParty", "Joined the party again after a reconnection", sceneId);
+								}
+								catch (const std::exception& ex)
+								{
+									logger->log(LogLevel::Warn, "Party_Impl::restoreParty", "Could not join the party again after a reconnection: " + sceneId, ex);
+								}
+							});
+				}
+
+				// Events are raised on the action dispatcher, so that handlers run on the thread the application dispatches its actions to.
+				void raise(std::function<void(Party_Impl&)> raiseEvent)
+				{
+					std::weak_ptr<Party_Impl> wThat = this->shared_from_this();
+					_dispatcher->post([wThat, raiseEvent]
+						{
+							if (auto that = wThat.lock())
+							{
+								raiseEvent(*that);
+							}
+						});
+				}
+
+				// Invitations are acknowledged as soon as they are stored in the inbox. They are answered later, by joinParty() or declineInvitation().
 				pplx::task<void> invitationHandler(Stormancer::Users::OperationCtx& ctx)
 				{
 					Serializer serializer;
 					auto senderId = ctx.originId;
-					auto sceneId = serializer.deserializeOne<std::string>(ctx.request->inputStream());
+					std::string sceneId;
+					int64_t lifetime;
+					serializer.deserialize(ctx.inputStream(), sceneId, lifetime);
 					_logger->log(LogLevel::Trace, "Party_Impl::invitationHandler", "Received an invitation: sender=" + senderId + " ; sceneId=" + sceneId);
 
-					InvitePair invitation(PartyInvitation(senderId, sceneId));
+					auto expiration = std::chrono::steady_clock::now() + std::min(std::chrono::seconds(lifetime), Invitations::LIFETIME);
 					{
 						std::lock_guard<std::recursive_mutex> lg(_invitationsMutex);
-						// If we have an older invitation from the same person (it should not be possible, but with the async nature of things...), cancel it first
-						auto it = _invitations.find(senderId);
-						if (it != _invitations.end())
+						purgeExpiredInvitations();
+						// If we have an older invitation from the same person (it should not be possible, but with the async nature of things...), cancel it
+						if (_invitations.add(senderId, sceneId, expiration))
 						{
-							_logger->log(LogLevel::Trace, "Party_Impl::invitationHandler", "We already have an invite from this user, cancelling it");
-							it->second.tce.set();
-							_invitations.erase(it);
-							_onInvitationCanceled(senderId);
+							_logger->log(LogLevel::Trace, "Party_Impl::invitationHandler", "We already had an invite from this user, cancelled it");
+							raise([senderId](Party_Impl& party) { party._onInvitationCanceled(senderId); });
 						}
-						_invitations.insert({ senderId, invitation });
 					}
-					_onInvitationReceived(invitation.invite);
+					PartyInvitation invite(senderId, sceneId);
+					raise([invite](Party_Impl& party) { party._onInvitationReceived(invite); });
+					return pplx::task_from_result();
+				}
 
-					std::weak_ptr<Party_Impl> wThat(this->shared_from_this());
-					auto dispatcher = _dispatcher;
-					ctx.request->cancellationToken().register_callback([wThat, senderId, dispatcher]
+				void invitationCanceledHandler(Stormancer::Users::OperationCtx& ctx)
+				{
+					Serializer serializer;
+					auto senderId = ctx.originId;
+					auto sceneId = serializer.deserializeOne<std::string>(ctx.inputStream());
+					{
+						std::lock_guard<std::recursive_mutex> lg(_invitationsMutex);
+						if (!_invitations.remove(senderId, sceneId))
 						{
-							pplx::create_task([wThat, senderId]
+							return;
+						}
+					}
+					_logger->log(LogLevel::Trace, "Party_Impl::invitationCanceledHandler", "Sender (id=" + senderId + ") canceled an invitation");
+					raise([senderId](Party_Impl& party) { party._onInvitationCanceled(senderId); });
+				}
+
+				void invitationAnswerHandler(Stormancer::Users::OperationCtx& ctx)
+				{
+					Serializer serializer;
+					std::string sceneId;
+					bool accepted;
+					serializer.deserialize(ctx.inputStream(), sceneId, accepted);
+
+					auto party = _party;
+					if (party && party->is_done() && party->get()->id() == sceneId)
+					{
+						party->get()->answerInvitationRequest(ctx.originId, accepted);
+					}
+				}
+
+				// Must be called with _invitationsMutex held.
+				void purgeExpiredInvitations()
+				{
+					for (auto& senderId : _invitations.purgeExpired(std::chrono::steady_clock::now()))
+					{
+						raise([senderId](Party_Impl& party) { party._onInvitationCanceled(senderId); });
+					}
+				}
+
+				// Remove an invitation from the inbox, before answering it.
+				bool takeInvitation(const PartyInvitation& invitation)
+				{
+					std::lock_guard<std::recursive_mutex> lg(_invitationsMutex);
+					purgeExpiredInvitations();
+					return _invitations.remove(invitation.UserId, invitation.SceneId);
+				}
+
+				pplx::task<void> answerInvitation(const PartyInvitation& invitation, bool accepted)
+				{
+					auto users = _users.lock();
+					if (!users)
+					{
+						return pplx::task_from_exception<void>(PointerDeletedException("UsersApi"));
+					}
+					return users->sendRequestToUser<void>(invitation.UserId, Invitations::ANSWER, pplx::cancellation_token::none(), invitation.SceneId, accepted);
+				}
+
+				// Fail the request if its recipient does not answer in time. The timer is cancelled when the request completes.
+				static void expireInvitationRequest(std::weak_ptr<PartyContainer> wParty, const std::string& recipient, const InvitationRequest& request)
+				{
+					auto requestId = request.id;
+					taskDelay(Invitations::LIFETIME, request.cts.get_token())
+						.then([wParty, recipient, requestId](pplx::task<void> task)
+							{
+								try
 								{
-									if (auto that = wThat.lock())
-									{
-										that->_logger->log(LogLevel::Trace, "Party_Impl::invitationHandler", "Sender (id=" + senderId + ") canceled an invitation");
-										{
-											std::lock_guard<std::recursive_mutex> lg(that->_invitationsMutex);
-											that->_invitations.erase(senderId);
-										}
-										that->_onInvitationCanceled(senderId);
-									}
-								}, dispatcher);
-						});
-					return pplx::create_task(invitation.tce);
+									task.get();
+								}
+								catch (...)
+								{
+									return;
+								}
+								if (auto party = wParty.lock())
+								{
+									party->failInvitationRequest(recipient, requestId, std::make_exception_ptr(std::runtime_error(PartyError::Str::InvitationExpired)));
+								}
+							});
 				}
 
 				std::shared_ptr<ILogger> _logger;
 				std::shared_ptr<pplx::task<std::shared_ptr<PartyContainer>>> _party;
-				std::unordered_map<std::string, InvitePair> _invitations;
+				InvitationInbox _invitations;
 				// Recursive mutex needed because the user can call getPendingInvitations() while in a callback where the mutex is already held
 				std::recursive_mutex _invitationsMutex;
 				std::shared_ptr<IActionDispatcher> _dispatcher;
@@ -2107,6 +2631,9 @@ namespace Stormancer
 				// Things Party_Impl is subscibed to, that outlive the party scene (e.g GameFinder events)
 				std::vector<Subscription> _subscriptions;
 				pplx::task<void> _leavePartyTask = pplx::task_from_result();
+				// Party to join again once the connection to the server is restored. Only accessed on the action dispatcher.
+				std::string _partyToRestore;
+				bool _reconnecting = false;
 			};
 		}
 
@@ -2119,7 +2646,7 @@ namespace Stormancer
 			/// <remarks>
 			/// Unlike protocol versions, its only purpose is to help debugging.
 			/// </remarks>
-			static constexpr const char* PARTY_PLUGIN_REVISION = "2019-10-23.2";
+			static constexpr const char* PARTY_PLUGIN_REVISION = "2019-10-23.3";
 			static constexpr const char* PLUGIN_METADATA_KEY = "stormancer.party.plugin";
 
 		private:
@@ -0,0 +1,123 @@
+// Memory held by the party invitations a player received and did not answer yet, and cost of purging them once expired.
+//
+// Builds without the Stormancer client library:
+//   g++ -std=c++17 -O2 -I client-cpp/plugins/public client-cpp/plugins/public/Party/Tests/InvitationMemoryBenchmark.cpp -o invitation-memory-benchmark
+//   ./invitation-memory-benchmark [userIdLength] [sceneIdLength]
+//
+// For 1, 100 and 10,000 pending invitations, each from a different sender, the benchmark fills an InvitationInbox, as Party_Impl does
+// when it receives them, and reports the heap memory it holds per invitation, counted by a replaced operator new.
+// This includes the ids of the sender and of the party scene, which are not stored inline when they are longer than the small string buffer.
+// It then lets every invitation expire, and reports the time to purge them and the memory left.
+// Returns 1 if the inbox does not hold every invitation, or does not purge every one.
+
+#include "Party/InvitationInbox.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Live heap bytes. The size of each block is stored in front of it.
+	std::size_t liveBytes = 0;
+	constexpr std::size_t HEADER_SIZE = alignof(std::max_align_t);
+}
+
+void* operator new(std::size_t size)
+{
+	auto block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+	if (!block)
+	{
+		throw std::bad_alloc();
+	}
+	*reinterpret_cast<std::size_t*>(block) = size;
+	liveBytes += size;
+	return block + HEADER_SIZE;
+}
+
+void operator delete(void* p) noexcept
+{
+	if (p)
+	{
+		auto block = static_cast<char*>(p) - HEADER_SIZE;
+		liveBytes -= *reinterpret_cast<std::size_t*>(block);
+		std::free(block);
+	}
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+using namespace Stormancer::Party::details;
+
+namespace
+{
+	std::string id(const std::string& prefix, std::size_t length, std::size_t n)
+	{
+		auto number = std::to_string(n);
+		return prefix + std::string(length > prefix.size() + number.size() ? length - prefix.size() - number.size() : 0, '0') + number;
+	}
+
+	bool run(std::size_t invitations, std::size_t userIdLength, std::size_t sceneIdLength)
+	{
+		// The ids are built before the inbox is measured, as they are received in the invitation requests.
+		std::vector<std::string> senders;
+		std::vector<std::string> scenes;
+		for (std::size_t i = 0; i < invitations; i++)
+		{
+			senders.push_back(id("user-", userIdLength, i));
+			scenes.push_back(id("party-", sceneIdLength, i));
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		auto before = liveBytes;
+		std::size_t afterPurge = 0;
+		std::size_t held = 0;
+		std::size_t stored = 0;
+		std::size_t purged = 0;
+		std::chrono::steady_clock::duration purgeTime{ 0 };
+		bool ok = false;
+		{
+			InvitationInbox inbox;
+			for (std::size_t i = 0; i < invitations; i++)
+			{
+				inbox.add(senders[i], scenes[i], now + std::chrono::minutes(5));
+			}
+			held = liveBytes - before;
+			stored = inbox.invitations().size();
+
+			auto start = std::chrono::steady_clock::now();
+			purged = inbox.purgeExpired(now + std::chrono::minutes(5)).size();
+			purgeTime = std::chrono::steady_clock::now() - start;
+			afterPurge = liveBytes - before;
+			ok = stored == invitations && purged == invitations && inbox.invitations().empty();
+		}
+
+		std::printf("%6zu invitations: %7.1f bytes per invitation, purged in %8.1f us, %6zu bytes left after the purge (hash buckets)\n", invitations,
+			static_cast<double>(held) / invitations, std::chrono::duration<double, std::micro>(purgeTime).count(), afterPurge);
+		if (!ok)
+		{
+			std::printf("FAIL the inbox held %zu invitations out of %zu, and purged %zu\n", stored, invitations, purged);
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t userIdLength = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 24;
+	std::size_t sceneIdLength = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 38;
+
+	std::printf("user ids of %zu characters, party scene ids of %zu characters, sizeof(Invitation) = %zu\n", userIdLength, sceneIdLength, sizeof(InvitationInbox::Invitation));
+	bool ok = true;
+	for (std::size_t invitations : { 1, 100, 10000 })
+	{
+		ok = run(invitations, userIdLength, sceneIdLength) && ok;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include "stormancer/msgpack_define.h"
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace Stormancer
+{
+	namespace Users
+	{
+		/// <summary>
+		/// Authentication metadata or status, with the version (ETag) the server computed for it.
+		/// </summary>
+		struct CachedAuthenticationData
+		{
+			std::string eTag;
+			// False if the data did not change since the ETag sent to the server. data is then empty.
+			bool modified = false;
+			std::unordered_map<std::string, std::string> data;
+
+			MSGPACK_DEFINE(eTag, modified, data);
+		};
+
+		namespace details
+		{
+			/// <summary>
+			/// Authentication metadata and status of the last session, saved to a file to be available before the authenticator is connected.
+			/// </summary>
+			/// <remarks>
+			/// The file starts with a format version: a file written by another version is ignored, as is a truncated or corrupted one.
+			/// It is replaced atomically, so that a crash while saving leaves the previous version.
+			/// </remarks>
+			class AuthenticationCache
+			{
+			public:
+				static constexpr int VERSION = 2;
+
+				CachedAuthenticationData metadata;
+				CachedAuthenticationData status;
+				// Id of the user the status belongs to.
+				std::string statusUserId;
+				// Platform-specific local user (PlatformUserId::toString()) the status belongs to, empty without platform user.
+				std::string statusLocalUserId;
+
+				bool load(const std::string& path)
+				{
+					std::ifstream file(path, std::ios::binary);
+					std::string header;
+					int version = 0;
+					if (!(file >> header >> version) || header != HEADER || version != VERSION || file.get() != '\n')
+					{
+						return false;
+					}
+
+					AuthenticationCache cache;
+					if (!read(file, cache.metadata) || !read(file, cache.status) || !read(file, cache.statusUserId) || !read(file, cache.statusLocalUserId))
+					{
+						return false;
+					}
+					*this = cache;
+					return true;
+				}
+
+				bool save(const std::string& path) const
+				{
+					auto tempPath = path + ".tmp";
+					{
+						std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+						file << HEADER << ' ' << VERSION << '\n';
+						write(file, metadata);
+						write(file, status);
+						write(file, statusUserId);
+						write(file, statusLocalUserId);
+						if (!file.flush())
+						{
+							return false;
+						}
+					}
+					// The previous file is replaced in a single step, so that a crash leaves either the previous cache or the new one.
+#if defined(_WIN32)
+					// std::rename() fails on Windows if the file already exists.
+					return MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+					return std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+				}
+
+			private:
+				static constexpr const char* HEADER = "stormancer.users.authenticationCache";
+				// Upper bound of the strings and maps read from the file, to fail early on a corrupted file.
+				static constexpr std::size_t MAX_LENGTH = 1 << 20;
+
+				// Strings are written as <length>:<bytes>, so that they can contain any character.
+				static void write(std::ostream& stream, const std::string& value)
+				{
+					stream << value.size() << ':' << value;
+				}
+
+				static void write(std::ostream& stream, const CachedAuthenticationData& value)
+				{
+					write(stream, value.eTag);
+					stream << value.data.size() << ':';
+					for (const auto& entry : value.data)
+					{
+						write(stream, entry.first);
+						write(stream, entry.second);
+					}
+				}
+
+				static bool readLength(std::istream& stream, std::size_t& length)
+				{
+					return (stream >> length) && length <= MAX_LENGTH && stream.get() == ':';
+				}
+
+				static bool read(std::istream& stream, std::string& value)
+				{
+					std::size_t length;
+					if (!readLength(stream, length))
+					{
+						return false;
+					}
+					value.resize(length);
+					return length == 0 || stream.read(&value[0], length);
+				}
+
+				static bool read(std::istream& stream, CachedAuthenticationData& value)
+				{
+					std::size_t count;
+					if (!read(stream, value.eTag) || !readLength(stream, count))
+					{
+						return false;
+					}
+					for (std::size_t i = 0; i < count; i++)
+					{
+						std::string key;
+						std::string data;
+						if (!read(stream, key) || !read(stream, data))
+						{
+							return false;
+						}
+						value.data[key] = data;
+					}
+					return true;
+				}
+			};
+		}
+	}
+}
@@ -1,16 +1,36 @@
 #pragma once
 
 #include "stormancer/Scene.h"
+#include "stormancer/Utilities/TaskUtilities.h"
 #include  "Users/Users.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 
 namespace Stormancer
 {
+	/// <summary>
+	/// Base class of the plugin APIs that use services hosted on scenes located with <c>UsersApi::getSceneForService()</c>.
+	/// </summary>
+	/// <remarks>
+	/// <c>getService()</c> connects to a single scene per service type and name, shared by its concurrent callers.
+	/// The services it returns hold a lease on their scene: the scene is disconnected once no service obtained from it
+	/// has been alive for the idle timeout, and connected again by the next call to <c>getService()</c>.
+	/// </remarks>
 	template<typename TManager>
 	class ClientAPI : public std::enable_shared_from_this<TManager>
 	{
 	protected:
 
-		ClientAPI(std::weak_ptr<Users::UsersApi> users) : _users(users)
+		/// <param name="serviceIdleTimeout">How long a service scene stays connected once no service obtained from it is alive. <c>std::chrono::milliseconds::max()</c> keeps it connected.</param>
+		ClientAPI(std::weak_ptr<Users::UsersApi> users, std::chrono::milliseconds serviceIdleTimeout = std::chrono::seconds(60))
+			: _users(users)
+			, _serviceIdleTimeout(serviceIdleTimeout)
 		{
 		}
 
@@ -19,6 +39,13 @@ namespace Stormancer
 			return this->shared_from_this();
 		}
 
+		/// <summary>
+		/// Get a service of the scene of a service type and name, connecting to it if needed.
+		/// </summary>
+		/// <remarks>
+		/// Thread-safe. The returned service holds a lease on its scene until it is destroyed.
+		/// <c>cleanup</c> is called when the scene is disconnected, or when the connection fails (with a null scene).
+		/// </remarks>
 		template<class TService>
 		pplx::task<std::shared_ptr<TService>> getService(std::string type,
 			std::function < void(std::shared_ptr<TManager>, std::shared_ptr<TService>, std::shared_ptr<Scene>)> initializer = [](auto that, auto service, auto scene) {},
@@ -31,93 +58,236 @@ namespace Stormancer
 			{
 				return pplx::task_from_exception<std::shared_ptr<TService>>(std::runtime_error("destroyed"));
 			}
-			if (!_scene)
+
+			auto key = ServiceKey(type, name);
+			std::shared_ptr<ServiceScene> entry;
+			bool connect = false;
 			{
+				std::lock_guard<std::mutex> lg(_servicesMutex);
+				auto& slot = _services[key];
+				if (!slot)
+				{
+					slot = std::make_shared<ServiceScene>();
+					slot->scene = pplx::create_task(slot->tce);
+					connect = true;
+				}
+				entry = slot;
+				// The lease is taken right away, so that the scene can't be evicted while it is being connected.
+				entry->leases++;
+			}
+			auto lease = std::make_shared<ServiceLease>(this->shared_from_this(), key, entry);
 
+			if (connect)
+			{
+				connectScene(users, key, entry, cleanup);
+			}
 
-				_scene = std::make_shared<pplx::task<std::shared_ptr<Scene>>>(users->getSceneForService(type, name).then([wThat, cleanup](std::shared_ptr<Scene> scene) {
-					auto that = wThat.lock();
-					if (!that)
-					{
-						throw std::runtime_error("destroyed");
-					}
-					std::weak_ptr<Scene> wScene = scene;
-					that->_connectionChangedSub = scene->getConnectionStateChangedObservable().subscribe([wThat, wScene, cleanup](ConnectionState state)
-					{
-						auto that = wThat.lock();
-						if (!that)
-						{
-							throw std::runtime_error("destroyed");
-						}
+			return entry->scene.then([wThat, initializer, lease](std::shared_ptr<Scene> scene) {
 
-						if (state == ConnectionState::Disconnected || state == ConnectionState::Disconnecting)
-						{
+				auto service = scene->dependencyResolver().resolve<TService>();
+				auto that = wThat.lock();
+				if (!that)
+				{
+					throw std::runtime_error("destroyed");
+				}
+				initializer(that, service, scene);
 
-							cleanup(that, wScene.lock());
-							if (that->_connectionChangedSub.is_subscribed())
-							{
-								that->_connectionChangedSub.unsubscribe();
-							}
-							that->_scene = nullptr;
-						}
-					});
-					if (scene->getCurrentConnectionState() == ConnectionState::Disconnected || scene->getCurrentConnectionState() == ConnectionState::Disconnecting)
-					{
-						cleanup(that, scene);
-						if (that->_connectionChangedSub.is_subscribed())
-						{
-							that->_connectionChangedSub.unsubscribe();
-						}
-						that->_scene = nullptr;
-					}
-					return scene;
-				}).then([wThat, cleanup](pplx::task<std::shared_ptr<Scene>> t) {
-					try
+				lease->service = service;
+				// Shares the ownership of the lease: it is released when the last copy of the service is destroyed.
+				return std::shared_ptr<TService>(lease, service.get());
+			});
+		}
+
+	protected:
+		std::weak_ptr<Users::UsersApi> _users;
+
+	private:
+
+		using ServiceKey = std::pair<std::string, std::string>;
+
+		struct ServiceScene
+		{
+			pplx::task_completion_event<std::shared_ptr<Scene>> tce;
+			pplx::task<std::shared_ptr<Scene>> scene;
+			// Set and read under _servicesMutex: the connection state can change while it is being subscribed.
+			rxcpp::subscription connectionChangedSub;
+			// Set by the first disconnection notification of the scene, which is the only one to clean it up.
+			std::atomic<bool> disconnected{ false };
+			int leases = 0;
+			// Incremented each time the last lease is released, to tell the eviction timers apart.
+			uint64_t idleGeneration = 0;
+		};
+
+		struct ServiceLease
+		{
+			ServiceLease(std::weak_ptr<ClientAPI> api, ServiceKey key, std::shared_ptr<ServiceScene> entry)
+				: api(api)
+				, key(key)
+				, entry(entry)
+			{
+			}
+
+			~ServiceLease()
+			{
+				if (auto that = api.lock())
+				{
+					that->releaseLease(key, entry);
+				}
+			}
+
+			std::weak_ptr<ClientAPI> api;
+			ServiceKey key;
+			std::shared_ptr<ServiceScene> entry;
+			std::shared_ptr<void> service;
+		};
+
+		void connectScene(std::shared_ptr<Users::UsersApi> users, const ServiceKey& key, std::shared_ptr<ServiceScene> entry, std::function<void(std::shared_ptr<TManager>, std::shared_ptr<Scene>)> cleanup)
+		{
+			std::weak_ptr<TManager> wThat = this->shared_from_this();
+			users->getSceneForService(key.first, key.second).then([wThat, key, entry, cleanup](pplx::task<std::shared_ptr<Scene>> task) {
+
+				std::shared_ptr<Scene> scene;
+				try
+				{
+					scene = task.get();
+				}
+				catch (...)
+				{
+					if (auto that = wThat.lock())
 					{
-						return t.get();
+						that->removeService(key, entry);
+						cleanup(that, nullptr);
 					}
-					catch (std::exception&)
-					{
-						auto that = wThat.lock();
-						if (!that)
-						{
-							throw std::runtime_error("destroyed");
-						}
+					entry->tce.set_exception(std::current_exception());
+					return;
+				}
 
-						cleanup(that, nullptr);
-						if (that->_connectionChangedSub.is_subscribed())
+				auto that = wThat.lock();
+				if (!that)
+				{
+					entry->tce.set_exception(std::runtime_error("destroyed"));
+					return;
+				}
+
+				std::weak_ptr<Scene> wScene = scene;
+				auto subscription = scene->getConnectionStateChangedObservable().subscribe([wThat, wScene, key, entry, cleanup](ConnectionState state)
+				{
+					if (state == ConnectionState::Disconnected || state == ConnectionState::Disconnecting)
+					{
+						if (auto that = wThat.lock())
 						{
-							that->_connectionChangedSub.unsubscribe();
+							that->onSceneDisconnected(key, entry, wScene.lock(), cleanup);
 						}
-						that->_scene = nullptr;
-						throw;
 					}
+				});
+				{
+					std::lock_guard<std::mutex> lg(that->_servicesMutex);
+					entry->connectionChangedSub = subscription;
+				}
+				// The scene may have been disconnected, and cleaned up, before the subscription was stored.
+				if (entry->disconnected)
+				{
+					subscription.unsubscribe();
+				}
+				if (scene->getCurrentConnectionState() == ConnectionState::Disconnected || scene->getCurrentConnectionState() == ConnectionState::Disconnecting)
+				{
+					that->onSceneDisconnected(key, entry, scene, cleanup);
+				}
+				entry->tce.set(scene);
+			});
+		}
 
-				}));
-
+		void onSceneDisconnected(const ServiceKey& key, std::shared_ptr<ServiceScene> entry, std::shared_ptr<Scene> scene, std::function<void(std::shared_ptr<TManager>, std::shared_ptr<Scene>)> cleanup)
+		{
+			// Only the first notification of a scene cleans it up, even when notifications are raised concurrently.
+			if (entry->disconnected.exchange(true))
+			{
+				return;
+			}
+			// Already removed if the scene was evicted.
+			removeService(key, entry);
+			rxcpp::subscription subscription;
+			{
+				std::lock_guard<std::mutex> lg(_servicesMutex);
+				subscription = entry->connectionChangedSub;
+			}
+			if (subscription.is_subscribed())
+			{
+				subscription.unsubscribe();
 			}
+			cleanup(this->shared_from_this(), scene);
+		}
 
-			return _scene->then([wThat, initializer](std::shared_ptr<Scene> scene) {
+		// Returns false if the entry was already removed.
+		bool removeService(const ServiceKey& key, const std::shared_ptr<ServiceScene>& entry)
+		{
+			std::lock_guard<std::mutex> lg(_servicesMutex);
+			auto it = _services.find(key);
+			if (it == _services.end() || it->second != entry)
+			{
+				return false;
+			}
+			_services.erase(it);
+			return true;
+		}
 
-				auto service = scene->dependencyResolver().resolve<TService>();
-				auto that = wThat.lock();
-				if (!that)
+		void releaseLease(const ServiceKey& key, std::shared_ptr<ServiceScene> entry)
+		{
+			uint64_t generation;
+			{
+				std::lock_guard<std::mutex> lg(_servicesMutex);
+				if (--entry->leases > 0 || _serviceIdleTimeout == std::chrono::milliseconds::max())
 				{
-					throw std::runtime_error("destroyed");
+					return;
 				}
-				initializer(that, service, scene);
+				generation = ++entry->idleGeneration;
+			}
 
-				return service;
+			std::weak_ptr<ClientAPI> wThat = this->shared_from_this();
+			taskDelay(_serviceIdleTimeout).then([wThat, key, entry, generation](pplx::task<void> task) {
+				try
+				{
+					task.get();
+				}
+				catch (...)
+				{
+					return;
+				}
+				if (auto that = wThat.lock())
+				{
+					that->evictIfIdle(key, entry, generation);
+				}
 			});
 		}
-	protected:
-		std::weak_ptr<Users::UsersApi> _users;
-
-	private:
 
-		std::shared_ptr<pplx::task<std::shared_ptr<Scene>>> _scene;
+		void evictIfIdle(const ServiceKey& key, std::shared_ptr<ServiceScene> entry, uint64_t generation)
+		{
+			{
+				std::lock_guard<std::mutex> lg(_servicesMutex);
+				auto it = _services.find(key);
+				if (entry->leases > 0 || entry->idleGeneration != generation || it == _services.end() || it->second != entry || !entry->scene.is_done())
+				{
+					return;
+				}
+				// Removed before the disconnection, so that the next call to getService() connects to the scene again.
+				_services.erase(it);
+			}
+			// The disconnection runs the cleanup, through the connection state subscription.
+			entry->scene.then([](std::shared_ptr<Scene> scene) {
+				return scene->disconnect();
+			}).then([](pplx::task<void> task) {
+				try
+				{
+					task.get();
+				}
+				catch (...)
+				{
+				}
+			});
+		}
 
-		rxcpp::subscription _connectionChangedSub;
-		
+		std::chrono::milliseconds _serviceIdleTimeout;
+		std::mutex _servicesMutex;
+		std::map<ServiceKey, std::shared_ptr<ServiceScene>> _services;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,414 @@
+#pragma once
+
+// Coroutine support requires C++20: define STORMANCER_COROUTINES to enable it.
+// Without it, this header is empty and the plugins only expose their pplx::task based API.
+#if defined(STORMANCER_COROUTINES)
+
+#include "stormancer/IActionDispatcher.h"
+#include "stormancer/Tasks.h"
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace Stormancer
+{
+	/// <summary>
+	/// C++20 coroutines over the pplx::task based API of the plugins.
+	/// </summary>
+	/// <remarks>
+	/// Inside a <c>Coroutines::Task</c>, every <c>pplx::task</c> returned by the plugins (<c>UsersApi</c>, <c>GameFinderApi</c>, <c>GameSession</c>, <c>PartyApi</c>...) can be awaited directly:
+	/// <code>
+	/// Coroutines::Task&lt;GameSessionConnectionParameters&gt; play(std::shared_ptr&lt;IActionDispatcher&gt; dispatcher)
+	/// {
+	///     co_await Coroutines::resumeOn(dispatcher);
+	///     co_await users->login();
+	///     auto parameters = co_await gameSession->connectToGameSession(token, "", true);
+	///     co_await gameSession->setPlayerReady();
+	///     co_return parameters;
+	/// }
+	/// </code>
+	/// Awaiting a <c>pplx::task</c> costs a single continuation, and awaiting another <c>Coroutines::Task</c> none:
+	/// the awaited coroutine runs on the thread of its caller, and resumes it directly when it completes.
+	/// The plugins are still implemented with <c>then()</c> chains: this only saves the continuations and thread hops of the application's own call chains.
+	/// Tests/CoroutinesBenchmark.cpp compares both on the same chain.
+	/// </remarks>
+	namespace Coroutines
+	{
+		template<typename T>
+		class Task;
+
+		namespace details
+		{
+			template<typename T>
+			struct IsPplxTask : std::false_type
+			{
+			};
+
+			template<typename T>
+			struct IsPplxTask<pplx::task<T>> : std::true_type
+			{
+			};
+
+			/// <summary>
+			/// Resumes a coroutine when a pplx::task completes, on the action dispatcher if one is set, on the thread that completed the task otherwise.
+			/// </summary>
+			template<typename T>
+			struct PplxAwaiter
+			{
+				pplx::task<T> task;
+				std::shared_ptr<IActionDispatcher> dispatcher;
+
+				bool await_ready() const
+				{
+					return task.is_done() && !dispatcher;
+				}
+
+				void await_suspend(std::coroutine_handle<> handle)
+				{
+					// The coroutine can be resumed, and this awaiter destroyed, before then() returns: only use copies from here.
+					auto t = task;
+					auto resume = [handle](pplx::task<T>) { handle.resume(); };
+					if (dispatcher)
+					{
+						t.then(resume, pplx::task_options(dispatcher));
+					}
+					else
+					{
+						t.then(resume);
+					}
+				}
+
+				T await_resume()
+				{
+					return task.get();
+				}
+			};
+
+			struct ResumeOnAwaiter
+			{
+				std::shared_ptr<IActionDispatcher> dispatcher;
+
+				bool await_ready() const
+				{
+					return !dispatcher;
+				}
+
+				void await_suspend(std::coroutine_handle<> handle)
+				{
+					dispatcher->post([handle] { handle.resume(); });
+				}
+
+				void await_resume()
+				{
+				}
+			};
+
+			/// <summary>
+			/// Resumes the coroutine awaiting a completed <c>Task</c>, directly from the thread that completed it.
+			/// </summary>
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				template<typename TPromise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> handle) noexcept
+				{
+					auto continuation = handle.promise()._continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+
+				void await_resume() noexcept
+				{
+				}
+			};
+
+			class PromiseBase
+			{
+			public:
+				std::suspend_always initial_suspend() noexcept
+				{
+					return {};
+				}
+
+				FinalAwaiter final_suspend() noexcept
+				{
+					return {};
+				}
+
+				void unhandled_exception()
+				{
+					_exception = std::current_exception();
+				}
+
+				template<typename U>
+				PplxAwaiter<U> await_transform(pplx::task<U> task)
+				{
+					return PplxAwaiter<U>{ std::move(task), _dispatcher };
+				}
+
+				/// <summary>
+				/// <c>co_await resumeOn(dispatcher)</c> also makes the dispatcher the one the following awaits resume on.
+				/// </summary>
+				ResumeOnAwaiter await_transform(ResumeOnAwaiter awaiter)
+				{
+					_dispatcher = awaiter.dispatcher;
+					return awaiter;
+				}
+
+				template<typename TAwaitable>
+					requires (!IsPplxTask<std::remove_cvref_t<TAwaitable>>::value && !std::is_same_v<std::remove_cvref_t<TAwaitable>, ResumeOnAwaiter>)
+				TAwaitable&& await_transform(TAwaitable&& awaitable)
+				{
+					return std::forward<TAwaitable>(awaitable);
+				}
+
+				std::coroutine_handle<> _continuation;
+				std::shared_ptr<IActionDispatcher> _dispatcher;
+				std::exception_ptr _exception;
+			};
+
+			template<typename T>
+			class Promise : public PromiseBase
+			{
+			public:
+				Task<T> get_return_object();
+
+				template<typename U>
+				void return_value(U&& value)
+				{
+					_value.emplace(std::forward<U>(value));
+				}
+
+				T result()
+				{
+					if (_exception)
+					{
+						std::rethrow_exception(_exception);
+					}
+					return std::move(*_value);
+				}
+
+			private:
+				std::optional<T> _value;
+			};
+
+			template<>
+			class Promise<void> : public PromiseBase
+			{
+			public:
+				Task<void> get_return_object();
+
+				void return_void()
+				{
+				}
+
+				void result()
+				{
+					if (_exception)
+					{
+						std::rethrow_exception(_exception);
+					}
+				}
+			};
+
+			/// <summary>
+			/// Starts an awaited <c>Task</c> on the thread of its caller (symmetric transfer), with the dispatcher of its caller.
+			/// </summary>
+			template<typename T>
+			struct TaskAwaiter
+			{
+				std::coroutine_handle<Promise<T>> handle;
+
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				template<typename TPromise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> caller) noexcept
+				{
+					handle.promise()._continuation = caller;
+					if constexpr (std::is_base_of_v<PromiseBase, TPromise>)
+					{
+						handle.promise()._dispatcher = caller.promise()._dispatcher;
+					}
+					return handle;
+				}
+
+				T await_resume()
+				{
+					return handle.promise().result();
+				}
+			};
+
+			/// <summary>
+			/// Coroutine that runs to completion on its own and destroys itself.
+			/// </summary>
+			struct Detached
+			{
+				struct promise_type
+				{
+					Detached get_return_object()
+					{
+						return {};
+					}
+
+					std::suspend_never initial_suspend() noexcept
+					{
+						return {};
+					}
+
+					std::suspend_never final_suspend() noexcept
+					{
+						return {};
+					}
+
+					void return_void()
+					{
+					}
+
+					void unhandled_exception()
+					{
+						std::terminate();
+					}
+				};
+			};
+		}
+
+		/// <summary>
+		/// Lazily started coroutine producing a value of type T.
+		/// </summary>
+		/// <remarks>
+		/// The coroutine starts when it is awaited, or when it is converted to a <c>pplx::task</c> by <c>toPplxTask()</c>.
+		/// Awaiting it from another <c>Task</c> hands it the action dispatcher of its caller.
+		/// </remarks>
+		template<typename T>
+		class Task
+		{
+		public:
+			using promise_type = details::Promise<T>;
+
+			Task(Task&& other) noexcept
+				: _handle(std::exchange(other._handle, nullptr))
+			{
+			}
+
+			Task& operator=(Task&& other) noexcept
+			{
+				if (this != &other)
+				{
+					destroy();
+					_handle = std::exchange(other._handle, nullptr);
+				}
+				return *this;
+			}
+
+			Task(const Task&) = delete;
+			Task& operator=(const Task&) = delete;
+
+			~Task()
+			{
+				destroy();
+			}
+
+			details::TaskAwaiter<T> operator co_await() && noexcept
+			{
+				return details::TaskAwaiter<T>{ _handle };
+			}
+
+		private:
+			friend class details::Promise<T>;
+
+			explicit Task(std::coroutine_handle<promise_type> handle)
+				: _handle(handle)
+			{
+			}
+
+			void destroy()
+			{
+				if (_handle)
+				{
+					_handle.destroy();
+					_handle = nullptr;
+				}
+			}
+
+			std::coroutine_handle<promise_type> _handle;
+		};
+
+		namespace details
+		{
+			template<typename T>
+			Task<T> Promise<T>::get_return_object()
+			{
+				return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+			}
+
+			inline Task<void> Promise<void>::get_return_object()
+			{
+				return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+			}
+
+			template<typename T>
+			Detached run(Task<T> task, pplx::task_completion_event<T> tce)
+			{
+				try
+				{
+					if constexpr (std::is_void_v<T>)
+					{
+						co_await std::move(task);
+						tce.set();
+					}
+					else
+					{
+						tce.set(co_await std::move(task));
+					}
+				}
+				catch (...)
+				{
+					tce.set_exception(std::current_exception());
+				}
+			}
+		}
+
+		/// <summary>
+		/// Resume the awaiting coroutine on an action dispatcher, for instance the <c>FrameDispatcher</c> pumped by the game loop.
+		/// </summary>
+		/// <remarks>
+		/// In a <c>Task</c>, the pplx::tasks awaited afterwards resume on the same dispatcher, as do the <c>Task</c>s it awaits.
+		/// A null dispatcher resumes them on the thread that completed them, without any thread hop.
+		/// </remarks>
+		inline details::ResumeOnAwaiter resumeOn(std::shared_ptr<IActionDispatcher> dispatcher)
+		{
+			return details::ResumeOnAwaiter{ dispatcher };
+		}
+
+		/// <summary>
+		/// Await a pplx::task from a coroutine that is not a <c>Task</c>.
+		/// </summary>
+		template<typename T>
+		details::PplxAwaiter<T> awaitTask(pplx::task<T> task, std::shared_ptr<IActionDispatcher> dispatcher = nullptr)
+		{
+			return details::PplxAwaiter<T>{ std::move(task), dispatcher };
+		}
+
+		/// <summary>
+		/// Start a coroutine, and get its result as a pplx::task, for instance to implement a pplx::task based API with a coroutine.
+		/// </summary>
+		template<typename T>
+		pplx::task<T> toPplxTask(Task<T> task)
+		{
+			pplx::task_completion_event<T> tce;
+			details::run(std::move(task), tce);
+			return pplx::create_task(tce);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,166 @@
+// Stress test of ClientAPI::getService(): concurrent callers of a service share a single scene, which is cleaned up once.
+//
+// Requires the Stormancer client library, and a server application with a GameFinder, for instance the p2p sample (see server/):
+//   g++ -std=c++17 -O2 -pthread -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/Users/Tests/ClientAPIStressTest.cpp -L <StormancerSDK>/lib -lstormancer -o client-api-stress-test
+//   ./client-api-stress-test [endpoint] [account] [application] [gameFinder]
+//
+// Each round starts 1,000 getService() calls for the same service from 8 threads at once, then releases the services.
+// Every call must get the same service, and the scene must be cleaned up exactly once after the idle timeout.
+// In the last round, each service is released as soon as it is received, while the other calls are still pending.
+// Returns 1 if a check fails.
+
+#include "stormancer/IClient.h"
+#include "Users/ClientAPI.hpp"
+#include "GameFinder/GameFinder.hpp"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace Stormancer;
+
+namespace
+{
+	constexpr int CALLS = 1000;
+	constexpr int THREADS = 8;
+	constexpr int ROUNDS = 3;
+	constexpr std::chrono::milliseconds IDLE_TIMEOUT{ 500 };
+
+	using Service = GameFinder::details::GameFinderService;
+
+	class StressApi : public ClientAPI<StressApi>
+	{
+	public:
+		StressApi(std::weak_ptr<Users::UsersApi> users)
+			: ClientAPI(users, IDLE_TIMEOUT)
+		{
+		}
+
+		pplx::task<std::shared_ptr<Service>> getGameFinder(const std::string& name)
+		{
+			return this->getService<Service>("stormancer.plugins.gamefinder",
+				[](std::shared_ptr<StressApi> that, std::shared_ptr<Service>, std::shared_ptr<Scene>) { that->initialized++; },
+				[](std::shared_ptr<StressApi> that, std::shared_ptr<Scene> scene) { (scene ? that->cleanedUp : that->failedConnections)++; },
+				name);
+		}
+
+		std::atomic<int> initialized{ 0 };
+		std::atomic<int> cleanedUp{ 0 };
+		std::atomic<int> failedConnections{ 0 };
+	};
+
+	bool check(bool condition, const char* message)
+	{
+		if (!condition)
+		{
+			std::printf("FAIL %s\n", message);
+		}
+		return condition;
+	}
+
+	// Returns false if a check fails.
+	bool runRound(std::shared_ptr<StressApi> api, const std::string& gameFinder, bool releaseImmediately)
+	{
+		std::mutex tasksMutex;
+		std::vector<pplx::task<Service*>> tasks;
+		std::vector<std::thread> threads;
+		std::atomic<bool> start{ false };
+		std::mutex servicesMutex;
+		std::vector<std::shared_ptr<Service>> services;
+		for (int t = 0; t < THREADS; t++)
+		{
+			threads.emplace_back([&]()
+			{
+				while (!start)
+				{
+					std::this_thread::yield();
+				}
+				for (int i = 0; i < CALLS / THREADS; i++)
+				{
+					auto task = api->getGameFinder(gameFinder).then([&, releaseImmediately](std::shared_ptr<Service> service)
+					{
+						if (!releaseImmediately)
+						{
+							std::lock_guard<std::mutex> lg(servicesMutex);
+							services.push_back(service);
+						}
+						return service.get();
+					});
+					std::lock_guard<std::mutex> lg(tasksMutex);
+					tasks.push_back(task);
+				}
+			});
+		}
+		auto initializedBefore = api->initialized.load();
+		auto cleanedUpBefore = api->cleanedUp.load();
+		start = true;
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		bool ok = true;
+		Service* service = nullptr;
+		int failed = 0;
+		for (auto& task : tasks)
+		{
+			try
+			{
+				auto result = task.get();
+				ok = check(!service || result == service, "callers of a round got different services") && ok;
+				service = result;
+			}
+			catch (const std::exception& ex)
+			{
+				std::printf("getService() failed: %s\n", ex.what());
+				failed++;
+			}
+		}
+		ok = check(failed == 0, "getService() failed") && ok;
+		ok = check(api->initialized - initializedBefore == CALLS, "the initializer did not run once per call") && ok;
+		// Released services may already have been evicted after the idle timeout.
+		ok = check(releaseImmediately || api->cleanedUp == cleanedUpBefore, "the scene was cleaned up while leased") && ok;
+
+		services.clear();
+		auto deadline = std::chrono::steady_clock::now() + IDLE_TIMEOUT + std::chrono::seconds(5);
+		while (api->cleanedUp == cleanedUpBefore && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		// Leaves time for a second, erroneous cleanup.
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		ok = check(api->cleanedUp - cleanedUpBefore == 1, "the scene was not cleaned up exactly once") && ok;
+		std::printf("%s round (%s): %d calls, %d cleanups\n", ok ? "PASS" : "FAIL", releaseImmediately ? "immediate release" : "held", CALLS, api->cleanedUp - cleanedUpBefore);
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto config = Configuration::create(argc > 1 ? argv[1] : "http://gc3.stormancer.com:81", argc > 2 ? argv[2] : "samples", argc > 3 ? argv[3] : "p2p");
+	std::string gameFinder = argc > 4 ? argv[4] : "default";
+	config->addPlugin(new Users::UsersPlugin());
+	config->addPlugin(new GameFinder::GameFinderPlugin());
+	auto client = IClient::create(config);
+
+	auto users = client->dependencyResolver().resolve<Users::UsersApi>();
+	users->getCredentialsCallback = []()
+	{
+		Users::AuthParameters p;
+		p.type = "deviceidentifier";
+		p.parameters.emplace("deviceidentifier", "client-api-stress-test");
+		return pplx::task_from_result(p);
+	};
+	users->login().get();
+
+	auto api = std::make_shared<StressApi>(users);
+	bool ok = true;
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		ok = runRound(api, gameFinder, round == ROUNDS - 1) && ok;
+	}
+	ok = check(api->failedConnections == 0, "a scene connection failed") && ok;
+
+	users->logout().get();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// Cost of an asynchronous call chain written with Coroutines::Task, against the same chain written with pplx::task::then().
+//
+// Requires C++20 and the pplx runtime of the Stormancer client library:
+//   g++ -std=c++20 -O2 -pthread -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/Users/Tests/CoroutinesBenchmark.cpp -L <StormancerSDK>/lib -lstormancer -o coroutines-benchmark
+//   ./coroutines-benchmark [chains] [depth]
+//
+// Each chain is <depth> nested asynchronous functions, the innermost one awaiting a pplx::task completed after the chain is built,
+// as the plugins' API calls are (login, then connect, then...). The benchmark reports the time and the number of heap allocations per chain.
+//
+// Open item: this benchmark has not been run yet, as it was written without access to the pplx runtime. There are no reference numbers to compare with.
+
+#define STORMANCER_COROUTINES
+#include "Users/Coroutines.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> allocations{ 0 };
+}
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+using namespace Stormancer;
+
+namespace
+{
+	// Every level registers a continuation, scheduled on the pplx thread pool when the level below completes.
+	pplx::task<int> thenChain(int depth, pplx::task<int> leaf)
+	{
+		if (depth == 0)
+		{
+			return leaf;
+		}
+		return thenChain(depth - 1, leaf).then([](int value)
+		{
+			return value + 1;
+		});
+	}
+
+	// Only the innermost level registers a continuation: the others are resumed inline when the level below completes.
+	Coroutines::Task<int> coroutineChain(int depth, pplx::task<int> leaf)
+	{
+		if (depth == 0)
+		{
+			co_return co_await leaf;
+		}
+		co_return co_await coroutineChain(depth - 1, leaf) + 1;
+	}
+
+	struct Result
+	{
+		double microseconds;
+		double allocations;
+	};
+
+	template<typename TStart>
+	Result run(const char* name, uint64_t chains, int depth, TStart start)
+	{
+		uint64_t checksum = 0;
+		auto allocationsBefore = allocations.load();
+		auto begin = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < chains; i++)
+		{
+			pplx::task_completion_event<int> tce;
+			auto chain = start(depth, pplx::create_task(tce));
+			tce.set(0);
+			checksum += chain.get();
+		}
+		auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		Result result{ seconds * 1e6 / chains, static_cast<double>(allocations.load() - allocationsBefore) / chains };
+		if (checksum != chains * depth)
+		{
+			std::printf("%s: wrong result\n", name);
+			std::exit(1);
+		}
+		std::printf("%-16s %8.2f us/chain, %6.1f allocations/chain\n", name, result.microseconds, result.allocations);
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t chains = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	int depth = argc > 2 ? std::atoi(argv[2]) : 8;
+
+	std::printf("%llu chains of depth %d\n", static_cast<unsigned long long>(chains), depth);
+	auto then = run("pplx then()", chains, depth, [](int d, pplx::task<int> leaf)
+	{
+		return thenChain(d, leaf);
+	});
+	auto coroutines = run("Coroutines::Task", chains, depth, [](int d, pplx::task<int> leaf)
+	{
+		return Coroutines::toPplxTask(coroutineChain(d, leaf));
+	});
+	std::printf("Speedup: %.2fx, allocations: %.1f -> %.1f\n", coroutines.microseconds > 0 ? then.microseconds / coroutines.microseconds : 0.0, then.allocations, coroutines.allocations);
+	return 0;
+}
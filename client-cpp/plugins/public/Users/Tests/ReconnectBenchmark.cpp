@@ -0,0 +1,133 @@
+// Time to log in again after a restart of the game, with the resumption ticket saved by the previous run, against retrieving the credentials.
+//
+// Requires the Stormancer client library, and a server application with the Users plugin, for instance the p2p sample (see server/):
+//   g++ -std=c++17 -O2 -pthread -I <StormancerSDK>/include -I client-cpp/plugins/public client-cpp/plugins/public/Users/Tests/ReconnectBenchmark.cpp -L <StormancerSDK>/lib -lstormancer -o reconnect-benchmark
+//   ./reconnect-benchmark [endpoint] [account] [application] [rounds] [credentialsDelayMs]
+//
+// Each round runs the game three times, each time with a new client sharing the same resumptionTicketPath:
+// - a first run, without saved ticket, retrieves the credentials;
+// - a second run, with the same local user (setCurrentLocalUser()), resumes the session with the ticket saved by the first one;
+// - a third run, without local user, must not use the ticket: it can't know whether the saved ticket belongs to its user.
+// The credentials callback waits <credentialsDelayMs> before returning, as platform credential providers do (e.g. requesting an auth code).
+// The benchmark reports the login time of each run.
+// Returns 1 if the second run retrieved the credentials, or if the third run did not.
+
+#include "stormancer/IClient.h"
+#include "Users/Users.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace Stormancer;
+
+namespace
+{
+	constexpr char TICKET_PATH[] = "reconnect-benchmark.ticket";
+
+	struct BenchmarkUserId : public Users::PlatformUserId
+	{
+		BenchmarkUserId(std::string id) : PlatformUserId(id)
+		{
+		}
+
+		std::string type() const override
+		{
+			return "benchmark";
+		}
+	};
+
+	struct Run
+	{
+		double milliseconds = 0;
+		int credentialsRetrieved = 0;
+	};
+
+	Run runGame(const std::string& endpoint, const std::string& account, const std::string& application, bool withLocalUser, std::chrono::milliseconds credentialsDelay)
+	{
+		auto config = Configuration::create(endpoint, account, application);
+		config->addPlugin(new Users::UsersPlugin());
+		auto client = IClient::create(config);
+
+		auto users = client->dependencyResolver().resolve<Users::UsersApi>();
+		users->resumptionTicketPath = TICKET_PATH;
+		auto credentialsRetrieved = std::make_shared<std::atomic<int>>(0);
+		users->getCredentialsCallback = [credentialsRetrieved, credentialsDelay]()
+		{
+			(*credentialsRetrieved)++;
+			std::this_thread::sleep_for(credentialsDelay);
+			Users::AuthParameters p;
+			p.type = "deviceidentifier";
+			p.parameters.emplace("deviceidentifier", "reconnect-benchmark");
+			return pplx::task_from_result(p);
+		};
+		if (withLocalUser)
+		{
+			users->setCurrentLocalUser(std::make_shared<BenchmarkUserId>("reconnect-benchmark")).get();
+		}
+
+		Run run;
+		auto start = std::chrono::steady_clock::now();
+		users->login().get();
+		run.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		run.credentialsRetrieved = *credentialsRetrieved;
+
+		// The game exits without logging out: the session, and its ticket, stay valid for the next run.
+		client->disconnect().get();
+		return run;
+	}
+
+	void print(const char* name, std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		double sum = 0;
+		for (auto value : values)
+		{
+			sum += value;
+		}
+		std::printf("%-38s mean %7.1f ms   p50 %7.1f ms   max %7.1f ms\n", name, sum / values.size(), values[values.size() / 2], values.back());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string endpoint = argc > 1 ? argv[1] : "http://gc3.stormancer.com:81";
+	std::string account = argc > 2 ? argv[2] : "samples";
+	std::string application = argc > 3 ? argv[3] : "p2p";
+	int rounds = argc > 4 ? std::atoi(argv[4]) : 20;
+	std::chrono::milliseconds credentialsDelay(argc > 5 ? std::atoi(argv[5]) : 300);
+
+	bool ok = true;
+	std::vector<double> credentials, resumed, withoutLocalUser;
+	for (int round = 0; round < rounds; round++)
+	{
+		std::remove(TICKET_PATH);
+
+		auto first = runGame(endpoint, account, application, true, credentialsDelay);
+		auto second = runGame(endpoint, account, application, true, credentialsDelay);
+		auto third = runGame(endpoint, account, application, false, credentialsDelay);
+		credentials.push_back(first.milliseconds);
+		resumed.push_back(second.milliseconds);
+		withoutLocalUser.push_back(third.milliseconds);
+		if (second.credentialsRetrieved != 0)
+		{
+			std::printf("FAIL round %d: the run with the same local user retrieved the credentials\n", round);
+			ok = false;
+		}
+		if (third.credentialsRetrieved != 1)
+		{
+			std::printf("FAIL round %d: the run without local user used the saved ticket\n", round);
+			ok = false;
+		}
+	}
+	std::remove(TICKET_PATH);
+
+	std::printf("%d rounds, credentials retrieved in %lld ms\n", rounds, static_cast<long long>(credentialsDelay.count()));
+	print("first run (credentials)", credentials);
+	print("next run, same local user (ticket)", resumed);
+	print("next run, no local user (credentials)", withoutLocalUser);
+	return ok ? 0 : 1;
+}
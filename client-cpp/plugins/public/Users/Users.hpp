@@ -1,4 +1,5 @@
 #pragma once
+#include "Users/AuthenticationCache.hpp"
 
 #include "stormancer/IClient.h"
 #include "stormancer/Logger/ILogger.h"
@@ -8,11 +9,18 @@
 #include "stormancer/msgpack_define.h"
 #include "stormancer/DependencyInjection.h"
 #include "stormancer/Utilities/TaskUtilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <string>
 #include <unordered_map>
 #include <memory>
 #include <stdexcept>
 #include <exception>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunknown-pragmas"	// warning : unknown pragma ignored [-Wunknown-pragmas]
@@ -103,15 +111,105 @@ namespace Stormancer
 			std::string userId;
 			std::string username;
 			std::unordered_map<std::string, std::string> authentications;
+			// Single-use ticket to authenticate again after a disconnection, without retrieving the credentials.
+			std::string resumptionTicket;
 
-			MSGPACK_DEFINE(errorMsg, success, userId, username,authentications);
+			MSGPACK_DEFINE(errorMsg, success, userId, username,authentications, resumptionTicket);
 		};
 
+		/// <summary>
+		/// Outcome of a request sent to one of the recipients of <c>UsersApi::sendRequestToUsers()</c>.
+		/// </summary>
+		struct UserRequestResult
+		{
+			std::string userId;
+			bool success = false;
+			std::string error;
+
+			MSGPACK_DEFINE(userId, success, error);
+		};
+
+		/// <summary>
+		/// Request of another user, received by an operation handler (see <c>UsersApi::setOperationHandler()</c>).
+		/// </summary>
+		/// <remarks>
+		/// The request was either relayed by the server, or delivered directly by an <c>IUserRequestTransport</c>.
+		/// Use <c>inputStream()</c>, <c>cancellationToken()</c> and <c>sendValue()</c> to handle both the same way.
+		/// </remarks>
 		struct OperationCtx
 		{
 			std::string operation;
 			std::string originId;
+			/// <summary>
+			/// RPC request of the server relay. Null when the request was delivered directly.
+			/// </summary>
 			RpcRequestContext_ptr request;
+
+			/// <summary>
+			/// Packet of a request delivered directly. Its stream is positioned on the arguments of the operation.
+			/// </summary>
+			Packetisp_ptr packet;
+			/// <summary>
+			/// Cancellation of a request delivered directly.
+			/// </summary>
+			pplx::cancellation_token token = pplx::cancellation_token::none();
+			/// <summary>
+			/// Response of a request delivered directly, sent to the sender when the handler completes.
+			/// </summary>
+			std::shared_ptr<StreamWriter> response;
+
+			/// <summary>
+			/// Arguments of the operation.
+			/// </summary>
+			ibytestream& inputStream()
+			{
+				return request ? request->inputStream() : packet->stream;
+			}
+
+			pplx::cancellation_token cancellationToken() const
+			{
+				return request ? request->cancellationToken() : token;
+			}
+
+			/// <summary>
+			/// Send the result of the operation to the sender.
+			/// </summary>
+			void sendValue(const StreamWriter& streamWriter)
+			{
+				if (request)
+				{
+					request->sendValue(streamWriter);
+				}
+				else if (response)
+				{
+					*response = streamWriter;
+				}
+			}
+		};
+
+		/// <summary>
+		/// Transport delivering user-to-user requests directly to the recipient, without the server relay (e.g. through a P2P connection).
+		/// </summary>
+		/// <seealso cref="UsersApi::addRequestTransport()"/>
+		class IUserRequestTransport
+		{
+		public:
+			virtual ~IUserRequestTransport() = default;
+
+			/// <summary>
+			/// True if requests can currently be delivered to this user.
+			/// </summary>
+			virtual bool canReach(const std::string& userId) = 0;
+
+			/// <summary>
+			/// Deliver a request to the operation handler of a user.
+			/// </summary>
+			/// <param name="userId">Recipient of the request.</param>
+			/// <param name="operation">Operation of the request.</param>
+			/// <param name="streamWriter">Writes the arguments of the operation.</param>
+			/// <param name="ct">Cancels the request, on both sides.</param>
+			/// <returns>A task that completes with the values sent by the handler, when it completes. It fails if the handler fails.</returns>
+			virtual pplx::task<Packetisp_ptr> sendRequest(const std::string& userId, const std::string& operation, const StreamWriter& streamWriter, pplx::cancellation_token ct) = 0;
 		};
 
 		struct AuthParameters
@@ -181,6 +279,7 @@ namespace Stormancer
 		};
 
 		class UsersApi;
+		class UsersPlugin;
 		struct CredentialsRenewalContext
 		{
 			/// <summary>
@@ -227,7 +326,9 @@ namespace Stormancer
 			/// <remarks>
 			/// Add the elements required by your server-side authentication logic inside <c>context.authParameters</c>.
 			/// There can be multiple <c>IAuthenticationEventHandler</c> instances registered at once ;
-			/// each of their <c>retrieveCredentials()</c> method will be run sequentially, in an undefined order.
+			/// their <c>retrieveCredentials()</c> methods run concurrently, each with its own copy of the <c>AuthParameters</c>.
+			/// The changes made by each handler are then merged in registration order: when several handlers set the same parameter, the last one registered wins.
+			/// Credentials are retrieved while the client connects to the server, so handlers must not expect the client to be connected.
 			/// </remarks>
 			/// <param name="context">
 			/// An object that holds <c>AuthParameters</c> for the current authentication request.
@@ -359,9 +460,21 @@ namespace Stormancer
 				if (userId == nullptr)
 				{
 					_currentLocalUser = nullptr;
+					clearCachedStatus();
 					return logout();
 				}
 
+				if (_currentLocalUser == nullptr || *_currentLocalUser != *userId)
+				{
+					// The resumption ticket and the cached status, possibly saved by a previous run, are kept only if they belong to this user.
+					auto localUserId = userId->toString();
+					if (getResumptionTicketOwner() != localUserId)
+					{
+						setResumptionTicket("");
+					}
+					discardCachedStatusOfOtherUsers(localUserId);
+				}
+
 				if (_currentConnectionState == GameConnectionState::Disconnected || _currentConnectionState == GameConnectionState::Disconnecting)
 				{
 					_currentLocalUser = userId;
@@ -418,35 +531,13 @@ namespace Stormancer
 			/// </summary>
 			/// <remarks>
 			/// This will trigger a disconnection from every scene.
+			/// The session can't be resumed afterwards: the resumption ticket is deleted, and revoked on the server.
 			/// </remarks>
 			/// <returns>A <c>pplx::task</c> that completes when the disconnection process is done.</returns>
 			pplx::task<void> logout()
 			{
-				_autoReconnect = false;
-				if (_currentConnectionState != GameConnectionState::Disconnected && _currentConnectionState != GameConnectionState::Disconnecting)
-				{
-					this->setConnectionState(GameConnectionState::Disconnecting);
-
-					return getAuthenticationScene()
-						.then([](std::shared_ptr<Scene> scene)
-					{
-						return scene->disconnect();
-					})
-						.then([](auto t)
-					{
-						try
-						{
-							t.get();
-						}
-						catch (std::exception&)
-						{
-						}
-					});
-				}
-				else
-				{
-					return pplx::task_from_result();
-				}
+				setResumptionTicket("");
+				return disconnect(true);
 			}
 
 			pplx::task<std::string> getSceneConnectionToken(const std::string& serviceType, const std::string& serviceName, pplx::cancellation_token ct)
@@ -685,6 +776,34 @@ namespace Stormancer
 			/// \deprecated Use <c>IAuthenticationEventHandler</c> instead.
 			std::function<pplx::task<AuthParameters>()> getCredentialsCallback;
 
+			/// <summary>
+			/// File the session resumption ticket is saved to, so that the next run of the game can authenticate without retrieving the credentials.
+			/// </summary>
+			/// <remarks>
+			/// The server issues a single-use resumption ticket on each successful login.
+			/// It is always used to authenticate again after a disconnection, which restores the session without running the <c>IAuthenticationEventHandler</c>s.
+			/// If this path is set before calling <c>login()</c>, the ticket is also saved to this file, with the local user it was issued to.
+			/// The next run of the game uses it for its first login only if <c>setCurrentLocalUser()</c> was called with this user: without a local user, it always retrieves the credentials.
+			/// Anyone who can read the file can authenticate as the user until the ticket expires: only set it on platforms where the file is private to the user.
+			/// <c>setCurrentLocalUser()</c> deletes the ticket if it belongs to another user.
+			/// <c>logout()</c> deletes it.
+			/// If the ticket is rejected (e.g. expired), the credentials are retrieved as usual.
+			/// </remarks>
+			std::string resumptionTicketPath;
+
+			/// <summary>
+			/// File the authentication metadata and status are saved to, so that the next run of the game has them before the authenticator is connected.
+			/// </summary>
+			/// <remarks>
+			/// <c>getMetadata()</c> and <c>refreshAuthenticationStatus()</c> return the values they got last, without waiting for the server.
+			/// The status is only returned from the cache once the user it belongs to is logged in.
+			/// These values are checked in the background after each login, and the status also after each <c>refreshAuthenticationStatus()</c>,
+			/// by sending their version to the server, which only sends them back if they changed.
+			/// Without this path, they are only cached in memory.
+			/// Set it before the first call to <c>getMetadata()</c> or <c>refreshAuthenticationStatus()</c>.
+			/// </remarks>
+			std::string authenticationCachePath;
+
 			const std::unordered_map<std::string, std::string> currentAuthenticationStatus() const
 			{
 				return _currentStatus;
@@ -695,32 +814,84 @@ namespace Stormancer
 			/// </summary>
 			/// <remarks>
 			/// The status is a map of providerId=>userPlatformId entries.
+			/// If the status of the logged in user is cached (see <c>authenticationCachePath</c>), the task completes immediately with the cached status,
+			/// which is then checked against the server in the background: <c>currentAuthenticationStatus()</c> returns the updated status once it is.
+			/// Before the user is logged in, the status is always retrieved from the server.
 			/// </remarks>
 			pplx::task<std::unordered_map<std::string, std::string>> refreshAuthenticationStatus(pplx::cancellation_token ct = pplx::cancellation_token::none())
 			{
-				std::weak_ptr<UsersApi> wThis = this->shared_from_this();
-				return getAuthenticationScene().then([ct, wThis](std::shared_ptr<Scene> scene) {
+				std::string eTag;
+				std::unordered_map<std::string, std::string> cachedStatus;
+				{
+					std::lock_guard<std::mutex> lg(_cacheMutex);
+					loadCache();
+					if (!_cache.status.eTag.empty() && !_userId.empty() && _userId == _cache.statusUserId)
+					{
+						eTag = _cache.status.eTag;
+						cachedStatus = _cache.status.data;
+						_currentStatus = cachedStatus;
+					}
+				}
 
-					auto rpc = scene->dependencyResolver().resolve<RpcService>();
+				// The cached status is checked in the background, and must not be canceled with the caller's token.
+				auto fetchCt = eTag.empty() ? ct : pplx::cancellation_token::none();
+				std::weak_ptr<UsersApi> wThis = this->shared_from_this();
+				auto fetch = getAuthenticationScene().then([fetchCt, eTag, wThis](std::shared_ptr<Scene> scene) {
 
-					return rpc->rpc<std::unordered_map<std::string, std::string>>("Authentication.GetStatus", ct).then([wThis](std::unordered_map<std::string, std::string> status) {
+					auto that = wThis.lock();
+					if (!that)
+					{
+						throw PointerDeletedException("UsersApi");
+					}
+					return that->fetchStatus(scene, eTag, fetchCt);
+				});
+				if (eTag.empty())
+				{
+					return fetch;
+				}
 
-						if (auto that = wThis.lock())
-						{
-							that->_currentStatus = status;
-						}
-						return status;
-					});
+				auto logger = _logger;
+				fetch.then([logger](pplx::task<std::unordered_map<std::string, std::string>> task)
+				{
+					try
+					{
+						task.get();
+					}
+					catch (const std::exception& ex)
+					{
+						logger->log(LogLevel::Debug, "UsersApi", "Could not check the cached authentication status", ex);
+					}
 				});
+				return pplx::task_from_result(cachedStatus);
 			}
 
-			//Get the metadata for the authentication system, advertising what kind of authentication is available and which parameters it supports.
+			/// <summary>
+			/// Get the metadata for the authentication system, advertising what kind of authentication is available and which parameters it supports.
+			/// </summary>
+			/// <remarks>
+			/// If the metadata is cached (see <c>authenticationCachePath</c>), the task completes immediately with the cached metadata,
+			/// which is checked against the server after each login.
+			/// </remarks>
 			pplx::task<std::unordered_map<std::string, std::string>> getMetadata(pplx::cancellation_token ct = pplx::cancellation_token::none())
 			{
-				return getAuthenticationScene().then([ct](std::shared_ptr<Scene> scene) {
+				{
+					std::lock_guard<std::mutex> lg(_cacheMutex);
+					loadCache();
+					if (!_cache.metadata.eTag.empty())
+					{
+						return pplx::task_from_result(_cache.metadata.data);
+					}
+				}
 
-					auto rpc = scene->dependencyResolver().resolve<RpcService>();
-					return rpc->rpc<std::unordered_map<std::string, std::string>>("Authentication.GetMetadata", ct);
+				std::weak_ptr<UsersApi> wThis = this->shared_from_this();
+				return getAuthenticationScene().then([ct, wThis](std::shared_ptr<Scene> scene) {
+
+					auto that = wThis.lock();
+					if (!that)
+					{
+						throw PointerDeletedException("UsersApi");
+					}
+					return that->fetchMetadata(scene, "", ct);
 				});
 			}
 
@@ -744,6 +915,7 @@ namespace Stormancer
 					if (r.success)
 					{
 						that->_currentStatus = r.authentications;
+						that->clearCachedStatus();
 					}
 					else
 					{
@@ -771,17 +943,54 @@ namespace Stormancer
 			//Unlink the authenticated user from auth provided by the specified provider
 			pplx::task<void> unlink(std::string type, pplx::cancellation_token ct = pplx::cancellation_token::none())
 			{
+				std::weak_ptr<UsersApi> wThat = this->shared_from_this();
 				return getAuthenticationScene().then([ct, type](std::shared_ptr<Scene> scene) {
 
 					auto rpc = scene->dependencyResolver().resolve<RpcService>();
 					return rpc->rpc<void>("Authentication.Unlink", ct, type);
 
+				}).then([wThat] {
+
+					if (auto that = wThat.lock())
+					{
+						that->clearCachedStatus();
+					}
 				});
 			}
 
+			/// <summary>
+			/// Send a request to the operation handler of another user.
+			/// </summary>
+			/// <remarks>
+			/// The request is delivered directly when a registered <c>IUserRequestTransport</c> can reach the user (e.g. both users are connected to the same game session),
+			/// and relayed by the server otherwise.
+			/// </remarks>
 			template<typename TResult, typename... TArgs >
 			pplx::task<TResult> sendRequestToUser(const std::string& userId, const std::string& operation, pplx::cancellation_token ct, const TArgs&... args)
 			{
+				if (auto transport = getRequestTransport(userId))
+				{
+					StreamWriter streamWriter = [args...](obytestream& stream)
+					{
+						Serializer serializer;
+						(serializer.serialize(stream, args), ...);
+					};
+					return transport->sendRequest(userId, operation, streamWriter, ct)
+						.then([](Packetisp_ptr packet) -> TResult
+					{
+						if constexpr (std::is_void<TResult>::value)
+						{
+							(void)packet;
+							return;
+						}
+						else
+						{
+							Serializer serializer;
+							return serializer.deserializeOne<TResult>(packet->stream);
+						}
+					});
+				}
+
 				return getAuthenticationScene().then([ct, userId, operation, args...](std::shared_ptr<Scene> scene)
 				{
 					auto rpc = scene->dependencyResolver().resolve<RpcService>();
@@ -789,11 +998,57 @@ namespace Stormancer
 				});
 			}
 
+			/// <summary>
+			/// Send the same request to several users, in a single call to the server.
+			/// </summary>
+			/// <remarks>
+			/// Requests are processed concurrently by the recipients. The task completes when every recipient has answered,
+			/// with one result per recipient: a recipient that fails does not fail the others.
+			/// The server rejects batches of more than 100 distinct recipients.
+			/// </remarks>
+			template<typename... TArgs>
+			pplx::task<std::vector<UserRequestResult>> sendRequestToUsers(const std::vector<std::string>& userIds, const std::string& operation, pplx::cancellation_token ct, const TArgs&... args)
+			{
+				return getAuthenticationScene().then([ct, userIds, operation, args...](std::shared_ptr<Scene> scene)
+				{
+					auto rpc = scene->dependencyResolver().resolve<RpcService>();
+					return rpc->rpc<std::vector<UserRequestResult>>("sendRequests", ct, userIds, operation, args...);
+				});
+			}
+
 			void setOperationHandler(std::string operation, std::function<pplx::task<void>(OperationCtx&)> handler)
 			{
 				_operationHandlers[operation] = handler;
 			}
 
+			/// <summary>
+			/// Register a transport that can deliver user requests without the server relay.
+			/// </summary>
+			void addRequestTransport(std::shared_ptr<IUserRequestTransport> transport)
+			{
+				std::lock_guard<std::mutex> lg(_requestTransportsMutex);
+				_requestTransports.push_back(transport);
+			}
+
+			void removeRequestTransport(std::shared_ptr<IUserRequestTransport> transport)
+			{
+				std::lock_guard<std::mutex> lg(_requestTransportsMutex);
+				_requestTransports.erase(std::remove(_requestTransports.begin(), _requestTransports.end(), transport), _requestTransports.end());
+			}
+
+			/// <summary>
+			/// Run the operation handler of a request delivered by an <c>IUserRequestTransport</c>.
+			/// </summary>
+			pplx::task<void> handleDirectRequest(OperationCtx& ctx)
+			{
+				auto it = _operationHandlers.find(ctx.operation);
+				if (it == _operationHandlers.end())
+				{
+					return pplx::task_from_exception<void>(std::runtime_error("operation.notfound"));
+				}
+				return it->second(ctx);
+			}
+
 			pplx::task<void> registerNewUser(std::string type, std::unordered_map<std::string, std::string> data)
 			{
 				auto ctx = AuthParameters();
@@ -811,12 +1066,72 @@ namespace Stormancer
 #pragma endregion
 
 		private:
+			friend class UsersPlugin;
 
 			std::unordered_map<std::string, std::string> _currentStatus;
 			static constexpr int RETRY_COUNTER_MAX = 100;
 
 #pragma region private_methods
 
+			// When the client shuts down, the session is not ended: the next run of the game can resume it with its ticket.
+			pplx::task<void> disconnect(bool endSession)
+			{
+				_autoReconnect = false;
+				if (_currentConnectionState != GameConnectionState::Disconnected && _currentConnectionState != GameConnectionState::Disconnecting)
+				{
+					this->setConnectionState(GameConnectionState::Disconnecting);
+
+					return getAuthenticationScene()
+						.then([endSession](std::shared_ptr<Scene> scene)
+					{
+						if (!endSession)
+						{
+							return scene->disconnect();
+						}
+						auto rpcService = scene->dependencyResolver().resolve<RpcService>();
+						return rpcService->rpc<void>("Authentication.RevokeResumptionTickets").then([scene](pplx::task<void> t)
+						{
+							try
+							{
+								t.get();
+							}
+							catch (std::exception&)
+							{
+								// The ticket expires on the server anyway.
+							}
+							return scene->disconnect();
+						});
+					})
+						.then([](auto t)
+					{
+						try
+						{
+							t.get();
+						}
+						catch (std::exception&)
+						{
+						}
+					});
+				}
+				else
+				{
+					return pplx::task_from_result();
+				}
+			}
+
+			std::shared_ptr<IUserRequestTransport> getRequestTransport(const std::string& userId)
+			{
+				std::lock_guard<std::mutex> lg(_requestTransportsMutex);
+				for (auto& transport : _requestTransports)
+				{
+					if (transport->canReach(userId))
+					{
+						return transport;
+					}
+				}
+				return nullptr;
+			}
+
 			void setConnectionState(GameConnectionState state)
 			{
 				if (_currentConnectionState != state)
@@ -829,6 +1144,8 @@ namespace Stormancer
 						_authTask = nullptr;
 						if (state.reason == "User connected elsewhere" || state.reason == "Authentication failed" || state.reason == "auth.login.new_connection")
 						{
+							// The session was ended by the server: resuming it would fail, or log out the other connection.
+							setResumptionTicket("");
 							_autoReconnect = false;
 							if (auto client = _client.lock())
 							{
@@ -842,13 +1159,13 @@ namespace Stormancer
 						else
 						{
 							_currentConnectionState = state;
-							connectionStateChanged(state);
+							raiseConnectionStateChanged(state);
 						}
 					}
 					else if (state == GameConnectionState::Reconnecting && _currentConnectionState != GameConnectionState::Reconnecting)
 					{
 						_currentConnectionState = state;
-						connectionStateChanged(state);
+						raiseConnectionStateChanged(state);
 						auto logger = _logger;
 						this->getAuthenticationScene()
 							.then([logger](pplx::task<std::shared_ptr<Scene>> t)
@@ -866,11 +1183,46 @@ namespace Stormancer
 					else
 					{
 						_currentConnectionState = state;
-						connectionStateChanged(state);
+						raiseConnectionStateChanged(state);
 					}
 				}
 			}
 
+			// Raised on the action dispatcher, so that handlers run on the thread the application dispatches its actions to.
+			void raiseConnectionStateChanged(GameConnectionState state)
+			{
+				std::weak_ptr<UsersApi> wThat = this->shared_from_this();
+				_userDispatcher->post([wThat, state]
+					{
+						if (auto that = wThat.lock())
+						{
+							that->connectionStateChanged(state);
+						}
+					});
+			}
+
+			// Breakdown of the time spent authenticating, reported once authenticated.
+			struct LoginTimings
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				std::chrono::steady_clock::time_point connected;
+				std::chrono::steady_clock::time_point credentialsRetrieved;
+				std::chrono::steady_clock::time_point loginSent;
+
+				std::string format(std::chrono::steady_clock::time_point authenticated) const
+				{
+					auto ms = [](std::chrono::steady_clock::duration duration)
+					{
+						return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()) + "ms";
+					};
+					return "total=" + ms(authenticated - start)
+						+ " connect=" + ms(connected - start)
+						+ " credentials=" + ms(credentialsRetrieved - start)
+						+ " waitForCredentials=" + ms(loginSent - connected)
+						+ " login=" + ms(authenticated - loginSent);
+				}
+			};
+
 			pplx::task<std::shared_ptr<Scene>> loginImpl(int retry = 0)
 			{
 				setConnectionState(GameConnectionState::Connecting);
@@ -890,6 +1242,29 @@ namespace Stormancer
 					return pplx::task_from_exception<std::shared_ptr<Scene>>(std::runtime_error("Client destroyed."));
 				}
 
+				// Platform credential providers can be slow: retrieve the credentials while connecting to the authenticator scene,
+				// or skip them altogether if the server issued a resumption ticket to this client.
+				auto timings = std::make_shared<LoginTimings>();
+				auto resumptionTicket = getResumptionTicket();
+				if (resumptionTicket.empty())
+				{
+					resumptionTicket = getSavedResumptionTicket();
+				}
+				pplx::task<AuthParameters> credentialsTask;
+				if (!resumptionTicket.empty())
+				{
+					AuthParameters parameters;
+					parameters.type = RESUME_PROVIDER;
+					parameters.parameters["ticket"] = resumptionTicket;
+					timings->credentialsRetrieved = timings->start;
+					credentialsTask = pplx::task_from_result(parameters);
+				}
+				else
+				{
+					credentialsTask = retrieveCredentials(timings);
+				}
+				auto resumed = !resumptionTicket.empty();
+
 				return client->connectToPublicScene(SCENE_ID, [wThat](std::shared_ptr<Scene> scene)
 				{
 					auto that = wThat.lock();
@@ -909,7 +1284,7 @@ namespace Stormancer
 									that->setConnectionState(GameConnectionState(GameConnectionState::State::Disconnected, state.reason));
 									break;
 								case ConnectionState::Connecting:
-									that->connectionStateChanged(GameConnectionState::Connecting);
+									that->raiseConnectionStateChanged(GameConnectionState::Connecting);
 									break;
 								default:
 									break;
@@ -968,8 +1343,9 @@ namespace Stormancer
 						});
 					});
 				})
-					.then([wThat](std::shared_ptr<Scene> scene)
+					.then([wThat, credentialsTask, timings, resumed](std::shared_ptr<Scene> scene)
 				{
+					timings->connected = std::chrono::steady_clock::now();
 					auto that = wThat.lock();
 
 					if (!that)
@@ -982,32 +1358,25 @@ namespace Stormancer
 						throw std::runtime_error("Auto recconnection is disable please login before");
 					}
 
-					return that->runCredentialsEventHandlers()
-						.then([scene, wThat](pplx::task<AuthParameters> ctxTask)
+					return sendLoginRequest(wThat, scene, credentialsTask, timings)
+						.then([scene, wThat, timings, resumed](LoginResult result)
 					{
-						AuthParameters ctx;
 						auto that = wThat.lock();
-						try
-						{
-							ctx = ctxTask.get();
-						}
-						catch (const std::exception& ex)
-						{
-							// if an exception was thrown by auth event handlers, do not try to reconnect
-							if (that)
-							{
-								that->_autoReconnect = false;
-							}
-							throw CredentialsException("An exception was thrown by an IAuthenticationEventHandler::retrieveCredentials() call", ex);
-						}
 						if (!that)
 						{
 							throw std::runtime_error("destroyed");
 						}
-						auto rpcService = scene->dependencyResolver().resolve<RpcService>();
-						return rpcService->rpc<LoginResult>("Authentication.Login", ctx);
+						if (result.success || !resumed)
+						{
+							return pplx::task_from_result(result);
+						}
+
+						// The ticket expired, or the server restarted: fall back to the credentials.
+						that->_logger->log(LogLevel::Info, "UsersApi", "Session resumption failed, retrieving credentials", result.errorMsg);
+						that->setResumptionTicket("");
+						return sendLoginRequest(wThat, scene, that->retrieveCredentials(timings), timings);
 					})
-						.then([scene, wThat](LoginResult result)
+						.then([scene, wThat, timings](LoginResult result)
 					{
 						auto that = wThat.lock();
 						if (!that)
@@ -1024,8 +1393,11 @@ namespace Stormancer
 						else
 						{
 							that->_currentStatus = result.authentications;
+							that->setResumptionTicket(result.resumptionTicket);
 							that->_userId = result.userId;
 							that->_username = result.username;
+							that->_logger->log(LogLevel::Info, "UsersApi", "Authenticated", timings->format(std::chrono::steady_clock::now()));
+							that->revalidateCache(scene);
 							that->setConnectionState(GameConnectionState::Authenticated);
 							for (auto h : that->_authenticationEventHandlers)
 							{
@@ -1090,6 +1462,269 @@ namespace Stormancer
 				});
 			}
 
+			pplx::task<AuthParameters> retrieveCredentials(std::shared_ptr<LoginTimings> timings)
+			{
+				pplx::task<AuthParameters> credentialsTask;
+				try
+				{
+					credentialsTask = runCredentialsEventHandlers()
+						.then([timings](AuthParameters parameters)
+					{
+						timings->credentialsRetrieved = std::chrono::steady_clock::now();
+						return parameters;
+					});
+				}
+				catch (...)
+				{
+					credentialsTask = pplx::task_from_exception<AuthParameters>(std::current_exception());
+				}
+				// Observe the failure even if the connection fails first. It is reported by the login continuation otherwise.
+				credentialsTask.then([](pplx::task<AuthParameters> task)
+				{
+					try
+					{
+						task.get();
+					}
+					catch (...)
+					{
+					}
+				});
+				return credentialsTask;
+			}
+
+			static pplx::task<LoginResult> sendLoginRequest(std::weak_ptr<UsersApi> wThat, std::shared_ptr<Scene> scene, pplx::task<AuthParameters> credentialsTask, std::shared_ptr<LoginTimings> timings)
+			{
+				return credentialsTask
+					.then([scene, wThat, timings](pplx::task<AuthParameters> ctxTask)
+				{
+					AuthParameters ctx;
+					auto that = wThat.lock();
+					try
+					{
+						ctx = ctxTask.get();
+					}
+					catch (const std::exception& ex)
+					{
+						// if an exception was thrown by auth event handlers, do not try to reconnect
+						if (that)
+						{
+							that->_autoReconnect = false;
+						}
+						throw CredentialsException("An exception was thrown by an IAuthenticationEventHandler::retrieveCredentials() call", ex);
+					}
+					if (!that)
+					{
+						throw std::runtime_error("destroyed");
+					}
+					auto rpcService = scene->dependencyResolver().resolve<RpcService>();
+					timings->loginSent = std::chrono::steady_clock::now();
+					return rpcService->rpc<LoginResult>("Authentication.Login", ctx);
+				});
+			}
+
+			// PlatformUserId::toString() of the current local user, empty without platform user.
+			std::string currentLocalUserId() const
+			{
+				auto localUser = _currentLocalUser;
+				return localUser ? localUser->toString() : "";
+			}
+
+			// Must be called with _resumptionTicketMutex held.
+			// The ticket saved by a previous run is read from resumptionTicketPath the first time it is needed, followed by the local user it was issued to.
+			void loadResumptionTicket()
+			{
+				if (!_resumptionTicketLoaded)
+				{
+					_resumptionTicketLoaded = true;
+					if (!resumptionTicketPath.empty())
+					{
+						std::ifstream file(resumptionTicketPath);
+						std::getline(file, _savedResumptionTicket);
+						std::getline(file, _resumptionTicketOwner);
+					}
+				}
+			}
+
+			// The ticket issued to this run, which resumes the session it logged in.
+			std::string getResumptionTicket()
+			{
+				std::lock_guard<std::mutex> lg(_resumptionTicketMutex);
+				return _resumptionTicket;
+			}
+
+			// The ticket saved by a previous run, for whichever account was logged in then: it is only used if it was issued to the current local user.
+			std::string getSavedResumptionTicket()
+			{
+				auto localUserId = currentLocalUserId();
+				std::lock_guard<std::mutex> lg(_resumptionTicketMutex);
+				loadResumptionTicket();
+				return !localUserId.empty() && _resumptionTicketOwner == localUserId ? _savedResumptionTicket : "";
+			}
+
+			std::string getResumptionTicketOwner()
+			{
+				std::lock_guard<std::mutex> lg(_resumptionTicketMutex);
+				loadResumptionTicket();
+				return _resumptionTicketOwner;
+			}
+
+			// The ticket belongs to the current local user, who logged in with it.
+			void setResumptionTicket(const std::string& ticket)
+			{
+				auto owner = currentLocalUserId();
+				std::lock_guard<std::mutex> lg(_resumptionTicketMutex);
+				_resumptionTicketLoaded = true;
+				_resumptionTicket = ticket;
+				_savedResumptionTicket.clear();
+				_resumptionTicketOwner = owner;
+				if (!resumptionTicketPath.empty())
+				{
+					if (ticket.empty())
+					{
+						std::remove(resumptionTicketPath.c_str());
+					}
+					else
+					{
+						std::ofstream file(resumptionTicketPath, std::ios::trunc);
+						file << ticket << '\n' << owner;
+						if (!file)
+						{
+							_logger->log(LogLevel::Warn, "UsersApi", "Could not save the resumption ticket", resumptionTicketPath);
+						}
+					}
+				}
+			}
+
+			// Must be called with _cacheMutex held.
+			void loadCache()
+			{
+				if (!_cacheLoaded)
+				{
+					_cacheLoaded = true;
+					if (!authenticationCachePath.empty() && !_cache.load(authenticationCachePath))
+					{
+						_cache = details::AuthenticationCache();
+					}
+				}
+			}
+
+			// Must be called with _cacheMutex held.
+			void saveCache()
+			{
+				if (!authenticationCachePath.empty() && !_cache.save(authenticationCachePath))
+				{
+					_logger->log(LogLevel::Warn, "UsersApi", "Could not save the authentication cache", authenticationCachePath);
+				}
+			}
+
+			void clearCachedStatus()
+			{
+				std::lock_guard<std::mutex> lg(_cacheMutex);
+				loadCache();
+				if (!_cache.status.eTag.empty())
+				{
+					_cache.status = CachedAuthenticationData();
+					_cache.statusUserId.clear();
+					_cache.statusLocalUserId.clear();
+					saveCache();
+				}
+			}
+
+			void discardCachedStatusOfOtherUsers(const std::string& localUserId)
+			{
+				std::lock_guard<std::mutex> lg(_cacheMutex);
+				loadCache();
+				if (!_cache.status.eTag.empty() && _cache.statusLocalUserId != localUserId)
+				{
+					_cache.status = CachedAuthenticationData();
+					_cache.statusUserId.clear();
+					_cache.statusLocalUserId.clear();
+					saveCache();
+				}
+			}
+
+			// An empty eTag always gets the data.
+			pplx::task<std::unordered_map<std::string, std::string>> fetchMetadata(std::shared_ptr<Scene> scene, const std::string& eTag, pplx::cancellation_token ct)
+			{
+				std::weak_ptr<UsersApi> wThat = this->shared_from_this();
+				auto rpc = scene->dependencyResolver().resolve<RpcService>();
+				return rpc->rpc<CachedAuthenticationData>("Authentication.GetMetadataIfModified", ct, eTag)
+					.then([wThat](CachedAuthenticationData metadata)
+				{
+					auto that = wThat.lock();
+					if (!that)
+					{
+						return metadata.data;
+					}
+					std::lock_guard<std::mutex> lg(that->_cacheMutex);
+					if (metadata.modified)
+					{
+						that->_cache.metadata = metadata;
+						that->saveCache();
+					}
+					return that->_cache.metadata.data;
+				});
+			}
+
+			pplx::task<std::unordered_map<std::string, std::string>> fetchStatus(std::shared_ptr<Scene> scene, const std::string& eTag, pplx::cancellation_token ct)
+			{
+				std::weak_ptr<UsersApi> wThat = this->shared_from_this();
+				auto rpc = scene->dependencyResolver().resolve<RpcService>();
+				return rpc->rpc<CachedAuthenticationData>("Authentication.GetStatusIfModified", ct, eTag)
+					.then([wThat](CachedAuthenticationData status)
+				{
+					auto that = wThat.lock();
+					if (!that)
+					{
+						return status.data;
+					}
+					std::lock_guard<std::mutex> lg(that->_cacheMutex);
+					if (status.modified)
+					{
+						that->_cache.status = status;
+						that->_cache.statusUserId = that->_userId;
+						that->_cache.statusLocalUserId = that->currentLocalUserId();
+						that->saveCache();
+					}
+					that->_currentStatus = that->_cache.status.data;
+					return that->_cache.status.data;
+				});
+			}
+
+			// Check the cached values, in the background, once authenticated: the server only sends them back if they changed.
+			void revalidateCache(std::shared_ptr<Scene> scene)
+			{
+				std::string metadataETag;
+				std::string statusETag;
+				{
+					std::lock_guard<std::mutex> lg(_cacheMutex);
+					loadCache();
+					metadataETag = _cache.metadata.eTag;
+					statusETag = _cache.status.eTag;
+				}
+
+				auto logger = _logger;
+				auto observe = [logger](pplx::task<std::unordered_map<std::string, std::string>> task)
+				{
+					try
+					{
+						task.get();
+					}
+					catch (const std::exception& ex)
+					{
+						logger->log(LogLevel::Debug, "UsersApi", "Could not check the authentication cache", ex);
+					}
+				};
+				if (!metadataETag.empty())
+				{
+					fetchMetadata(scene, metadataETag, pplx::cancellation_token::none()).then(observe);
+				}
+				if (!statusETag.empty())
+				{
+					fetchStatus(scene, statusETag, pplx::cancellation_token::none()).then(observe);
+				}
+			}
+
 			pplx::task<AuthParameters> runCredentialsEventHandlers()
 			{
 				pplx::task<AuthParameters> getCredsTask = pplx::task_from_result<AuthParameters>(AuthParameters());
@@ -1108,24 +1743,58 @@ namespace Stormancer
 						throw std::runtime_error("UsersApi destroyed");
 					}
 
-					CredientialsContext credentialsContext;
-					credentialsContext.authParameters = std::make_shared<AuthParameters>(authParameters);
-					credentialsContext.platformUserId = that->_currentLocalUser;
-					pplx::task<void> eventHandlersTask = pplx::task_from_result();
+					// Each handler works on its own copy of the parameters, so that they can run concurrently.
+					std::vector<CredientialsContext> contexts;
+					std::vector<pplx::task<void>> eventHandlerTasks;
 					for (auto evHandler : that->_authenticationEventHandlers)
 					{
-						eventHandlersTask = eventHandlersTask.then([evHandler, credentialsContext]
+						CredientialsContext credentialsContext;
+						credentialsContext.authParameters = std::make_shared<AuthParameters>(authParameters);
+						credentialsContext.platformUserId = that->_currentLocalUser;
+						contexts.push_back(credentialsContext);
+						eventHandlerTasks.push_back(pplx::create_task([evHandler, credentialsContext]
 						{
 							return evHandler->retrieveCredentials(credentialsContext);
-						}, that->_userDispatcher);
+						}, that->_userDispatcher));
 					}
-					return eventHandlersTask.then([credentialsContext]
+					return pplx::when_all(eventHandlerTasks.begin(), eventHandlerTasks.end())
+						.then([authParameters, contexts]
 					{
-						return *credentialsContext.authParameters;
+						return mergeCredentials(authParameters, contexts);
 					});
 				});
 			}
 
+			// Apply the changes each handler made to the initial parameters, in registration order.
+			static AuthParameters mergeCredentials(const AuthParameters& initial, const std::vector<CredientialsContext>& contexts)
+			{
+				auto merged = initial;
+				for (const auto& context : contexts)
+				{
+					const auto& parameters = *context.authParameters;
+					if (parameters.type != initial.type)
+					{
+						merged.type = parameters.type;
+					}
+					for (const auto& parameter : parameters.parameters)
+					{
+						auto it = initial.parameters.find(parameter.first);
+						if (it == initial.parameters.end() || it->second != parameter.second)
+						{
+							merged.parameters[parameter.first] = parameter.second;
+						}
+					}
+					for (const auto& parameter : initial.parameters)
+					{
+						if (parameters.parameters.find(parameter.first) == parameters.parameters.end())
+						{
+							merged.parameters.erase(parameter.first);
+						}
+					}
+				}
+				return merged;
+			}
+
 			pplx::task<RenewCredentialsParameters> runCredentialsRenewalHandlers(const std::string& providerType)
 			{
 				CredentialsRenewalContext context;
@@ -1154,6 +1823,8 @@ namespace Stormancer
 
 			const std::string SCENE_ID = "authenticator";
 			const std::string LOGIN_ROUTE = "login";
+			// Type of the AuthParameters presenting a resumption ticket.
+			const std::string RESUME_PROVIDER = "resume";
 
 			bool _autoReconnect = true;
 
@@ -1169,10 +1840,20 @@ namespace Stormancer
 			std::shared_ptr<pplx::task<std::shared_ptr<Scene>>> _authTask;
 
 			std::unordered_map<std::string, std::function<pplx::task<void>(OperationCtx&)>> _operationHandlers;
+			std::mutex _requestTransportsMutex;
+			std::vector<std::shared_ptr<IUserRequestTransport>> _requestTransports;
 			std::vector<std::shared_ptr<IAuthenticationEventHandler>> _authenticationEventHandlers;
 			std::shared_ptr<IActionDispatcher> _userDispatcher;
 			// The current platform-specific local user, set by the game using setCurrentLocalUser().
 			std::shared_ptr<PlatformUserId> _currentLocalUser;
+			std::mutex _resumptionTicketMutex;
+			std::string _resumptionTicket;
+			std::string _savedResumptionTicket;
+			std::string _resumptionTicketOwner;
+			bool _resumptionTicketLoaded = false;
+			std::mutex _cacheMutex;
+			details::AuthenticationCache _cache;
+			bool _cacheLoaded = false;
 
 #pragma endregion
 		};
@@ -1192,7 +1873,7 @@ namespace Stormancer
 			void clientDisconnecting(std::shared_ptr<IClient> client) override
 			{
 				auto user = client->dependencyResolver().resolve<UsersApi>();
-				user->logout();
+				user->disconnect(false);
 			}
 		};
 
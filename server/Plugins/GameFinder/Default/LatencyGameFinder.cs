@@ -0,0 +1,160 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+using Newtonsoft.Json.Linq;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Threading.Tasks;
+
+namespace Stormancer.Server.GameFinder.Default
+{
+    /// <summary>
+    /// Reference <c>IGameFinder</c> forming games of a fixed size, with the lowest expected host round-trip time.
+    /// </summary>
+    /// <remarks>
+    /// Register it in the dependencies of a GameFinder: <c>builder.Register&lt;LatencyGameFinder&gt;().As&lt;IGameFinder&gt;();</c>
+    /// Groups are served oldest first: each one is completed greedily with the waiting groups that keep the expected host RTT of its game the lowest.
+    /// Only the <c>maxCandidates</c> oldest unmatched groups are considered to complete a game, which bounds the cost of a pass to O(groups * maxCandidates).
+    /// A game is only formed if this RTT is below <c>maxHostRtt</c>, unless its oldest group waited for more than <c>relaxAfter</c> seconds.
+    /// The elected host is written to the custom data of the game (<c>hostUserId</c>, <c>expectedHostRtt</c>):
+    /// the <c>IGameFinderResolver</c> should pass <see cref="GetHostUserId"/> to the <c>HostUserId</c> of the game session configuration.
+    /// Configuration, in <c>gamefinder.configs.&lt;kind&gt;.latency</c>: <c>playersPerGame</c> (2), <c>maxHostRtt</c> (150 ms), <c>relaxAfter</c> (30 s), <c>maxCandidates</c> (50).
+    /// </remarks>
+    public class LatencyGameFinder : IGameFinder
+    {
+        private int _playersPerGame = 2;
+        private double _maxHostRtt = 150;
+        private TimeSpan _relaxAfter = TimeSpan.FromSeconds(30);
+        private int _maxCandidates = 50;
+
+        private int _gamesFormed;
+        private int _relaxedGames;
+
+        public Task<GameFinderResult> FindGames(GameFinderContext gameFinderContext)
+        {
+            var results = new GameFinderResult();
+            var now = DateTime.UtcNow;
+            var waiting = gameFinderContext.WaitingClient.OrderBy(g => g.CreationTimeUtc).ToList();
+            var matched = new HashSet<Group>();
+
+            foreach (var seed in waiting)
+            {
+                if (matched.Contains(seed))
+                {
+                    continue;
+                }
+                if (seed.Players.Count > _playersPerGame)
+                {
+                    gameFinderContext.SetFailed(seed, "gamefinder.groupTooLarge");
+                    matched.Add(seed);
+                    continue;
+                }
+
+                var groups = new List<Group> { seed };
+                var playerCount = seed.Players.Count;
+                while (playerCount < _playersPerGame)
+                {
+                    Group best = null;
+                    var bestRtt = double.MaxValue;
+                    var scanned = 0;
+                    foreach (var candidate in waiting)
+                    {
+                        if (matched.Contains(candidate) || groups.Contains(candidate) || playerCount + candidate.Players.Count > _playersPerGame)
+                        {
+                            continue;
+                        }
+                        if (++scanned > _maxCandidates)
+                        {
+                            break;
+                        }
+                        var rtt = LatencyMatching.ElectHost(groups.Concat(new[] { candidate }).SelectMany(g => g.Players)).ExpectedRtt;
+                        if (rtt < bestRtt)
+                        {
+                            best = candidate;
+                            bestRtt = rtt;
+                        }
+                    }
+                    if (best == null)
+                    {
+                        break;
+                    }
+                    groups.Add(best);
+                    playerCount += best.Players.Count;
+                }
+                if (playerCount < _playersPerGame)
+                {
+                    continue;
+                }
+
+                var election = LatencyMatching.ElectHost(groups.SelectMany(g => g.Players));
+                var relaxed = now - seed.CreationTimeUtc > _relaxAfter;
+                if (election.ExpectedRtt > _maxHostRtt && !relaxed)
+                {
+                    continue;
+                }
+
+                foreach (var group in groups)
+                {
+                    matched.Add(group);
+                }
+                results.Games.Add(Game.Create(new[] { new Team(groups) }, new { hostUserId = election.Host.UserId, expectedHostRtt = election.ExpectedRtt }));
+                _gamesFormed++;
+                if (election.ExpectedRtt > _maxHostRtt)
+                {
+                    _relaxedGames++;
+                }
+            }
+            return Task.FromResult(results);
+        }
+
+        /// <summary>
+        /// User id of the host elected for a game formed by a <c>LatencyGameFinder</c>, null for other games.
+        /// </summary>
+        public static string GetHostUserId(Game game)
+        {
+            return game.CustomData?["hostUserId"]?.ToString();
+        }
+
+        public Dictionary<string, int> GetMetrics()
+        {
+            return new Dictionary<string, int>
+            {
+                ["gamesFormed"] = _gamesFormed,
+                ["relaxedGames"] = _relaxedGames
+            };
+        }
+
+        public JObject ComputeDataAnalytics(GameFinderContext gameFinderContext)
+        {
+            var playersWithLatencies = gameFinderContext.WaitingClient.SelectMany(g => g.Players).Count(p => p.Latencies.Any());
+            return JObject.FromObject(new { waitingGroups = gameFinderContext.WaitingClient.Count, playersWithLatencies });
+        }
+
+        public void RefreshConfig(dynamic specificConfig, dynamic config)
+        {
+            _playersPerGame = (int)(specificConfig?.latency?.playersPerGame ?? 2);
+            _maxHostRtt = (double)(specificConfig?.latency?.maxHostRtt ?? 150);
+            _relaxAfter = TimeSpan.FromSeconds((double)(specificConfig?.latency?.relaxAfter ?? 30));
+            _maxCandidates = Math.Max(1, (int)(specificConfig?.latency?.maxCandidates ?? 50));
+        }
+    }
+}
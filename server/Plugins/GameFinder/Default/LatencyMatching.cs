@@ -0,0 +1,86 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace Stormancer.Server.GameFinder.Default
+{
+    /// <summary>
+    /// Estimates the round-trip times between players from the latency vectors their clients send with their findGame requests.
+    /// </summary>
+    /// <remarks>
+    /// The round-trip time between two players is estimated as the best path through an endpoint both of them probed (relay, region or server).
+    /// It is an upper bound of the direct link, consistent between candidates, which is what host and game selection need.
+    /// </remarks>
+    public static class LatencyMatching
+    {
+        /// <summary>
+        /// Estimate, in milliseconds, used for two players that did not probe any common endpoint.
+        /// </summary>
+        public const int UnknownRtt = 500;
+
+        public static int? EstimateRtt(Player a, Player b)
+        {
+            return EstimateRtt(a.Latencies, b.Latencies);
+        }
+
+        public static int? EstimateRtt(IReadOnlyDictionary<string, ushort> a, IReadOnlyDictionary<string, ushort> b)
+        {
+            int? best = null;
+            foreach (var entry in a)
+            {
+                if (b.TryGetValue(entry.Key, out var other))
+                {
+                    var rtt = entry.Value + other;
+                    if (best == null || rtt < best)
+                    {
+                        best = rtt;
+                    }
+                }
+            }
+            return best;
+        }
+
+        /// <summary>
+        /// Mean round-trip time from a host to the other players of a game, in milliseconds.
+        /// </summary>
+        public static double ExpectedHostRtt(Player host, IEnumerable<Player> players)
+        {
+            var rtts = players.Where(p => p != host).Select(p => (double)(EstimateRtt(host, p) ?? UnknownRtt)).ToList();
+            return rtts.Any() ? rtts.Average() : 0;
+        }
+
+        /// <summary>
+        /// Select the player of a game with the lowest expected host round-trip time. Ties are broken by user id, so that the result is deterministic.
+        /// </summary>
+        public static (Player Host, double ExpectedRtt) ElectHost(IEnumerable<Player> players)
+        {
+            var candidates = players.ToList();
+            return candidates
+                .Select(p => (Host: p, ExpectedRtt: ExpectedHostRtt(p, candidates)))
+                .OrderBy(c => c.ExpectedRtt)
+                .ThenBy(c => c.Host.UserId, StringComparer.Ordinal)
+                .FirstOrDefault();
+        }
+    }
+}
@@ -57,8 +57,14 @@ namespace Stormancer.Server.GameFinder
         private const string UPDATE_NOTIFICATION_ROUTE = "gamefinder.update";
         private const string UPDATE_READYCHECK_ROUTE = "gamefinder.ready.update";
         private const string UPDATE_FINDGAME_REQUEST_PARAMS_ROUTE = "gamefinder.parameters.update";
+        private const string PROBE_ROUTE = "gamefinder.probe";
+        private const string UPDATE_LATENCIES_ROUTE = "gamefinder.latency.update";
         private const string LOG_CATEGORY = "GameFinderService";
 
+        // Clients end their findGame requests with their latency vector, followed by its size (big-endian uint32) and this marker.
+        private static readonly byte[] LATENCY_TRAILER_MARKER = { (byte)'L', (byte)'T', (byte)'V', (byte)'1' };
+        private const int LATENCY_TRAILER_SIZE = 8;
+
         private ISceneHost _scene;
 
         private readonly IEnumerable<IGameFinderDataExtractor> _extractors;
@@ -103,6 +109,9 @@ namespace Stormancer.Server.GameFinder
             scene.AddProcedure("gamefinder.find", FindGame);
             scene.AddRoute("gamefinder.ready.resolve", ResolveReadyRequest, r => r);
             scene.AddRoute("gamefinder.cancel", CancelGame, r => r);
+            // Clients measure their round-trip time to the server with this empty procedure.
+            scene.AddProcedure(PROBE_ROUTE, request => Task.CompletedTask);
+            scene.AddRoute(UPDATE_LATENCIES_ROUTE, UpdateLatencies, r => r);
         }
 
         private void Env_ActiveDeploymentChanged(object sender, ActiveDeploymentChangedEventArgs e)
@@ -283,6 +292,7 @@ namespace Stormancer.Server.GameFinder
             }
 
             var group = new Group();
+            var latencies = ReadLatencyTrailer(request.InputStream);
             var provider = request.ReadObject<string>();
 
             User currentUser = null;
@@ -303,6 +313,15 @@ namespace Stormancer.Server.GameFinder
                 group.Players.Add(new Player(request.RemotePeer.SessionId, currentUser.Id) { });
             }
 
+            if (latencies != null)
+            {
+                var requester = group.Players.FirstOrDefault(p => p.SessionId == request.RemotePeer.SessionId);
+                if (requester != null)
+                {
+                    requester.Latencies = latencies;
+                }
+            }
+
             PeerInGroup[] peersInGroup = null;
             using (var scope = _scene.DependencyResolver.CreateChild(global::Server.Plugins.API.Constants.ApiRequestTag))
             {
@@ -684,6 +703,64 @@ namespace Stormancer.Server.GameFinder
             check.ResolvePlayer(user.Id, accepts);
         }
 
+        // The latency vector is read from the end of the request, so that it does not depend on how much of the request the data extractors read.
+        // Returns null if the request has no latency vector (older clients), and leaves the stream at its position.
+        private Dictionary<string, ushort> ReadLatencyTrailer(Stream stream)
+        {
+            if (!stream.CanSeek || stream.Length - stream.Position < LATENCY_TRAILER_SIZE)
+            {
+                return null;
+            }
+            var position = stream.Position;
+            try
+            {
+                var trailer = new byte[LATENCY_TRAILER_SIZE];
+                stream.Seek(-LATENCY_TRAILER_SIZE, SeekOrigin.End);
+                if (stream.Read(trailer, 0, LATENCY_TRAILER_SIZE) != LATENCY_TRAILER_SIZE || !trailer.Skip(4).SequenceEqual(LATENCY_TRAILER_MARKER))
+                {
+                    return null;
+                }
+                var size = ((long)trailer[0] << 24) | ((long)trailer[1] << 16) | ((long)trailer[2] << 8) | trailer[3];
+                if (size > stream.Length - position - LATENCY_TRAILER_SIZE)
+                {
+                    return null;
+                }
+                var buffer = new byte[size];
+                stream.Seek(-LATENCY_TRAILER_SIZE - size, SeekOrigin.End);
+                if (stream.Read(buffer, 0, buffer.Length) != buffer.Length)
+                {
+                    return null;
+                }
+                using (var latencies = new MemoryStream(buffer))
+                {
+                    return _serializer.Deserialize<Dictionary<string, ushort>>(latencies);
+                }
+            }
+            catch (Exception ex)
+            {
+                _logger.Log(LogLevel.Warn, LOG_CATEGORY, "Invalid latency vector in a findGame request", ex);
+                return null;
+            }
+            finally
+            {
+                stream.Seek(position, SeekOrigin.Begin);
+            }
+        }
+
+        public Task UpdateLatencies(Packet<IScenePeerClient> packet)
+        {
+            if (_data.peersToGroup.TryGetValue(packet.Connection.SessionId, out var group))
+            {
+                var player = group.Players.FirstOrDefault(p => p.SessionId == packet.Connection.SessionId);
+                var latencies = _serializer.Deserialize<Dictionary<string, ushort>>(packet.Stream);
+                if (player != null && latencies != null)
+                {
+                    player.Latencies = latencies;
+                }
+            }
+            return Task.CompletedTask;
+        }
+
         public Task CancelGame(Packet<IScenePeerClient> packet)
         {
             return CancelGame(packet.Connection, true);
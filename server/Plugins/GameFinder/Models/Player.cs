@@ -19,6 +19,8 @@
 // LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
+using System.Collections.Generic;
+
 namespace Stormancer.Server.GameFinder
 {
     public class Player
@@ -32,5 +34,13 @@ namespace Stormancer.Server.GameFinder
         public string UserId { get; }
         public string SessionId { get; }
         public object Data { get; set; }
+
+        /// <summary>
+        /// Round-trip times from the player to the endpoints it probed, in milliseconds, by endpoint id.
+        /// </summary>
+        /// <remarks>
+        /// Sent by the client with its findGame request, then updated while the search runs. Empty if the client did not send any.
+        /// </remarks>
+        public IReadOnlyDictionary<string, ushort> Latencies { get; set; } = new Dictionary<string, ushort>();
     }
 }
@@ -0,0 +1,138 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Security.Cryptography;
+
+namespace Stormancer.Server.GameSession
+{
+    /// <summary>
+    /// Times the connectivity probes of a peer on the server, to bound the connectivity it reports.
+    /// </summary>
+    /// <remarks>
+    /// The response to each probe carries a random challenge, that the next probe of the peer must echo.
+    /// As this probe cannot be sent before the response is received, the time from the response to the probe is at least the round-trip time to the peer,
+    /// plus the transfer time of the probe's payload: a peer can make these measures longer, never shorter.
+    /// </remarks>
+    public class ConnectivityProbe
+    {
+        private const int MaxRttSamples = 16;
+        /// <summary>
+        /// Payloads smaller than this are only used to measure the round-trip time.
+        /// </summary>
+        public const int MinUploadPayloadSize = 16 * 1024;
+
+        private readonly object _lock = new object();
+        private readonly Stopwatch _watch = Stopwatch.StartNew();
+        private readonly List<TimeSpan> _rttSamples = new List<TimeSpan>();
+        private ulong _challenge;
+        private TimeSpan _challengeSentAt;
+        private int _uploadPayloadSize;
+        private TimeSpan _uploadElapsed;
+
+        /// <summary>
+        /// Records a probe, and returns the challenge the next probe must echo.
+        /// </summary>
+        /// <param name="challenge">Challenge returned by the previous probe, 0 for the first one.</param>
+        /// <param name="payloadSize">Size of the probe's payload, in bytes.</param>
+        public ulong Receive(ulong challenge, int payloadSize)
+        {
+            lock (_lock)
+            {
+                if (_challenge != 0 && challenge == _challenge)
+                {
+                    var elapsed = _watch.Elapsed - _challengeSentAt;
+                    if (payloadSize < MinUploadPayloadSize)
+                    {
+                        if (_rttSamples.Count < MaxRttSamples)
+                        {
+                            _rttSamples.Add(elapsed);
+                        }
+                    }
+                    else
+                    {
+                        _uploadPayloadSize = payloadSize;
+                        _uploadElapsed = elapsed;
+                    }
+                }
+                _challenge = NewChallenge();
+                // Set before the response is sent: the measures include the processing time of the server.
+                _challengeSentAt = _watch.Elapsed;
+                return _challenge;
+            }
+        }
+
+        /// <summary>
+        /// Round-trip time to the peer measured by the server, null if no probe echoed a challenge.
+        /// </summary>
+        /// <remarks>
+        /// The shortest sample: every sample is at least the actual round-trip time.
+        /// </remarks>
+        public TimeSpan? RoundTripTime
+        {
+            get
+            {
+                lock (_lock)
+                {
+                    return _rttSamples.Any() ? _rttSamples.Min() : (TimeSpan?)null;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Highest upload throughput of the peer compatible with the transfer time of its upload probe, in kbit/s. Null if it was not measured.
+        /// </summary>
+        public uint? MaxUploadKbps
+        {
+            get
+            {
+                lock (_lock)
+                {
+                    if (_uploadPayloadSize == 0 || !_rttSamples.Any())
+                    {
+                        return null;
+                    }
+                    var transferMs = Math.Max((_uploadElapsed - _rttSamples.Min()).TotalMilliseconds, 1);
+                    return (uint)Math.Min(_uploadPayloadSize * 8 / transferMs, uint.MaxValue);
+                }
+            }
+        }
+
+        private static ulong NewChallenge()
+        {
+            var bytes = new byte[8];
+            ulong challenge;
+            using (var random = RandomNumberGenerator.Create())
+            {
+                do
+                {
+                    random.GetBytes(bytes);
+                    challenge = BitConverter.ToUInt64(bytes, 0);
+                }
+                while (challenge == 0);
+            }
+            return challenge;
+        }
+    }
+}
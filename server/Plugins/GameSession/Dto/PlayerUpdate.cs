@@ -36,5 +36,11 @@ namespace Stormancer.Server.GameSession
 
         [MessagePackMember(3)]
         public bool IsHost { get; set; }
+
+        /// <summary>
+        /// Session id of the player, empty if disconnected. Players use it to check the user id announced on their P2P connections.
+        /// </summary>
+        [MessagePackMember(4)]
+        public string SessionId { get; set; }
     }
 }
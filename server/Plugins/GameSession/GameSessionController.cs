@@ -29,6 +29,7 @@ using Stormancer.Platform.Core.Cryptography;
 using Stormancer.Server.Components;
 using Stormancer.Server.Users;
 using System;
+using System.Collections.Generic;
 using System.Linq;
 
 namespace Stormancer.Server.GameSession
@@ -59,12 +60,55 @@ namespace Stormancer.Server.GameSession
 
         }
 
+        [Api(ApiAccess.Public, ApiType.Rpc)]
+        public Task<ResultUploadStatus> BeginResultUpload()
+        {
+            return _service.BeginResultUpload(this.Request.RemotePeer);
+        }
+
+        [Api(ApiAccess.Public, ApiType.Rpc)]
+        public Task<int> PostResultChunk(string uploadId, int index, byte[] data)
+        {
+            return _service.PostResultChunk(uploadId, index, data, this.Request.RemotePeer);
+        }
+
+        public async Task CompleteResultUpload(RequestContext<IScenePeerClient> ctx)
+        {
+            var uploadId = ctx.ReadObject<string>();
+            var chunkCount = ctx.ReadObject<int>();
+            var compressed = ctx.ReadObject<bool>();
+            var writer = await _service.CompleteResultUpload(uploadId, chunkCount, compressed, ctx.RemotePeer);
+            await ctx.SendValue(s =>
+            {
+                writer(s, ctx.RemotePeer.Serializer());
+            });
+        }
+
+        /// <summary>
+        /// Procedure timed by clients to measure their round-trip time and upload throughput to the server.
+        /// </summary>
+        /// <remarks>
+        /// The server times the probes too, to bound the connectivity reported by the client: each probe echoes the challenge returned by the previous one.
+        /// </remarks>
+        /// <param name="challenge">Challenge returned by the previous probe, 0 for the first one.</param>
+        [Api(ApiAccess.Public, ApiType.Rpc)]
+        public Task<ulong> Probe(ulong challenge, byte[] payload)
+        {
+            return Task.FromResult(_service.ReceiveProbe(this.Request.RemotePeer.SessionId, challenge, payload?.Length ?? 0));
+        }
+
         [Api(ApiAccess.Public, ApiType.Rpc)]
         public async Task<string> GetP2PToken()
         {
             return await _service.CreateP2PToken(this.Request.RemotePeer.SessionId);
         }
 
+        [Api(ApiAccess.Public, ApiType.Rpc)]
+        public Task<List<MeshPeerToken>> GetMeshP2PTokens()
+        {
+            return _service.CreateMeshP2PTokens(this.Request.RemotePeer.SessionId);
+        }
+
         public Task Reset(RequestContext<IScenePeerClient> ctx)
         {
             return _service.Reset();
@@ -89,13 +89,23 @@ namespace Stormancer.Server.GameSession
 
             public string FaultReason { get; set; }
 
+            // Sent by the player when joining, to elect the P2P host. Null until received.
+            public ConnectivityReport Connectivity { get; set; }
+
             public TaskCompletionSource<Action<Stream, ISerializer>> GameCompleteTcs { get; private set; }
         }
 
         // Constant variable
         private const string LOG_CATEOGRY = "Game session service";
         private const string P2P_TOKEN_ROUTE = "player.p2ptoken";
+        private const string HOST_CHANGED_ROUTE = "gamesession.hostChanged";
+        private const string CONNECTIVITY_ROUTE = "gamesession.connectivity";
         private const string ALL_PLAYER_READY_ROUTE = "players.allReady";
+        private const string PLAYER_UPDATE_ROUTE = "player.update";
+        private const string PLAYERS_UPDATE_ROUTE = "players.update";
+        private const string PLAYER_UPDATE_BATCHES_ROUTE = "gamesession.playerUpdateBatches";
+        // Roster changes made within this delay are sent to the players as a single batch.
+        private static readonly TimeSpan PlayerUpdateBatchDelay = TimeSpan.FromMilliseconds(20);
 
         // Stormancer object
 
@@ -114,6 +124,19 @@ namespace Stormancer.Server.GameSession
 
         private ConcurrentDictionary<string, Client> _clients = new ConcurrentDictionary<string, Client>();
         private ConcurrentDictionary<string, string> _sessionIdToUserIdMap = new ConcurrentDictionary<string, string>();
+        // Direct P2P links handed out in mesh topology, keyed by the ordered pair of session ids.
+        private ConcurrentDictionary<string, bool> _meshLinks = new ConcurrentDictionary<string, bool>();
+        // Streamed result uploads in progress, keyed by user id: a player uploads one result at a time.
+        private ConcurrentDictionary<string, ResultUpload> _resultUploads = new ConcurrentDictionary<string, ResultUpload>();
+        // Roster changes not yet sent, keyed by user id: only the latest state of a player is sent.
+        private Dictionary<string, PlayerUpdate> _pendingPlayerUpdates = new Dictionary<string, PlayerUpdate>();
+        private readonly object _playerUpdatesLock = new object();
+        private ulong _playerUpdateSequence = 0;
+        private bool _playerUpdateFlushScheduled = false;
+        // Session ids of the players that advertised support for update batches. The others are sent one "player.update" per player.
+        private HashSet<string> _playerUpdateBatchPeers = new HashSet<string>();
+        // Connectivity probes timed by the server, by session id.
+        private ConcurrentDictionary<string, ConnectivityProbe> _connectivityProbes = new ConcurrentDictionary<string, ConnectivityProbe>();
         private ServerStatus _status = ServerStatus.WaitingPlayers;
 
         private string _ip = "";
@@ -123,6 +146,12 @@ namespace Stormancer.Server.GameSession
         private ushort _serverDedicatedPort;
         private string _p2pToken;
         private bool _serverEnabled;
+        // Unless a host is set in the game session configuration, the P2P host is elected from the connectivity reported by the players.
+        private bool _hostElectionEnabled = true;
+        private TimeSpan _hostElectionTimeout = TimeSpan.FromSeconds(2);
+        // pseudoBools to use with interlocked
+        private int _hostElectionStarted = 0;
+        private int _hostElectionCompleted = 0;
 
         private readonly object _lock = new object();
         private readonly IAnalyticsService _analytics;
@@ -164,11 +193,15 @@ namespace Stormancer.Server.GameSession
             scene.Disconnected.Add((args) => this.PeerDisconnecting(args.Peer));
             scene.AddRoute("player.ready", ReceivedReady, _ => _);
             scene.AddRoute("player.faulted", ReceivedFaulted, _ => _);
+            scene.AddRoute(CONNECTIVITY_ROUTE, ReceivedConnectivityReport, _ => _);
+            scene.AddRoute(PLAYER_UPDATE_BATCHES_ROUTE, ReceivedPlayerUpdateBatchesSupport, _ => _);
         }
 
         private void OnSettingsChange(Object sender, dynamic settings)
         {
             _serverEnabled = ((bool?)settings?.gameServer?.dedicatedServer) ?? false;
+            _hostElectionEnabled = ((bool?)settings?.gameSession?.hostElection?.enabled) ?? true;
+            _hostElectionTimeout = TimeSpan.FromMilliseconds((double?)settings?.gameSession?.hostElection?.timeout ?? 2000);
             var timeout = ((string)settings?.gameServer?.dedicatedServerTimeout);
             if (timeout != null)
             {
@@ -259,17 +292,9 @@ namespace Stormancer.Server.GameSession
 
                 await CheckAllPlayersReady();
 
-                if (IsHost(peer.SessionId) && (((bool?)_configuration.Settings.gameSession?.usep2p) == true))
+                if (IsHost(peer.SessionId))
                 {
-                    var p2pToken = await _scene.DependencyResolver.Resolve<IPeerInfosService>().CreateP2pToken(peer.SessionId, _scene.Id);
-
-                    _p2pToken = p2pToken;
-
-                    foreach (var p in _scene.RemotePeers.Where(p => p != peer))
-                    {
-                        p.Send(P2P_TOKEN_ROUTE, p2pToken);
-                    }
-
+                    await SendHostP2PToken(peer);
                 }
 
             }
@@ -280,6 +305,128 @@ namespace Stormancer.Server.GameSession
             }
         }
 
+        private async Task SendHostP2PToken(IScenePeerClient host)
+        {
+            if (((bool?)_configuration.Settings.gameSession?.usep2p) != true)
+            {
+                return;
+            }
+            var p2pToken = await _scene.DependencyResolver.Resolve<IPeerInfosService>().CreateP2pToken(host.SessionId, _scene.Id);
+
+            _p2pToken = p2pToken;
+
+            foreach (var p in _scene.RemotePeers.Where(p => p != host))
+            {
+                p.Send(P2P_TOKEN_ROUTE, p2pToken);
+            }
+        }
+
+        private Task ReceivedPlayerUpdateBatchesSupport(Packet<IScenePeerClient> packet)
+        {
+            lock (_playerUpdatesLock)
+            {
+                _playerUpdateBatchPeers.Add(packet.Connection.SessionId);
+            }
+            return Task.CompletedTask;
+        }
+
+        private async Task ReceivedConnectivityReport(Packet<IScenePeerClient> packet)
+        {
+            var user = await GetUserId(packet.Connection);
+            if (user == null || !_clients.TryGetValue(user, out Client client))
+            {
+                return;
+            }
+            var report = packet.ReadObject<ConnectivityReport>() ?? new ConnectivityReport();
+            _connectivityProbes.TryGetValue(packet.Connection.SessionId, out var probe);
+            var bounded = HostElection.Bound(report, probe, out var reason);
+            if (bounded == null)
+            {
+                // Scored as a player without report.
+                _logger.Log(LogLevel.Warn, LOG_CATEOGRY, "Rejected a connectivity report: " + reason, new { gameSessionId = _scene.Id, userId = user });
+                bounded = new ConnectivityReport();
+            }
+            client.Connectivity = bounded;
+
+            if (_hostElectionStarted == 1 && AllConnectivityReported())
+            {
+                await CompleteHostElection();
+            }
+        }
+
+        private bool AllConnectivityReported()
+        {
+            var userIds = _config.UserIds.ToList();
+            return userIds.Any() && userIds.All(id => _clients.TryGetValue(id, out var c) && c.Peer != null && c.Connectivity != null);
+        }
+
+        // The election completes once every expected player reported its connectivity, or when the timeout elapses.
+        private void StartHostElection()
+        {
+            if (System.Threading.Interlocked.CompareExchange(ref _hostElectionStarted, 1, 0) != 0)
+            {
+                return;
+            }
+            var _ = Task.Run(async () =>
+            {
+                try
+                {
+                    await Task.Delay(_hostElectionTimeout, _sceneCts.Token);
+                    await CompleteHostElection();
+                }
+                catch (OperationCanceledException)
+                {
+                }
+                catch (Exception ex)
+                {
+                    _logger.Log(LogLevel.Error, LOG_CATEOGRY, "An error occurred while electing the host of a game session", ex);
+                }
+            });
+        }
+
+        private async Task CompleteHostElection()
+        {
+            if (System.Threading.Interlocked.CompareExchange(ref _hostElectionCompleted, 1, 0) != 0)
+            {
+                return;
+            }
+            var candidates = _clients
+                .Where(kvp => kvp.Value.Peer != null && (kvp.Value.Status == PlayerStatus.Connected || kvp.Value.Status == PlayerStatus.Ready))
+                .ToDictionary(kvp => kvp.Key, kvp => kvp.Value.Connectivity);
+            if (!candidates.Any())
+            {
+                // The next player to connect becomes the host.
+                _logger.Log(LogLevel.Info, LOG_CATEOGRY, "No player connected at the end of the host election", new { gameSessionId = _scene.Id });
+                return;
+            }
+
+            var election = HostElection.Elect(candidates);
+            var host = _clients[election.UserId];
+            lock (_lock)
+            {
+                if (!string.IsNullOrEmpty(_config.HostUserId))
+                {
+                    return;
+                }
+                _config.HostUserId = election.UserId;
+                if (!GetServerTcs().TrySetResult(host.Peer))
+                {
+                    return;
+                }
+            }
+
+            _logger.Log(LogLevel.Info, LOG_CATEOGRY, "Host elected", new { gameSessionId = _scene.Id, host = election.UserId, score = election.Score, candidates = candidates.Count, reports = candidates.Values.Count(r => r != null) });
+            _analytics.Push("gamesession", "hostElected", JObject.FromObject(new { gameSessionId = _scene.Id, host = election.UserId, score = election.Score, candidates = candidates.Count }));
+
+            host.Peer.Send(P2P_TOKEN_ROUTE, "");
+            BroadcastClientUpdate(host, election.UserId);
+            // The host may have been ready before being elected.
+            if (host.Status == PlayerStatus.Ready)
+            {
+                await SendHostP2PToken(host.Peer);
+            }
+        }
+
         // pseudoBool to use with interlocked
         private int _readySent = 0;
         private async Task CheckAllPlayersReady()
@@ -288,6 +435,8 @@ namespace Stormancer.Server.GameSession
             {
                 if (_clients.Values.All(c => c.Status == PlayerStatus.Ready) && System.Threading.Interlocked.CompareExchange(ref _readySent, 1, 0) == 0)
                 {
+                    // Players must know the roster is ready before being told so.
+                    FlushPlayerUpdates();
                     _logger.Log(LogLevel.Trace, "gamesession", "Send all player ready", new { });
                     await _scene.Send(new MatchAllFilter(), ALL_PLAYER_READY_ROUTE, s => { }, PacketPriority.MEDIUM_PRIORITY, PacketReliability.RELIABLE);
                 }
@@ -296,7 +445,54 @@ namespace Stormancer.Server.GameSession
 
         private void BroadcastClientUpdate(Client client, string userId, string data = null)
         {
-            _scene.Broadcast("player.update", new PlayerUpdate { UserId = userId, Status = (byte)client.Status, Data = data ?? "", IsHost = (_config.HostUserId == userId) }, PacketPriority.MEDIUM_PRIORITY, PacketReliability.RELIABLE_ORDERED);
+            var update = new PlayerUpdate { UserId = userId, Status = (byte)client.Status, Data = data ?? "", IsHost = (_config.HostUserId == userId), SessionId = client.Peer?.SessionId ?? "" };
+            lock (_playerUpdatesLock)
+            {
+                _pendingPlayerUpdates[userId] = update;
+                if (_playerUpdateFlushScheduled)
+                {
+                    return;
+                }
+                _playerUpdateFlushScheduled = true;
+            }
+            var _ = Task.Delay(PlayerUpdateBatchDelay).ContinueWith(t => FlushPlayerUpdates());
+        }
+
+        // Sends the pending roster changes to every player, as a single batch.
+        private void FlushPlayerUpdates()
+        {
+            lock (_playerUpdatesLock)
+            {
+                _playerUpdateFlushScheduled = false;
+                if (_pendingPlayerUpdates.Count == 0)
+                {
+                    return;
+                }
+                var batch = new PlayerUpdateBatch { Sequence = ++_playerUpdateSequence, Updates = _pendingPlayerUpdates.Values.ToList() };
+                _pendingPlayerUpdates.Clear();
+                // Sent under the lock, so that batches reach the players in sequence order.
+                foreach (var peer in _scene.RemotePeers)
+                {
+                    SendPlayerUpdates(peer, batch);
+                }
+            }
+        }
+
+        // Must be called under _playerUpdatesLock.
+        private void SendPlayerUpdates(IScenePeerClient peer, PlayerUpdateBatch batch)
+        {
+            if (_playerUpdateBatchPeers.Contains(peer.SessionId))
+            {
+                peer.Send(PLAYERS_UPDATE_ROUTE, batch, PacketPriority.MEDIUM_PRIORITY, PacketReliability.RELIABLE_ORDERED);
+            }
+            else
+            {
+                // Clients older than update batches only handle "player.update".
+                foreach (var update in batch.Updates)
+                {
+                    peer.Send(PLAYER_UPDATE_ROUTE, update, PacketPriority.MEDIUM_PRIORITY, PacketReliability.RELIABLE_ORDERED);
+                }
+            }
         }
 
         private async Task ReceivedFaulted(Packet<IScenePeerClient> packet)
@@ -443,7 +639,17 @@ namespace Stormancer.Server.GameSession
                 }
                 _analytics.Push("gamesession", "playerJoined", JObject.FromObject(new { userId = userId, gameSessionId = this._scene.Id, sessionId = peer.SessionId }));
                 //Check if the gameSession is Dedicated or listen-server            
-                if (!_serverEnabled)
+                if (!_serverEnabled && _hostElectionEnabled && _hostElectionCompleted == 0 && string.IsNullOrEmpty(_config.HostUserId))
+                {
+                    // The host is sent a "" P2P token once elected.
+                    StartHostElection();
+                    // The report of this player may have arrived before it was connected.
+                    if (AllConnectivityReported())
+                    {
+                        await CompleteHostElection();
+                    }
+                }
+                else if (!_serverEnabled)
                 {
                     // If the host is not defined a P2P was sent with "" to notify client is host.
                     _logger.Log(LogLevel.Trace, "gamesession", $"Gamesession {_scene.Id} evaluating {userId} as host (expected host :{_config.HostUserId})", new { });
@@ -466,15 +672,22 @@ namespace Stormancer.Server.GameSession
 
                 }
 
-                foreach (var uId in _clients.Keys)
+                // The current roster is sent as a single batch. It is sent under the roster lock, so that it is ordered with the broadcast batches.
+                lock (_playerUpdatesLock)
                 {
-                    if (uId != userId)
+                    var roster = new List<PlayerUpdate>();
+                    foreach (var uId in _clients.Keys)
                     {
-                        var currentClient = _clients[uId];
-                        var isHost = GetServerTcs().Task.IsCompleted && GetServerTcs().Task.Result.SessionId == currentClient.Peer.SessionId;
-                        peer.Send("player.update",
-                            new PlayerUpdate { UserId = uId, IsHost = isHost, Status = (byte)currentClient.Status, Data = currentClient.FaultReason ?? "" },
-                            PacketPriority.MEDIUM_PRIORITY, PacketReliability.RELIABLE_ORDERED);
+                        if (uId != userId)
+                        {
+                            var currentClient = _clients[uId];
+                            var isHost = GetServerTcs().Task.IsCompleted && GetServerTcs().Task.Result.SessionId == currentClient.Peer.SessionId;
+                            roster.Add(new PlayerUpdate { UserId = uId, IsHost = isHost, Status = (byte)currentClient.Status, Data = currentClient.FaultReason ?? "", SessionId = currentClient.Peer?.SessionId ?? "" });
+                        }
+                    }
+                    if (roster.Count > 0)
+                    {
+                        SendPlayerUpdates(peer, new PlayerUpdateBatch { Sequence = _playerUpdateSequence, Updates = roster });
                     }
                 }
                 if (_status == ServerStatus.Started)
@@ -697,7 +910,8 @@ namespace Stormancer.Server.GameSession
         }
         public async Task PeerDisconnecting(IScenePeerClient peer)
         {
-            if (IsHost(peer.SessionId))
+            var wasHost = IsHost(peer.SessionId);
+            if (wasHost)
             {
                 lock (_lock)
                 {
@@ -709,6 +923,19 @@ namespace Stormancer.Server.GameSession
                 throw new ArgumentNullException("peer");
             }
             var user = RemoveUserId(peer);
+            lock (_playerUpdatesLock)
+            {
+                _playerUpdateBatchPeers.Remove(peer.SessionId);
+            }
+            _connectivityProbes.TryRemove(peer.SessionId, out _);
+            if (user != null && _resultUploads.TryRemove(user, out var resultUpload))
+            {
+                resultUpload.Dispose();
+            }
+            foreach (var link in _meshLinks.Keys.Where(k => k.Split('|').Contains(peer.SessionId)).ToList())
+            {
+                _meshLinks.TryRemove(link, out _);
+            }
             _analytics.Push("gamesession", "playerLeft", JObject.FromObject(new { sessionId = peer.SessionId, gameSessionId = this._scene.Id }));
             Client client = null;
             string userId = null;
@@ -740,6 +967,11 @@ namespace Stormancer.Server.GameSession
                 await EvaluateGameComplete();
             }
 
+            if (wasHost && !_serverEnabled)
+            {
+                MigrateHost(userId);
+            }
+
             if (_shutdownMode == ShutdownMode.NoPlayerLeft)
             {
                 if (!_clients.Values.Any(c => c.Status != PlayerStatus.Disconnected))
@@ -756,6 +988,36 @@ namespace Stormancer.Server.GameSession
             }
         }
 
+        // Elects a new host among the players still connected, so that the session survives the departure of a P2P host.
+        // Clients re-establish their P2P connection with the new host when they receive the HOST_CHANGED_ROUTE message.
+        private void MigrateHost(string previousHostUserId)
+        {
+            var candidates = _clients
+                .Where(kvp => kvp.Key != previousHostUserId && kvp.Value.Peer != null && (kvp.Value.Status == PlayerStatus.Connected || kvp.Value.Status == PlayerStatus.Ready))
+                .ToDictionary(kvp => kvp.Key, kvp => kvp.Value.Connectivity);
+            if (!candidates.Any())
+            {
+                _logger.Log(LogLevel.Info, LOG_CATEOGRY, "Host left the game session and no player is available to replace it", new { gameSessionId = _scene.Id, previousHost = previousHostUserId });
+                return;
+            }
+
+            var newHostUserId = HostElection.Elect(candidates).UserId;
+            var newHost = _clients[newHostUserId];
+            lock (_lock)
+            {
+                _config.HostUserId = newHostUserId;
+                _p2pToken = null;
+                GetServerTcs().TrySetResult(newHost.Peer);
+            }
+
+            _logger.Log(LogLevel.Info, LOG_CATEOGRY, "Host migrated", new { gameSessionId = _scene.Id, previousHost = previousHostUserId, newHost = newHostUserId });
+            _analytics.Push("gamesession", "hostMigrated", JObject.FromObject(new { gameSessionId = _scene.Id, previousHost = previousHostUserId, newHost = newHostUserId }));
+
+            BroadcastClientUpdate(newHost, newHostUserId);
+            FlushPlayerUpdates();
+            _scene.Broadcast(HOST_CHANGED_ROUTE, newHostUserId, PacketPriority.IMMEDIATE_PRIORITY, PacketReliability.RELIABLE_ORDERED);
+        }
+
         private async Task CloseGameServerProcess()
         {
             if (_gameServerProcess != null && !_gameServerProcess.HasExited)
@@ -845,6 +1107,58 @@ namespace Stormancer.Server.GameSession
             }
         }
 
+        public async Task<ResultUploadStatus> BeginResultUpload(IScenePeerClient remotePeer)
+        {
+            var userId = await GetUserId(remotePeer);
+            if (userId == null)
+            {
+                throw new ClientException("unauthorized?reason=publicGame");
+            }
+
+            // Starting a new upload abandons the previous one of the player.
+            var upload = new ResultUpload(userId);
+            ResultUpload previous = null;
+            _resultUploads.AddOrUpdate(userId, upload, (_, current) =>
+            {
+                previous = current;
+                return upload;
+            });
+            previous?.Dispose();
+            return new ResultUploadStatus { UploadId = upload.Id };
+        }
+
+        public async Task<int> PostResultChunk(string uploadId, int index, byte[] data, IScenePeerClient remotePeer)
+        {
+            var upload = await GetResultUpload(uploadId, remotePeer);
+            return upload.AddChunk(index, data);
+        }
+
+        public async Task<Action<Stream, ISerializer>> CompleteResultUpload(string uploadId, int chunkCount, bool compressed, IScenePeerClient remotePeer)
+        {
+            var upload = await GetResultUpload(uploadId, remotePeer);
+            var stream = upload.Complete(chunkCount, compressed);
+            ((ICollection<KeyValuePair<string, ResultUpload>>)_resultUploads).Remove(new KeyValuePair<string, ResultUpload>(upload.UserId, upload));
+            try
+            {
+                return await PostResults(stream, remotePeer);
+            }
+            finally
+            {
+                stream.Dispose();
+                upload.Dispose();
+            }
+        }
+
+        private async Task<ResultUpload> GetResultUpload(string uploadId, IScenePeerClient remotePeer)
+        {
+            var userId = await GetUserId(remotePeer);
+            if (uploadId == null || userId == null || !_resultUploads.TryGetValue(userId, out var upload) || upload.Id != uploadId)
+            {
+                throw new ClientException("resultUpload.notFound");
+            }
+            return upload;
+        }
+
         private async Task EvaluateGameComplete(Stream inputStream)
         {
             await CloseGameServerProcess();
@@ -912,6 +1226,33 @@ namespace Stormancer.Server.GameSession
 
         }
 
+        public async Task<List<MeshPeerToken>> CreateMeshP2PTokens(string sessionId)
+        {
+            var hostPeer = await GetServerTcs().Task;
+            var tokens = new List<MeshPeerToken>();
+            foreach (var kvp in _clients)
+            {
+                var peer = kvp.Value.Peer;
+                if (peer == null || peer.SessionId == sessionId || peer.SessionId == hostPeer.SessionId)
+                {
+                    continue;
+                }
+
+                // Only one player of each pair opens the link, whichever asks first.
+                var link = string.CompareOrdinal(sessionId, peer.SessionId) < 0 ? $"{sessionId}|{peer.SessionId}" : $"{peer.SessionId}|{sessionId}";
+                if (_meshLinks.TryAdd(link, true))
+                {
+                    tokens.Add(new MeshPeerToken
+                    {
+                        UserId = kvp.Key,
+                        SessionId = peer.SessionId,
+                        P2PToken = await _scene.DependencyResolver.Resolve<IPeerInfosService>().CreateP2pToken(peer.SessionId, _scene.Id)
+                    });
+                }
+            }
+            return tokens;
+        }
+
         public async Task UpdateShutdownMode(ShutdownModeParameters shutdown)
         {
 
@@ -925,6 +1266,11 @@ namespace Stormancer.Server.GameSession
 
         }
 
+        public ulong ReceiveProbe(string sessionId, ulong challenge, int payloadSize)
+        {
+            return _connectivityProbes.GetOrAdd(sessionId, _ => new ConnectivityProbe()).Receive(challenge, payloadSize);
+        }
+
         public bool IsHost(string sessionId)
         {
 
@@ -938,6 +1284,11 @@ namespace Stormancer.Server.GameSession
 
         public void Dispose()
         {
+            foreach (var upload in _resultUploads.Values)
+            {
+                upload.Dispose();
+            }
+            _resultUploads.Clear();
             CloseGameServerProcess().Wait();
         }
 
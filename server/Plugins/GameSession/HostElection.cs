@@ -0,0 +1,158 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+using Stormancer.Server.GameFinder.Default;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace Stormancer.Server.GameSession
+{
+    /// <summary>
+    /// Scores the players of a P2P game session as host candidates, from the connectivity they reported.
+    /// </summary>
+    /// <remarks>
+    /// Scores are expressed in milliseconds, lower is better: the expected round-trip time from the candidate to the other players,
+    /// plus penalties for NAT types that prevent direct connections and for upload throughputs too low to serve every player.
+    /// Players who sent no report, or a report rejected by <see cref="Bound"/>, are scored with unknown values, so that a measured candidate is preferred.
+    /// </remarks>
+    public static class HostElection
+    {
+        /// <summary>
+        /// Upload throughput a host needs for each other player, in kbit/s.
+        /// </summary>
+        public const uint RequiredKbpsPerPlayer = 256;
+
+        private const double UnknownUploadPenalty = 50;
+        private const double InsufficientUploadPenalty = 200;
+
+        /// <summary>
+        /// Key of the round-trip time to the game session server in <see cref="ConnectivityReport.Latencies"/>.
+        /// </summary>
+        public const string ServerLatencyKey = "server";
+        private const double MinRttRatio = 0.5;
+        private const double RttTolerance = 10;
+        private const double MaxUploadRatio = 2;
+
+        private static double NatPenalty(NatType natType)
+        {
+            switch (natType)
+            {
+                case NatType.Open:
+                    return 0;
+                case NatType.Moderate:
+                    return 30;
+                case NatType.Strict:
+                    return 200;
+                default:
+                    return 60;
+            }
+        }
+
+        private static double UploadPenalty(uint uploadKbps, int otherPlayers)
+        {
+            if (otherPlayers == 0)
+            {
+                return 0;
+            }
+            if (uploadKbps == 0)
+            {
+                return UnknownUploadPenalty;
+            }
+            var required = (double)RequiredKbpsPerPlayer * otherPlayers;
+            return uploadKbps >= required ? 0 : InsufficientUploadPenalty * (1 - uploadKbps / required);
+        }
+
+        /// <summary>
+        /// Bounds a self-declared report by the measures of the server. Returns null if the report is implausible.
+        /// </summary>
+        /// <remarks>
+        /// The server measures a round-trip time at least as long as the actual one, and a transfer time of the upload probe at least as long as the actual one.
+        /// A report claiming a round-trip time to the server under half the measured one, or an upload throughput over twice the measured one, is rejected.
+        /// Otherwise, the round-trip time to the server is raised to the measured one, the other round-trip times are raised in the same proportion
+        /// (the server cannot measure them, but they were timed by the same client), and the upload throughput is capped to the measured one.
+        /// </remarks>
+        /// <param name="probe">Probes of the player timed by the server, null if it sent none.</param>
+        /// <param name="reason">Why the report was rejected.</param>
+        public static ConnectivityReport Bound(ConnectivityReport report, ConnectivityProbe probe, out string reason)
+        {
+            var measuredRtt = probe?.RoundTripTime;
+            if (measuredRtt == null)
+            {
+                reason = "the server did not time any probe of the player";
+                return null;
+            }
+            var measuredMs = measuredRtt.Value.TotalMilliseconds;
+            var reportedLatencies = report.Latencies ?? new Dictionary<string, ushort>();
+            var reportedMs = reportedLatencies.TryGetValue(ServerLatencyKey, out var serverLatency) ? serverLatency : measuredMs;
+            if (reportedMs < measuredMs * MinRttRatio - RttTolerance)
+            {
+                reason = $"reported a round-trip time to the server of {reportedMs} ms, measured {measuredMs:F0} ms";
+                return null;
+            }
+            var maxUploadKbps = probe.MaxUploadKbps ?? 0;
+            if (report.UploadKbps > (double)maxUploadKbps * MaxUploadRatio)
+            {
+                reason = $"reported an upload throughput of {report.UploadKbps} kbit/s, measured {maxUploadKbps} kbit/s";
+                return null;
+            }
+
+            var scale = reportedMs < measuredMs ? measuredMs / Math.Max(reportedMs, 1) : 1;
+            var latencies = reportedLatencies
+                .Where(kvp => kvp.Key != ServerLatencyKey)
+                .ToDictionary(kvp => kvp.Key, kvp => (ushort)Math.Min(Math.Round(kvp.Value * scale), ushort.MaxValue));
+            latencies[ServerLatencyKey] = (ushort)Math.Min(Math.Round(Math.Max(reportedMs, measuredMs)), ushort.MaxValue);
+            reason = null;
+            return new ConnectivityReport
+            {
+                UploadKbps = Math.Min(report.UploadKbps, maxUploadKbps),
+                NatType = report.NatType,
+                Latencies = latencies
+            };
+        }
+
+        /// <summary>
+        /// Score of a candidate. The reports are declared by the players: bound them with <see cref="Bound"/> first.
+        /// </summary>
+        public static double Score(string candidate, IReadOnlyDictionary<string, ConnectivityReport> reports)
+        {
+            var report = reports[candidate] ?? new ConnectivityReport();
+            var others = reports.Where(kvp => kvp.Key != candidate).Select(kvp => kvp.Value ?? new ConnectivityReport()).ToList();
+            var expectedRtt = others.Any()
+                ? others.Average(other => (double)(LatencyMatching.EstimateRtt(report.Latencies, other.Latencies) ?? LatencyMatching.UnknownRtt))
+                : 0;
+            return expectedRtt + NatPenalty(report.NatType) + UploadPenalty(report.UploadKbps, others.Count);
+        }
+
+        /// <summary>
+        /// Select the candidate with the lowest score. Ties are broken by user id, so that the result is deterministic.
+        /// </summary>
+        /// <param name="reports">Reports of the candidates by user id, null for the players who did not send one.</param>
+        public static (string UserId, double Score) Elect(IReadOnlyDictionary<string, ConnectivityReport> reports)
+        {
+            return reports.Keys
+                .Select(userId => (UserId: userId, Score: Score(userId, reports)))
+                .OrderBy(c => c.Score)
+                .ThenBy(c => c.UserId, StringComparer.Ordinal)
+                .FirstOrDefault();
+        }
+    }
+}
@@ -21,6 +21,7 @@
 // SOFTWARE.
 using System;
 using System.Collections.Concurrent;
+using System.Collections.Generic;
 using System.IO;
 using System.Threading.Tasks;
 using Stormancer.Server.GameSession.Models;
@@ -32,16 +33,27 @@ namespace Stormancer.Server.GameSession
     {
         void SetConfiguration(dynamic metadata);
         Task<Action<Stream,ISerializer>> PostResults(Stream inputStream, IScenePeerClient remotePeer);
+
+        Task<ResultUploadStatus> BeginResultUpload(IScenePeerClient remotePeer);
+        Task<int> PostResultChunk(string uploadId, int index, byte[] data, IScenePeerClient remotePeer);
+        Task<Action<Stream, ISerializer>> CompleteResultUpload(string uploadId, int chunkCount, bool compressed, IScenePeerClient remotePeer);
         Task UpdateShutdownMode(ShutdownModeParameters shutdown);
         Task Reset();
         GameSessionConfigurationDto GetGameSessionConfig();
 
         Task<string> CreateP2PToken(string sessionId);
 
+        Task<List<MeshPeerToken>> CreateMeshP2PTokens(string sessionId);
+
         Task TryStart();
 
         bool IsHost(string sessionId);
 
+        /// <summary>
+        /// Times a connectivity probe of a peer. Returns the challenge its next probe must echo.
+        /// </summary>
+        ulong ReceiveProbe(string sessionId, ulong challenge, int payloadSize);
+
         Task<BearerTokenData> DecodeBearerToken(string token);
     }
 }
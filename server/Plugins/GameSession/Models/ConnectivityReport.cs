@@ -0,0 +1,55 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+using MsgPack.Serialization;
+using System.Collections.Generic;
+
+namespace Stormancer.Server.GameSession
+{
+    public enum NatType : byte
+    {
+        Unknown = 0,
+        Open = 1,
+        Moderate = 2,
+        Strict = 3
+    }
+
+    /// <summary>
+    /// Connectivity measured by a player when joining a game session, used to elect the P2P host.
+    /// </summary>
+    public class ConnectivityReport
+    {
+        /// <summary>
+        /// Upload throughput to the server, in kbit/s. 0 if it could not be measured.
+        /// </summary>
+        [MessagePackMember(0)]
+        public uint UploadKbps { get; set; }
+
+        [MessagePackMember(1)]
+        public NatType NatType { get; set; }
+
+        /// <summary>
+        /// Round-trip times to the server and to the endpoints probed by the client, in milliseconds, by endpoint id.
+        /// </summary>
+        [MessagePackMember(2)]
+        public Dictionary<string, ushort> Latencies { get; set; } = new Dictionary<string, ushort>();
+    }
+}
@@ -0,0 +1,196 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.Compression;
+using Stormancer.Plugins;
+
+namespace Stormancer.Server.GameSession
+{
+    /// <summary>
+    /// Game result uploaded in chunks by a player, stored in a temporary file until it is complete.
+    /// </summary>
+    /// <remarks>
+    /// Chunks can arrive out of order or more than once, when the client retries them: chunks ahead of the next expected one are kept in memory
+    /// (the client bounds their number), and chunks already written are ignored.
+    /// The size of the chunks, of the upload and of the decompressed result are bounded, whatever the client sends.
+    /// </remarks>
+    internal class ResultUpload : IDisposable
+    {
+        private const int MaxPendingChunks = 64;
+        public const int MaxChunkSize = 1024 * 1024;
+        public const long MaxUploadSize = 64L * 1024 * 1024;
+        public const long MaxResultSize = 256L * 1024 * 1024;
+
+        private readonly object _lock = new object();
+        private readonly FileStream _file;
+        private readonly SortedDictionary<int, byte[]> _pendingChunks = new SortedDictionary<int, byte[]>();
+        private int _receivedChunks;
+        // Bytes written to the file or pending in memory.
+        private long _size;
+        private bool _disposed;
+
+        public ResultUpload(string userId)
+        {
+            Id = Guid.NewGuid().ToString("N");
+            UserId = userId;
+            _file = new FileStream(Path.GetTempFileName(), FileMode.Create, FileAccess.ReadWrite, FileShare.None, 4096, FileOptions.DeleteOnClose);
+        }
+
+        public string Id { get; }
+
+        public string UserId { get; }
+
+        /// <summary>
+        /// Number of chunks received without gap since the start of the upload.
+        /// </summary>
+        public int ReceivedChunks
+        {
+            get
+            {
+                lock (_lock)
+                {
+                    return _receivedChunks;
+                }
+            }
+        }
+
+        public int AddChunk(int index, byte[] data)
+        {
+            if (data == null || data.Length > MaxChunkSize)
+            {
+                throw new ClientException($"resultUpload.chunkTooLarge?max={MaxChunkSize}");
+            }
+            lock (_lock)
+            {
+                if (_disposed)
+                {
+                    throw new ClientException("resultUpload.notFound");
+                }
+                if (index < _receivedChunks || _pendingChunks.ContainsKey(index))
+                {
+                    return _receivedChunks;
+                }
+                if (_size + data.Length > MaxUploadSize)
+                {
+                    throw new ClientException($"resultUpload.tooLarge?max={MaxUploadSize}");
+                }
+                _size += data.Length;
+                if (index > _receivedChunks)
+                {
+                    if (_pendingChunks.Count >= MaxPendingChunks)
+                    {
+                        throw new ClientException("resultUpload.tooManyPendingChunks");
+                    }
+                    _pendingChunks.Add(index, data);
+                    return _receivedChunks;
+                }
+
+                _file.Write(data, 0, data.Length);
+                _receivedChunks++;
+                while (_pendingChunks.TryGetValue(_receivedChunks, out var next))
+                {
+                    _pendingChunks.Remove(_receivedChunks);
+                    _file.Write(next, 0, next.Length);
+                    _receivedChunks++;
+                }
+                return _receivedChunks;
+            }
+        }
+
+        /// <summary>
+        /// Get the uploaded result, once every chunk has been received.
+        /// </summary>
+        public Stream Complete(int chunkCount, bool compressed)
+        {
+            lock (_lock)
+            {
+                if (_receivedChunks != chunkCount)
+                {
+                    throw new ClientException($"resultUpload.incomplete?received={_receivedChunks}&expected={chunkCount}");
+                }
+                _file.Flush();
+                _file.Position = 0;
+                return compressed ? new LimitedReadStream(new DeflateStream(_file, CompressionMode.Decompress, true), MaxResultSize) : (Stream)_file;
+            }
+        }
+
+        public void Dispose()
+        {
+            lock (_lock)
+            {
+                _disposed = true;
+                _pendingChunks.Clear();
+                _file.Dispose();
+            }
+        }
+
+        // Fails the read that goes past the limit, so that a small upload cannot decompress into an unbounded result.
+        private class LimitedReadStream : Stream
+        {
+            private readonly Stream _inner;
+            private readonly long _limit;
+            private long _read;
+
+            public LimitedReadStream(Stream inner, long limit)
+            {
+                _inner = inner;
+                _limit = limit;
+            }
+
+            public override bool CanRead => true;
+            public override bool CanSeek => false;
+            public override bool CanWrite => false;
+            public override long Length => throw new NotSupportedException();
+            public override long Position { get => _read; set => throw new NotSupportedException(); }
+
+            public override int Read(byte[] buffer, int offset, int count)
+            {
+                var read = _inner.Read(buffer, offset, count);
+                _read += read;
+                if (_read > _limit)
+                {
+                    throw new ClientException($"resultUpload.resultTooLarge?max={_limit}");
+                }
+                return read;
+            }
+
+            public override void Flush()
+            {
+            }
+
+            public override long Seek(long offset, SeekOrigin origin) => throw new NotSupportedException();
+            public override void SetLength(long value) => throw new NotSupportedException();
+            public override void Write(byte[] buffer, int offset, int count) => throw new NotSupportedException();
+
+            protected override void Dispose(bool disposing)
+            {
+                if (disposing)
+                {
+                    _inner.Dispose();
+                }
+                base.Dispose(disposing);
+            }
+        }
+    }
+}
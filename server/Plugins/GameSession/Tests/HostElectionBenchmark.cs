@@ -0,0 +1,182 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Round-trip times between the host and the other players of P2P game sessions, with a host picked at random and with the host elected by HostElection.Elect().
+//
+// Not part of the server application (p2p.server.csproj does not compile it). Build it as a console application (net48 or later) with MsgPack.Cli and:
+//   Plugins/GameSession/Tests/HostElectionBenchmark.cs, Plugins/GameSession/HostElection.cs, Plugins/GameSession/ConnectivityProbe.cs, Plugins/GameSession/Models/ConnectivityReport.cs,
+//   Plugins/GameFinder/Default/LatencyMatching.cs, Plugins/GameFinder/Models/Player.cs
+// Usage: host-election-benchmark [games] [seed]
+//
+// The benchmark runs offline, on a simulated network. Players are spread over a map 100 ms wide (one-way) and add an access delay of 2 to 40 ms.
+// Each of them reports, as the client does, its NAT type, its upload throughput, and its round-trip times (with 10% jitter) to the server
+// and to four regional relays. The actual round-trip time from the host to a player is the direct path between them, or the path through the
+// server when NAT traversal fails between them (a strict NAT, unless the other peer is open).
+// For 4, 8 and 16 players per game, it reports the mean and 95th percentile of the actual host round-trip time over <games> games,
+// the share of hosts whose upload cannot serve every player, and the time taken by Elect().
+// Returns 1 if the elected hosts have a higher mean round-trip time than the random ones.
+
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+
+namespace Stormancer.Server.GameSession.Tests
+{
+    public static class HostElectionBenchmark
+    {
+        private const double MapSize = 100;
+        private const string Server = HostElection.ServerLatencyKey;
+
+        private class SimulatedPlayer
+        {
+            public string UserId;
+            public double X;
+            public double Y;
+            public double Access;
+            public NatType NatType;
+            public uint UploadKbps;
+        }
+
+        private class Endpoint
+        {
+            public string Id;
+            public double X;
+            public double Y;
+        }
+
+        private static readonly Endpoint[] Endpoints =
+        {
+            new Endpoint { Id = Server, X = 50, Y = 50 },
+            new Endpoint { Id = "relay-nw", X = 20, Y = 20 },
+            new Endpoint { Id = "relay-ne", X = 80, Y = 20 },
+            new Endpoint { Id = "relay-sw", X = 20, Y = 80 },
+            new Endpoint { Id = "relay-se", X = 80, Y = 80 },
+        };
+
+        private static double Distance(double x1, double y1, double x2, double y2)
+        {
+            return Math.Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
+        }
+
+        private static double RttToEndpoint(SimulatedPlayer player, Endpoint endpoint)
+        {
+            return 2 * (Distance(player.X, player.Y, endpoint.X, endpoint.Y) + player.Access);
+        }
+
+        private static bool CanConnectDirectly(SimulatedPlayer a, SimulatedPlayer b)
+        {
+            return !(a.NatType == NatType.Strict && b.NatType != NatType.Open) && !(b.NatType == NatType.Strict && a.NatType != NatType.Open);
+        }
+
+        // Actual round-trip time between the host and a player.
+        private static double ActualRtt(SimulatedPlayer host, SimulatedPlayer player)
+        {
+            if (CanConnectDirectly(host, player))
+            {
+                return 2 * (Distance(host.X, host.Y, player.X, player.Y) + host.Access + player.Access);
+            }
+            return RttToEndpoint(host, Endpoints[0]) + RttToEndpoint(player, Endpoints[0]);
+        }
+
+        private static double MeanHostRtt(SimulatedPlayer host, List<SimulatedPlayer> players)
+        {
+            return players.Where(p => p != host).Average(p => ActualRtt(host, p));
+        }
+
+        private static SimulatedPlayer CreatePlayer(Random random, int index)
+        {
+            var nat = random.NextDouble();
+            return new SimulatedPlayer
+            {
+                UserId = "user-" + index,
+                X = random.NextDouble() * MapSize,
+                Y = random.NextDouble() * MapSize,
+                Access = 2 + random.NextDouble() * 38,
+                NatType = nat < 0.4 ? NatType.Open : nat < 0.8 ? NatType.Moderate : NatType.Strict,
+                // 1 to 20 Mbit/s.
+                UploadKbps = (uint)(1000 + random.Next(19000)),
+            };
+        }
+
+        private static ConnectivityReport Report(Random random, SimulatedPlayer player)
+        {
+            return new ConnectivityReport
+            {
+                UploadKbps = player.UploadKbps,
+                NatType = player.NatType,
+                Latencies = Endpoints.ToDictionary(e => e.Id, e => (ushort)Math.Ceiling(RttToEndpoint(player, e) * (0.9 + random.NextDouble() * 0.2))),
+            };
+        }
+
+        private static double Percentile(List<double> sorted, double percentile)
+        {
+            return sorted[Math.Min(sorted.Count - 1, (int)(sorted.Count * percentile))];
+        }
+
+        public static int Main(string[] args)
+        {
+            var games = args.Length > 0 ? int.Parse(args[0]) : 2000;
+            var random = new Random(args.Length > 1 ? int.Parse(args[1]) : 1);
+            var ok = true;
+
+            Console.WriteLine($"{games} games per size");
+            Console.WriteLine("players  host      mean RTT   p95 RTT   insufficient upload   Elect()");
+            foreach (var playersPerGame in new[] { 4, 8, 16 })
+            {
+                var randomRtts = new List<double>();
+                var electedRtts = new List<double>();
+                var randomUnderpowered = 0;
+                var electedUnderpowered = 0;
+                var electionTime = new Stopwatch();
+                for (var game = 0; game < games; game++)
+                {
+                    var players = Enumerable.Range(0, playersPerGame).Select(i => CreatePlayer(random, i)).ToList();
+                    var reports = players.ToDictionary(p => p.UserId, p => Report(random, p));
+
+                    var randomHost = players[random.Next(players.Count)];
+                    electionTime.Start();
+                    var elected = HostElection.Elect(reports);
+                    electionTime.Stop();
+                    var electedHost = players.First(p => p.UserId == elected.UserId);
+
+                    randomRtts.Add(MeanHostRtt(randomHost, players));
+                    electedRtts.Add(MeanHostRtt(electedHost, players));
+                    var required = HostElection.RequiredKbpsPerPlayer * (uint)(playersPerGame - 1);
+                    randomUnderpowered += randomHost.UploadKbps < required ? 1 : 0;
+                    electedUnderpowered += electedHost.UploadKbps < required ? 1 : 0;
+                }
+                randomRtts.Sort();
+                electedRtts.Sort();
+                var electionUs = electionTime.Elapsed.TotalMilliseconds * 1000 / games;
+                Console.WriteLine($"{playersPerGame,7}  random  {randomRtts.Average(),8:F1} ms {Percentile(randomRtts, 0.95),7:F1} ms {100.0 * randomUnderpowered / games,19:F1}%");
+                Console.WriteLine($"{playersPerGame,7}  elected {electedRtts.Average(),8:F1} ms {Percentile(electedRtts, 0.95),7:F1} ms {100.0 * electedUnderpowered / games,19:F1}%   {electionUs,6:F1} us");
+                if (electedRtts.Average() > randomRtts.Average())
+                {
+                    Console.WriteLine($"FAIL the elected hosts of {playersPerGame}-player games have a higher round-trip time than random ones");
+                    ok = false;
+                }
+            }
+            return ok ? 0 : 1;
+        }
+    }
+}
@@ -25,8 +25,10 @@ using Stormancer.Core;
 using Stormancer.Plugins;
 using System;
 using System.Collections.Generic;
+using System.IO;
 using System.Linq;
 using System.Text;
+using System.Threading;
 using System.Threading.Tasks;
 using Stormancer.Diagnostics;
 using System.Reactive.Linq;
@@ -35,16 +37,22 @@ namespace Stormancer.Server.Users
 {
     public class AuthenticationController : ControllerBase
     {
+        /// <summary>
+        /// Maximum number of recipients of a sendRequests call.
+        /// </summary>
+        public const int MaxRequestRecipients = 100;
 
         private readonly IAuthenticationService _auth;
+        private readonly ResumptionTickets _tickets;
         private readonly IUserSessions sessions;
         private readonly RpcService rpc;
         private readonly ILogger logger;
 
-        public AuthenticationController(IAuthenticationService auth, IUserSessions sessions, RpcService rpc, ILogger logger)
+        public AuthenticationController(IAuthenticationService auth, ResumptionTickets tickets, IUserSessions sessions, RpcService rpc, ILogger logger)
         {
 
             _auth = auth;
+            _tickets = tickets;
             this.sessions = sessions;
             this.rpc = rpc;
             this.logger = logger;
@@ -65,6 +73,15 @@ namespace Stormancer.Server.Users
             return _auth.GetMetadata();
         }
 
+        /// <summary>
+        /// Get the metadata, unless it has the version the client has in cache.
+        /// </summary>
+        [Api(ApiAccess.Public, ApiType.Rpc)]
+        public CachedAuthenticationData GetMetadataIfModified(string eTag)
+        {
+            return CachedAuthenticationData.Create(_auth.GetMetadata(), eTag);
+        }
+
         [Api(ApiAccess.Public, ApiType.Rpc)]
         public async Task Register(AuthParameters ctx)
         {
@@ -77,6 +94,16 @@ namespace Stormancer.Server.Users
             return await _auth.Login(parameters, this.Request.RemotePeer, this.Request.CancellationToken);
         }
 
+        /// <summary>
+        /// Revoke the resumption ticket of the session, called by the client when the user logs out.
+        /// </summary>
+        [Api(ApiAccess.Public, ApiType.Rpc)]
+        public Task RevokeResumptionTickets()
+        {
+            _tickets.Revoke(this.Request.RemotePeer.SessionId);
+            return Task.CompletedTask;
+        }
+
         [Api(ApiAccess.Public, ApiType.Rpc)]
         public async Task RememberDeviceForTwoFactor(RememberDeviceParameters parameters)
         {
@@ -86,6 +113,15 @@ namespace Stormancer.Server.Users
         [Api(ApiAccess.Public, ApiType.Rpc)]
         public Task<Dictionary<string, string>> GetStatus() => _auth.GetStatus((IScenePeerClient)this.Peer);
 
+        /// <summary>
+        /// Get the status, unless it has the version the client has in cache.
+        /// </summary>
+        [Api(ApiAccess.Public, ApiType.Rpc)]
+        public async Task<CachedAuthenticationData> GetStatusIfModified(string eTag)
+        {
+            return CachedAuthenticationData.Create(await _auth.GetStatus((IScenePeerClient)this.Peer), eTag);
+        }
+
         [Api(ApiAccess.Public, ApiType.Rpc)]
         public async Task Unlink(string type)
         {
@@ -141,6 +177,83 @@ namespace Stormancer.Server.Users
                 }
             }
         }
+
+        /// <summary>
+        /// Send the same request to several users in a single call.
+        /// </summary>
+        /// <remarks>
+        /// Arguments: the ids of the recipients, then the operation and its arguments, as with sendRequest.
+        /// Requests are sent concurrently, and the call completes when every recipient has answered, with one result per recipient:
+        /// a failing recipient does not fail the others.
+        /// A batch is limited to MaxRequestRecipients distinct recipients.
+        /// </remarks>
+        [Api(ApiAccess.Public, ApiType.Rpc, Route = "sendRequests")]
+        public async Task SendRequests(RequestContext<IScenePeerClient> ctx)
+        {
+            var serializer = ctx.RemotePeer.Serializer();
+            var userIds = serializer.Deserialize<List<string>>(ctx.InputStream).Distinct().ToList();
+            if (userIds.Count > MaxRequestRecipients)
+            {
+                throw new ClientException($"tooManyRecipients?max={MaxRequestRecipients}");
+            }
+            var sender = await sessions.GetUser(ctx.RemotePeer);
+
+            // The operation and its arguments are forwarded as is to every recipient.
+            byte[] request;
+            using (var stream = new MemoryStream())
+            {
+                ctx.InputStream.CopyTo(stream);
+                request = stream.ToArray();
+            }
+
+            var results = await Task.WhenAll(userIds.Select(userId => SendRequestToUser(sender.Id, userId, request, ctx.CancellationToken)));
+            await ctx.SendValue(s => serializer.Serialize(results.ToList(), s));
+        }
+
+        private async Task<UserRequestResult> SendRequestToUser(string senderId, string userId, byte[] request, CancellationToken cancellationToken)
+        {
+            var result = new UserRequestResult { UserId = userId };
+            var peer = await sessions.GetPeer(userId);
+            if (peer == null)
+            {
+                result.Error = $"userDisconnected?id={userId}";
+                return result;
+            }
+
+            var tcs = new TaskCompletionSource<bool>();
+            var disposable = rpc.Rpc("sendRequest", peer, s =>
+            {
+                peer.Serializer().Serialize(senderId, s);
+                s.Write(request, 0, request.Length);
+            }, PacketPriority.MEDIUM_PRIORITY)
+                .Subscribe(
+                    _ => { },
+                    (error) => tcs.TrySetException(error),
+                    () => tcs.TrySetResult(true)
+                );
+
+            using (cancellationToken.Register(() =>
+            {
+                disposable.Dispose();
+                tcs.TrySetCanceled();
+            }))
+            {
+                try
+                {
+                    await tcs.Task;
+                    result.Success = true;
+                }
+                catch (TaskCanceledException ex)
+                {
+                    result.Error = ex.Message == "Peer disconnected" ? $"userDisconnected?id={userId}" : "requestCanceled";
+                }
+                catch (Exception ex)
+                {
+                    result.Error = ex.Message;
+                }
+            }
+            return result;
+        }
     }
 }
 
@@ -43,6 +43,7 @@ namespace Stormancer.Server.Users
         private readonly IUserSessions _sessions;
         private readonly Func<IEnumerable<IAuthenticationEventHandler>> _handlers;
         private readonly ISceneHost _scene;
+        private readonly ResumptionTickets _tickets;
 
         // Client RPC
         private const string RenewCredentialsRoute = "users.renewCredentials";
@@ -54,7 +55,8 @@ namespace Stormancer.Server.Users
             IUserService users,
             IUserSessions sessions,
             ILogger logger,
-            ISceneHost scene
+            ISceneHost scene,
+            ResumptionTickets tickets
             )
         {
             _config = config;
@@ -64,6 +66,7 @@ namespace Stormancer.Server.Users
             _sessions = sessions;
             _handlers = handlers;
             _scene = scene;
+            _tickets = tickets;
         }
 
         private void ApplyConfig(IConfiguration config)
@@ -159,6 +162,7 @@ namespace Stormancer.Server.Users
                     result.Username = authResult.Username;
                     session = await sessions.GetSessionRecordById(peer.SessionId);
                     result.Authentications = session.Authentications.ToDictionary(entry => entry.Key, entry => entry.Value);
+                    result.ResumptionTicket = _tickets.Issue(session);
                     var ctx = new LoggedInCtx { Result = result, Session = session };
                     await _handlers().RunEventHandler(h => h.OnLoggedIn(ctx), ex => _logger.Log(LogLevel.Error, "user.login", "An error occured while running OnLoggedIn event handler", ex));
 
@@ -24,6 +24,7 @@ using MsgPack.Serialization;
 using System;
 using System.Collections.Generic;
 using System.Linq;
+using System.Security.Cryptography;
 using System.Text;
 using System.Threading;
 using System.Threading.Tasks;
@@ -52,6 +53,50 @@ namespace Stormancer.Server.Users
         public string UserDeviceId { get; set; }
     }
 
+    /// <summary>
+    /// Authentication metadata or status, sent only if it changed since the version the client has in cache.
+    /// </summary>
+    public class CachedAuthenticationData
+    {
+        /// <summary>
+        /// Version of the data, computed from its content.
+        /// </summary>
+        [MessagePackMember(0)]
+        public string ETag { get; set; } = "";
+
+        /// <summary>
+        /// False if the data did not change since the version the client sent. <see cref="Data"/> is then empty.
+        /// </summary>
+        [MessagePackMember(1)]
+        public bool Modified { get; set; }
+
+        [MessagePackMember(2)]
+        public Dictionary<string, string> Data { get; set; } = new Dictionary<string, string>();
+
+        public static CachedAuthenticationData Create(Dictionary<string, string> data, string knownETag)
+        {
+            var eTag = ComputeETag(data);
+            if (eTag == knownETag)
+            {
+                return new CachedAuthenticationData { ETag = eTag, Modified = false };
+            }
+            return new CachedAuthenticationData { ETag = eTag, Modified = true, Data = data };
+        }
+
+        private static string ComputeETag(Dictionary<string, string> data)
+        {
+            var builder = new StringBuilder();
+            foreach (var entry in data.OrderBy(entry => entry.Key, StringComparer.Ordinal))
+            {
+                builder.Append(entry.Key.Length).Append(':').Append(entry.Key).Append(entry.Value?.Length ?? -1).Append(':').Append(entry.Value);
+            }
+            using (var sha = SHA256.Create())
+            {
+                return Convert.ToBase64String(sha.ComputeHash(Encoding.UTF8.GetBytes(builder.ToString())), 0, 12);
+            }
+        }
+    }
+
     public interface IAuthenticationService
     {
         Task SetupAuth(AuthParameters auth);
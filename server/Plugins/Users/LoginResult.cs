@@ -45,6 +45,12 @@ namespace Stormancer.Server.Users
 
         [MessagePackMember(4)]
         public Dictionary<string, string> Authentications { get; set; } = new Dictionary<string, string>();
+
+        /// <summary>
+        /// Single-use ticket the client can present to the "resume" provider to authenticate again after a disconnection.
+        /// </summary>
+        [MessagePackMember(5)]
+        public string ResumptionTicket { get; set; } = "";
     }
 }
 
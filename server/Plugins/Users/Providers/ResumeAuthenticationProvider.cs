@@ -0,0 +1,101 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+using System;
+using System.Collections.Generic;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Stormancer.Server.Users
+{
+    /// <summary>
+    /// Authenticates a client again from the resumption ticket it received at its last login.
+    /// </summary>
+    /// <remarks>
+    /// The session gets back the authentications of the session the ticket was issued for.
+    /// </remarks>
+    public class ResumeAuthenticationProvider : IAuthenticationProvider
+    {
+        public const string PROVIDER_NAME = "resume";
+        private readonly ResumptionTickets _tickets;
+        private readonly IUserService _users;
+
+        public string Type => PROVIDER_NAME;
+
+        public ResumeAuthenticationProvider(ResumptionTickets tickets, IUserService users)
+        {
+            _tickets = tickets;
+            _users = users;
+        }
+
+        public void AddMetadata(Dictionary<string, string> result)
+        {
+            result["provider.resume"] = "enabled";
+        }
+
+        public async Task<AuthenticationResult> Authenticate(AuthenticationContext authenticationCtx, CancellationToken ct)
+        {
+            var pId = new PlatformId { Platform = PROVIDER_NAME };
+            if (!authenticationCtx.Parameters.TryGetValue("ticket", out var id) || !_tickets.TryConsume(id, out var ticket))
+            {
+                return AuthenticationResult.CreateFailure("auth.resume.invalidTicket", pId, authenticationCtx.Parameters);
+            }
+
+            var user = await _users.GetUser(ticket.UserId);
+            if (user == null)
+            {
+                return AuthenticationResult.CreateFailure("auth.resume.invalidTicket", pId, authenticationCtx.Parameters);
+            }
+
+            var result = AuthenticationResult.CreateSuccess(user, ticket.PlatformId, authenticationCtx.Parameters);
+            result.OnSessionUpdated = session =>
+            {
+                session.Authentications.TryRemove(PROVIDER_NAME, out _);
+                foreach (var authentication in ticket.Authentications)
+                {
+                    session.Authentications[authentication.Key] = authentication.Value;
+                }
+            };
+            return result;
+        }
+
+        public Task Setup(Dictionary<string, string> parameters)
+        {
+            throw new NotImplementedException();
+        }
+
+        public Task OnGetStatus(Dictionary<string, string> status, Session session)
+        {
+            return Task.CompletedTask;
+        }
+
+        public Task Unlink(User user)
+        {
+            return Task.CompletedTask;
+        }
+
+        public Task<DateTime?> RenewCredentials(AuthenticationContext authenticationContext)
+        {
+            throw new NotImplementedException();
+        }
+    }
+}
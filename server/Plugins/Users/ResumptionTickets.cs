@@ -0,0 +1,119 @@
+// MIT License
+//
+// Copyright (c) 2019 Stormancer
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Linq;
+using System.Security.Cryptography;
+
+namespace Stormancer.Server.Users
+{
+    /// <summary>
+    /// Tickets a client presents to authenticate again after a disconnection, without retrieving its credentials.
+    /// </summary>
+    /// <remarks>
+    /// A ticket is issued on each successful login, can be used only once, and expires after <see cref="TicketLifetime"/>.
+    /// It is revoked when the user logs out.
+    /// Tickets are kept in memory: they do not survive a restart of the server, and only work with a single authenticator node.
+    /// </remarks>
+    public class ResumptionTickets
+    {
+        public static readonly TimeSpan TicketLifetime = TimeSpan.FromHours(1);
+        private static readonly TimeSpan PurgeInterval = TimeSpan.FromMinutes(1);
+
+        public class Ticket
+        {
+            public string UserId { get; set; }
+
+            // Session the ticket was issued to.
+            public string SessionId { get; set; }
+
+            public PlatformId PlatformId { get; set; }
+
+            public Dictionary<string, string> Authentications { get; set; }
+
+            public DateTime ExpirationDate { get; set; }
+        }
+
+        private readonly ConcurrentDictionary<string, Ticket> _tickets = new ConcurrentDictionary<string, Ticket>();
+        private readonly RandomNumberGenerator _random = RandomNumberGenerator.Create();
+        private DateTime _lastPurge = DateTime.UtcNow;
+
+        public string Issue(SessionRecord session)
+        {
+            Purge();
+
+            var bytes = new byte[32];
+            lock (_random)
+            {
+                _random.GetBytes(bytes);
+            }
+            var id = Convert.ToBase64String(bytes);
+            _tickets[id] = new Ticket
+            {
+                UserId = session.User.Id,
+                SessionId = session.SessionId,
+                PlatformId = session.platformId,
+                Authentications = session.Authentications.ToDictionary(entry => entry.Key, entry => entry.Value),
+                ExpirationDate = DateTime.UtcNow + TicketLifetime
+            };
+            return id;
+        }
+
+        public bool TryConsume(string id, out Ticket ticket)
+        {
+            return _tickets.TryRemove(id, out ticket) && ticket.ExpirationDate > DateTime.UtcNow;
+        }
+
+        /// <summary>
+        /// Revoke the tickets issued to a session.
+        /// </summary>
+        public void Revoke(string sessionId)
+        {
+            foreach (var entry in _tickets)
+            {
+                if (entry.Value.SessionId == sessionId)
+                {
+                    _tickets.TryRemove(entry.Key, out _);
+                }
+            }
+        }
+
+        private void Purge()
+        {
+            var now = DateTime.UtcNow;
+            if (now - _lastPurge < PurgeInterval)
+            {
+                return;
+            }
+            _lastPurge = now;
+            foreach (var entry in _tickets)
+            {
+                if (entry.Value.ExpirationDate <= now)
+                {
+                    _tickets.TryRemove(entry.Key, out _);
+                }
+            }
+        }
+    }
+}
@@ -105,6 +105,7 @@ namespace Stormancer.Server.Users
                 b.Register<UserPeerIndex>().As<IUserPeerIndex>().SingleInstance();
                 b.Register<PeerUserIndex>().As<IPeerUserIndex>().SingleInstance();
                 b.Register<DeviceIdentifierAuthenticationProvider>().As<IAuthenticationProvider>();
+                b.Register<ResumeAuthenticationProvider>().As<IAuthenticationProvider>();
                 b.Register<AdminImpersonationAuthenticationProvider>().As<IAuthenticationProvider>();
                 b.Register<CredentialsRenewer>().AsSelf().As<IAuthenticationEventHandler>().SingleInstance();
 
@@ -150,6 +151,7 @@ namespace Stormancer.Server.Users
             b.Register<UserService>().As<IUserService>();
 
             b.Register<UserManagementConfig>().SingleInstance();
+            b.Register<ResumptionTickets>().SingleInstance();
             b.Register<UsersAdminController>();
             b.Register<AdminWebApiConfig>().As<IAdminWebApiConfig>();
 
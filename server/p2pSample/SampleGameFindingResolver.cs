@@ -1,4 +1,5 @@
 ﻿using Stormancer.Server.GameFinder;
+using Stormancer.Server.GameFinder.Default;
 using Stormancer.Server.GameSession;
 using System;
 using System.Collections.Generic;
@@ -32,7 +33,8 @@ namespace P2p
             var id = $"gs-{gameCtx.Game.Id}";
             try
             {
-                await gameSessions.Create(P2pPlugin.GAMESESSION_TEMPLATE,id, new GameSessionConfiguration { Public = true });
+                // The host elected by LatencyGameFinder, if it formed the game. Otherwise the game session elects one.
+                await gameSessions.Create(P2pPlugin.GAMESESSION_TEMPLATE,id, new GameSessionConfiguration { Public = true, HostUserId = LatencyGameFinder.GetHostUserId(gameCtx.Game) });
             }
             catch(Exception)//The method throws an exception if the scene already exist.
             {